@@ -18,9 +18,21 @@
  */
 #include "a2jmidi.h"
 #include "alsa_client.h"
+#include "controller_coalescer.h"
+#include "direct_writer.h"
+#include "event_placement.h"
 #include "jack_client.h"
+#include "jitter_estimator.h"
+#include "load_shedder.h"
+#include "rt_exchange.h"
+#include "spill_buffer.h"
+#include "staging_buffer.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <jack/jack.h>
 #include <jack/midiport.h>
@@ -33,74 +45,377 @@ static auto g_logger = spdlog::stdout_color_mt("a2jmidi");
 
 static bool g_continue{true};
 
+/**
+ * In constant latency mode: the number of events that arrived too late for their slot.
+ */
+static std::atomic<long> g_missedSlotCount{0};
+
+/**
+ * In constant latency mode: the delay given on the command line, and the delay actually
+ * used (raised to one period plus the wake-up delay, see `usableFixedDelay()`).
+ */
+static bool g_constantLatency{false};
+static int g_requestedFixedDelay{0};
+static std::atomic<int> g_fixedDelay{0};
+
+/**
+ * In the classic placement: the number of events that arrived before the window of their
+ * cycle (underrun) or beyond it (overrun). Counted on the process thread, reported at close.
+ */
+static std::atomic<long> g_underrunCount{0};
+static std::atomic<long> g_overrunCount{0};
+
+/**
+ * The jitter compensation that was included in the latency last reported to JACK.
+ */
+static std::atomic<TimePoint> g_reportedCompensation{0};
+
+/**
+ * Set when the buffer size or the sample rate have changed, and the latency
+ * reported to JACK must be recomputed.
+ */
+static std::atomic<bool> g_latencyOutdated{false};
+
+/**
+ * Places the events recorded during the cycles skipped by an xrun.
+ */
+static XrunRecovery g_xrunRecovery;
+
+/**
+ * Set by SIGUSR1: the main loop switches the xrun policy to the next one.
+ */
+static volatile sig_atomic_t g_xrunPolicySwitch{0};
+
+/**
+ * The number of events dropped because they were queued before a clock discontinuity,
+ * and the number of events discarded because they were far too old.
+ */
+static std::atomic<long> g_droppedEventCount{0};
+static std::atomic<long> g_discardedEventCount{0};
+
+/**
+ * The events of a cycle are collected here, and written into the JACK buffer in the
+ * order of their frame offsets. A new buffer is handed over when the period changes.
+ */
+static RtExchange<StagingBuffer> g_stagingBuffer;
+
+/**
+ * Allocate a staging buffer that can take a SysEx message of the maximum size.
+ */
+static std::unique_ptr<StagingBuffer> newStagingBuffer(const int nFrames) {
+  return std::make_unique<StagingBuffer>(nFrames, StagingBuffer::DEFAULT_EVENT_CAPACITY,
+                                         StagingBuffer::DEFAULT_BYTE_CAPACITY +
+                                             midi::MAX_SYSEX_SIZE);
+}
+/**
+ * The number of events that did not fit into the staging buffer.
+ */
+static std::atomic<long> g_stagingOverflowCount{0};
+
+/**
+ * Keeps the events that did not fit into the JACK buffer for the next cycle.
+ */
+static SpillBuffer g_spillBuffer{SpillBuffer::DEFAULT_EVENT_CAPACITY,
+                                  SpillBuffer::DEFAULT_BYTE_CAPACITY + midi::MAX_SYSEX_SIZE};
+
+/**
+ * The output of the direct write path: the JACK port buffer of the current cycle.
+ */
+struct JackSink {
+  void *pPortBuffer{nullptr};
+  unsigned char *reserve(int frame, int size) const {
+    return jack_midi_event_reserve(pPortBuffer, frame, size);
+  }
+  int freeSpace() const { return static_cast<int>(jack_midi_max_event_size(pPortBuffer)); }
+};
+
+/**
+ * Writes the events straight into the JACK buffer while they come in order, and the
+ * number of events written that way.
+ */
+static DirectWriter<JackSink> g_directWriter;
+static std::atomic<long> g_directEventCount{0};
+
+/**
+ * What to do with SysEx messages that do not fit into the JACK buffer, and the number
+ * of messages rejected.
+ */
+static SysexPolicy g_sysexPolicy{SysexPolicy::defer};
+static std::atomic<long> g_rejectedSysexCount{0};
+
+/**
+ * Thins out controllers when the JACK buffer runs short of space.
+ */
+static LoadShedder g_loadShedder;
+
+/**
+ * Collapses redundant controller values in the retrieve path.
+ */
+static ControllerCoalescer g_coalescer;
+
+/**
+ * The minimum interval between two values of a controller, in milliseconds.
+ */
+static double g_controllerIntervalMs{0.0};
+
+/**
+ * Convert the controller interval into frames.
+ */
+static TimePoint controllerIntervalFrames(const int sampleRate) {
+  return static_cast<TimePoint>(g_controllerIntervalMs * sampleRate / 1000.0);
+}
+
+/**
+ * Check the requested fixed delay against the buffer size, and raise it if it cannot be kept.
+ * @param nFrames - the number of frames per buffer.
+ */
+static void updateFixedDelay(const int nFrames) {
+  if (!g_constantLatency) {
+    return;
+  }
+  const int compensation = static_cast<int>(jitter::compensation());
+  const int delay = usableFixedDelay(g_requestedFixedDelay, nFrames, compensation);
+  if (delay != g_requestedFixedDelay) {
+    SPDLOG_LOGGER_WARN(g_logger,
+                       "a fixed delay of {} frames is shorter than one period ({}) plus the "
+                       "wake-up delay ({}); using {} frames.",
+                       g_requestedFixedDelay, nFrames, compensation, delay);
+  }
+  g_fixedDelay = delay;
+}
+
+/**
+ * Called (on a non real-time thread) when the JACK server changes the buffer size.
+ * The placement windows are computed on each cycle from the actual number of frames,
+ * the staging buffer is re-allocated and the reported latency must follow.
+ */
+void onJackBufferSizeChange(const int nFrames) {
+  g_stagingBuffer.publish(newStagingBuffer(nFrames));
+  updateFixedDelay(nFrames);
+  g_latencyOutdated = true;
+}
+
+/**
+ * Called (on a non real-time thread) when the JACK server changes the sample rate.
+ * The jitter statistics and the controller interval are measured in frames and must follow.
+ */
+void onJackSampleRateChange(const int sampleRate) {
+  jitter::reset(jitter::percentile());
+  g_coalescer.setMinInterval(controllerIntervalFrames(sampleRate));
+  g_latencyOutdated = true;
+}
+
+/**
+ * Write one event into the JACK buffer.
+ * @param pPortBuffer - the JACK buffer of the current cycle.
+ * @param eventPos - the frame offset, not smaller than the one of the previous event.
+ * @param pMidiData - the MIDI bytes.
+ * @param evLength - the number of MIDI bytes.
+ * @return zero to continue, -1 if the buffer is full.
+ */
+int writeToJack(void *pPortBuffer, const int eventPos, const unsigned char *pMidiData,
+                const int evLength) {
+  int err = jack_midi_event_write(pPortBuffer, eventPos, pMidiData, evLength);
+  if (err == -ENOBUFS) {
+    return -1; // stop processing, the spill buffer takes care of the rest.
+  }
+  if (err == -EINVAL) {
+    SPDLOG_LOGGER_ERROR(g_logger,
+                        "a2j_midi - JACK write error (invalid argument).\n"
+                        "           eventPos:{}, evLength:{}",
+                        eventPos, evLength);
+    return 0; // ignore problem - whatever it was...
+  }
+  if (err != 0) {
+    SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - JACK write error (undocumented error-code {}).",
+                        err);
+    return 0; // ignore problem - whatever it was...
+  }
+  SPDLOG_LOGGER_TRACE(g_logger, "a2j_midi::writeToJack - event[{}] written to buffer.", evLength);
+  return 0;
+}
+
+/**
+ * Write a long message (SysEx) into the JACK buffer. The bytes are copied straight into
+ * the space reserved by JACK.
+ * @param pPortBuffer - the JACK buffer of the current cycle.
+ * @param eventPos - the frame offset, not smaller than the one of the previous event.
+ * @param pMidiData - the MIDI bytes.
+ * @param evLength - the number of MIDI bytes.
+ * @return zero to continue, -1 if the buffer is full.
+ */
+int reserveInJack(void *pPortBuffer, const int eventPos, const unsigned char *pMidiData,
+                  const int evLength) {
+  jack_midi_data_t *pReserved = jack_midi_event_reserve(pPortBuffer, eventPos, evLength);
+  if (!pReserved) {
+    return -1; // stop processing, the spill buffer takes care of the rest.
+  }
+  std::memcpy(pReserved, pMidiData, evLength);
+  return 0;
+}
+
+/**
+ * The procedure executed on each event retrieved in a process cycle.
+ * It places the event and collects it in the staging buffer.
+ */
 class ForEachMidiProc {
 private:
-  void *const m_pPortBuffer;
-  const a2jmidi::TimePoint m_deadline;
-  const int m_nFrames;
+  StagingBuffer &m_staging;
+  const CycleWindow m_window;
+  const Placement m_placement;
 
 public:
-  ForEachMidiProc(void *const pPortBuffer, const a2jmidi::TimePoint deadline, const int nFrames)
-      : m_pPortBuffer{pPortBuffer}, m_deadline{deadline}, m_nFrames{nFrames} {}
+  ForEachMidiProc(StagingBuffer &staging, const CycleWindow &window, const Placement placement)
+      : m_staging{staging}, m_window{window}, m_placement{placement} {}
 
   int operator()(const midi::Event &event, const a2jmidi::TimePoint timeStamp) {
-
-    int lead = static_cast<int>(m_deadline - timeStamp); // how many time ahead of deadline
-    int eventPos = m_nFrames - lead;                     // the position in the frame buffer
-    if (eventPos < -m_nFrames) {
-      // such extreme buffer-underrun happen after system hibernation.
-      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - buffer underrun by {} frames - event discarded.",
-                          -eventPos);
+    const int nFrames = m_window.nFrames;
+    // the position in the frame buffer, before clamping
+    auto offset = static_cast<int>(timeStamp - m_window.bufferStart);
+    if (g_xrunRecovery.recovering()) {
+      // the backlog of an xrun: counted by the recovery, neither jitter nor an underrun.
+      int eventPos = g_xrunRecovery.place(timeStamp);
+      return (eventPos == DISCARD_EVENT) ? 0 : write(event, timeStamp, eventPos);
+    }
+    if (m_placement == Placement::previousCycle) {
+      jitter::addLead(m_window.deadline - timeStamp, nFrames);
+    }
+    int eventPos = placeEvent(m_window, timeStamp);
+    if (eventPos == DISCARD_EVENT) {
+      // such extreme buffer-underruns should be caught as clock discontinuities.
+      g_discardedEventCount.fetch_add(1, std::memory_order_relaxed);
       return 0; // ignore problem - just continue
     }
-    if (eventPos < 0) {
-      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - buffer underrun by {} frames.", -eventPos);
-      eventPos = 0; // ignore problem - put event at the very start of the buffer
+    if (offset < 0) {
+      switch (m_placement) {
+      case Placement::previousCycle:
+        g_underrunCount.fetch_add(1, std::memory_order_relaxed);
+        break;
+      case Placement::currentCycle:
+        break; // in low latency mode, moving older events to the start of the buffer is the rule.
+      case Placement::constantLatency:
+        g_missedSlotCount.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
     }
-    if (eventPos >= m_nFrames) {
-      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - buffer overrun by {} frames.",
-                          eventPos - m_nFrames);
-      eventPos = m_nFrames - 1; // ignore problem - put event at the very end of the buffer
+    if (offset >= nFrames) {
+      g_overrunCount.fetch_add(1, std::memory_order_relaxed);
     }
+    return write(event, timeStamp, eventPos);
+  }
 
-    int evLength = event.size();
-    const auto *pMidiData = &event[0];
-
-    int err = jack_midi_event_write(m_pPortBuffer, eventPos, pMidiData, evLength);
-    if (err == -ENOBUFS) {
-      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - JACK write error ({} bytes did not fit in buffer).",
-                          evLength);
-      return -1; // stop processing
-    }
-    if (err == -EINVAL) {
-      SPDLOG_LOGGER_ERROR(g_logger,
-                          "a2j_midi - JACK write error (invalid argument).\n"
-                          "           eventPos:{}, evLength:{}",
-                          eventPos, evLength);
-      return 0; // ignore problem - whatever it was...
+private:
+  int write(const midi::Event &event, const a2jmidi::TimePoint timeStamp, const int eventPos) {
+    if (g_directWriter.write(eventPos, event.data(), event.size())) {
+      g_directEventCount.fetch_add(1, std::memory_order_relaxed);
+      return 0;
     }
-    if (err != 0) {
-      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - JACK write error (undocumented error-code {}).",
-                          err);
-      return 0; // ignore problem - whatever it was...
+    if (!g_coalescer.add(m_staging, timeStamp, eventPos, event.data(), event.size())) {
+      g_stagingOverflowCount.fetch_add(1, std::memory_order_relaxed);
     }
-    SPDLOG_LOGGER_TRACE(g_logger, "a2j_midi::forEachMidiDo - event[{}] written to buffer.",
-                        evLength);
     return 0;
   }
 };
 
+/**
+ * The procedure executed by JACK on every process cycle.
+ *
+ * It runs on the JACK real-time thread. It never takes a lock and never sleeps;
+ * `alsaClient::retrieve` only consumes what the listener thread has already queued.
+ */
 class ForEachJackPeriodProc {
 private:
   const jackClient::JackPort m_jackPort;
+  const Placement m_placement;
+  std::uint32_t m_lastXrunCount;
+  std::uint32_t m_lastDiscontinuityCount;
+
+  CycleWindow window(const int nFrames, const a2jmidi::TimePoint deadline) const {
+    switch (m_placement) {
+    case Placement::currentCycle:
+      return currentCycleWindow(jackClient::cycleStart(), jackClient::processStart(), nFrames);
+    case Placement::constantLatency:
+      return constantLatencyWindow(jackClient::cycleStart(),
+                                   g_fixedDelay.load(std::memory_order_relaxed), nFrames);
+    case Placement::previousCycle:
+    default:
+      return previousCycleWindow(deadline, nFrames);
+    }
+  }
 
 public:
-  ForEachJackPeriodProc(jackClient::JackPort jackPort) : m_jackPort{jackPort} {}
+  ForEachJackPeriodProc(jackClient::JackPort jackPort, Placement placement)
+      : m_jackPort{jackPort}, m_placement{placement},
+        m_lastXrunCount{jackClient::xrunCount()},
+        m_lastDiscontinuityCount{jackClient::clockDiscontinuityCount()} {}
   int operator()(const int nFrames, const a2jmidi::TimePoint deadline) {
     void *pPortBuffer = jack_port_get_buffer(m_jackPort, nFrames);
     jack_midi_clear_buffer(pPortBuffer);
-    ForEachMidiProc forEachMidiProc{pPortBuffer, deadline, nFrames};
-    return alsaClient::retrieve(deadline, forEachMidiProc);
+    const CycleWindow window = this->window(nFrames, deadline);
+    const std::uint32_t discontinuityCount = jackClient::clockDiscontinuityCount();
+    const std::uint32_t xrunCount = jackClient::xrunCount();
+    bool xrun = xrunCount != m_lastXrunCount;
+    if (discontinuityCount != m_lastDiscontinuityCount) {
+      // the queued time stamps cannot be related to this cycle, start over.
+      g_droppedEventCount.fetch_add(alsaClient::discardPending(), std::memory_order_relaxed);
+      g_xrunRecovery.resynchronize();
+      g_coalescer.resynchronize();
+      xrun = false;
+    }
+    const TimePoint retrieveDeadline = g_xrunRecovery.beginCycle(window, xrun);
+    m_lastXrunCount = xrunCount;
+    m_lastDiscontinuityCount = discontinuityCount;
+    StagingBuffer *staging = g_stagingBuffer.acquire();
+    if (!staging) {
+      return 0;
+    }
+    // the events left over from the previous cycle come first.
+    g_spillBuffer.release(*staging);
+    g_coalescer.beginCycle();
+    const int capacity = static_cast<int>(jack_midi_max_event_size(pPortBuffer));
+    g_loadShedder.beginCycle(capacity);
+    // the direct path needs the events in order, and no events to be coalesced.
+    const bool direct =
+        staging->empty() && !g_coalescer.coalescing() && g_coalescer.minInterval() == 0;
+    g_directWriter.beginCycle(JackSink{pPortBuffer}, direct,
+                              capacity / LoadShedder::PRESSURE_DIVISOR);
+    ForEachMidiProc forEachMidiProc{*staging, window, m_placement};
+    // pass by reference, a copy would not fit into the small buffer of `std::function`.
+    int err = alsaClient::retrieve(retrieveDeadline, std::ref(forEachMidiProc));
+    // the controller values held back by the rate limit, as far as they are due.
+    g_stagingOverflowCount.fetch_add(g_coalescer.flush(*staging, window),
+                                     std::memory_order_relaxed);
+
+    // jack_midi_event_write requires non-decreasing offsets, the clamped events and the
+    // xrun backlog might not be in order. The staged events come after those written directly.
+    staging->sort();
+    const int firstFrame = g_directWriter.lastFrame();
+    int position = 0;
+    int written = staging->forEach([pPortBuffer, staging, capacity, firstFrame, &position](
+                                       int stagedFrame, const unsigned char *data, int size) {
+      const int frame = std::max(stagedFrame, firstFrame);
+      const int freeSpace = static_cast<int>(jack_midi_max_event_size(pPortBuffer));
+      // SysEx always passes the shedder, so that `--sysex defer` carries it over.
+      if (!g_loadShedder.admit(*staging, position++, freeSpace)) {
+        return 0; // skipped, not deferred
+      }
+      if (size <= midi::Event::INLINE_CAPACITY) {
+        return writeToJack(pPortBuffer, frame, data, size);
+      }
+      switch (sysexAction(size, freeSpace, capacity, g_sysexPolicy)) {
+      case SysexAction::defer:
+        return -1; // the spill buffer carries it over.
+      case SysexAction::reject:
+        g_rejectedSysexCount.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+      case SysexAction::write:
+      default:
+        return reserveInJack(pPortBuffer, frame, data, size);
+      }
+    });
+    g_spillBuffer.keep(*staging, written);
+    staging->clear();
+    return err;
   }
 };
 
@@ -109,24 +424,57 @@ void onJackServerAbend() {
   SPDLOG_LOGGER_INFO(g_logger, "JACK server is down.");
 }
 
-void open(const std::string &clientNameProposal, const std::string &connectTo,
-          bool startJack) noexcept(false) {
+void open(const CommandLineInterpretation &arguments) noexcept(false) {
   SPDLOG_LOGGER_TRACE(g_logger, "a2jmidi::open");
+  jitter::reset(arguments.jitterPercentile);
+  g_xrunRecovery.reset();
+  g_xrunRecovery.setPolicy(arguments.xrunPolicy);
+  g_spillBuffer.reset();
+  g_spillBuffer.setPolicy(arguments.overflowPolicy);
+  g_loadShedder.reset();
+  g_sysexPolicy = arguments.sysexPolicy;
+  g_directEventCount = 0;
+  g_underrunCount = 0;
+  g_overrunCount = 0;
+  g_rejectedSysexCount = 0;
+  g_coalescer.reset();
+  g_coalescer.setCoalescing(arguments.coalesceControllers);
+  g_controllerIntervalMs = arguments.controllerIntervalMs;
+  g_constantLatency = arguments.placement == Placement::constantLatency;
+  g_requestedFixedDelay = arguments.fixedDelay;
+  g_fixedDelay = arguments.fixedDelay;
 
-  jackClient::open(clientNameProposal, startJack);
+  jackClient::open(arguments.clientName, arguments.startJack);
   jackClient::onServerAbend(onJackServerAbend);
+  jackClient::onBufferSizeChange(onJackBufferSizeChange);
+  jackClient::onSampleRateChange(onJackSampleRateChange);
+  g_coalescer.setMinInterval(controllerIntervalFrames(jackClient::sampleRate()));
   const std::string clientName = jackClient::clientName();
   SPDLOG_LOGGER_INFO(g_logger, "client \"{}\" started.", clientName);
 
   jackClient::JackPort jackPort = jackClient::newSenderPort(clientName);
+  g_stagingBuffer.reset(newStagingBuffer(jackClient::bufferSize()));
+  updateFixedDelay(jackClient::bufferSize());
+  const Placement placement = arguments.placement;
+  jackClient::registerLatencyCallback(jackPort, [placement](const int nFrames) {
+    g_reportedCompensation = jitter::compensation();
+    // the delay actually used, which may have been raised to the minimum.
+    LatencyRange latency = placementLatency(
+        placement, nFrames, static_cast<int>(g_reportedCompensation), g_fixedDelay);
+    jack_latency_range_t range;
+    range.min = latency.min;
+    range.max = latency.max;
+    return range;
+  });
 
-  alsaClient::open(clientName);
-  alsaClient::newReceiverPort(clientName, connectTo);
+  alsaClient::open(clientName, arguments.eventFilter, arguments.inputPool,
+                   arguments.inputBuffer);
+  alsaClient::newReceiverPort(clientName, arguments.connectTo, arguments.kernelTimestamps);
 
-  ForEachJackPeriodProc forEachJackPeriodProc{jackPort};
+  ForEachJackPeriodProc forEachJackPeriodProc{jackPort, arguments.placement};
   jackClient::registerProcessCallback(forEachJackPeriodProc);
 
-  alsaClient::activate(jackClient::clock());
+  alsaClient::activate(jackClient::clock(), arguments.busyPoll, arguments.realtime);
   jackClient::activate();
 }
 
@@ -134,6 +482,58 @@ void close() {
   SPDLOG_LOGGER_TRACE(g_logger, "a2jmidi::close");
   jackClient::close();
   alsaClient::close();
+  SPDLOG_LOGGER_INFO(g_logger,
+                     "jitter compensation {} frames ({}th percentile of {} wake-up delays), "
+                     "{} late events.",
+                     jitter::compensation(), jitter::percentile(),
+                     jitter::wakeUpDelayHistogram().count(), jitter::lateEventCount());
+  if (g_missedSlotCount > 0) {
+    SPDLOG_LOGGER_INFO(g_logger, "{} events arrived too late for the fixed delay.",
+                       g_missedSlotCount.load());
+  }
+  if (g_underrunCount > 0 || g_overrunCount > 0) {
+    SPDLOG_LOGGER_INFO(g_logger, "{} buffer underruns, {} buffer overruns.",
+                       g_underrunCount.load(), g_overrunCount.load());
+  }
+  if (g_stagingOverflowCount > 0) {
+    SPDLOG_LOGGER_INFO(g_logger, "{} events did not fit into the staging buffer.",
+                       g_stagingOverflowCount.load());
+  }
+  if (g_spillBuffer.deferredCount() > 0 || g_spillBuffer.lostCount() > 0) {
+    SPDLOG_LOGGER_INFO(g_logger,
+                       "JACK buffer full: {} events deferred to a later cycle, {} events lost.",
+                       g_spillBuffer.deferredCount(), g_spillBuffer.lostCount());
+  }
+  if (g_coalescer.coalescedCount() > 0 || g_coalescer.heldCount() > 0) {
+    SPDLOG_LOGGER_INFO(g_logger,
+                       "{} controller values coalesced within a cycle, {} held back by the rate "
+                       "limit.",
+                       g_coalescer.coalescedCount(), g_coalescer.heldCount());
+  }
+  if (g_loadShedder.coalescedCount() > 0 || g_loadShedder.shedCount() > 0) {
+    SPDLOG_LOGGER_INFO(g_logger,
+                       "JACK buffer under pressure: {} controller values coalesced, "
+                       "{} non-essential events shed.",
+                       g_loadShedder.coalescedCount(), g_loadShedder.shedCount());
+  }
+  if (g_directEventCount > 0) {
+    SPDLOG_LOGGER_INFO(g_logger, "{} events written directly into the JACK buffer.",
+                       g_directEventCount.load());
+  }
+  if (g_rejectedSysexCount > 0) {
+    SPDLOG_LOGGER_INFO(g_logger, "{} SysEx messages did not fit into the JACK buffer.",
+                       g_rejectedSysexCount.load());
+  }
+  if (g_discardedEventCount > 0) {
+    SPDLOG_LOGGER_INFO(g_logger, "{} events discarded because they were far too old.",
+                       g_discardedEventCount.load());
+  }
+  if (g_xrunRecovery.xrunCount() > 0) {
+    SPDLOG_LOGGER_INFO(g_logger,
+                       "{} xruns: {} events flushed, {} compressed, {} spread.",
+                       g_xrunRecovery.xrunCount(), g_xrunRecovery.flushedCount(),
+                       g_xrunRecovery.compressedCount(), g_xrunRecovery.spreadCount());
+  }
 }
 void configureLogging() {
   // set log pattern
@@ -159,19 +559,48 @@ void sigintHandler(int sig) {
   }
   signal(SIGINT, sigintHandler); // reinstall handler
 }
-int run(const std::string &clientNameProposal, const std::string &connectTo,
-        bool startJack) noexcept {
+void sigusr1Handler(int sig) {
+  if (sig == SIGUSR1) {
+    g_xrunPolicySwitch = 1;
+  }
+  signal(SIGUSR1, sigusr1Handler); // reinstall handler
+}
+int runBridge(const CommandLineInterpretation &arguments) noexcept {
   using namespace std::chrono_literals;
   try {
     SPDLOG_LOGGER_TRACE(g_logger, "a2jmidi::run");
-    open(clientNameProposal, connectTo, startJack);
+    open(arguments);
 
     // install signal handlers for shutdown.
     signal(SIGINT, sigintHandler); // Ctrl-C interrupt the application. Usually causing it to abort.
     signal(SIGTERM, sigtermHandler); // cleanup and terminate the process
+    signal(SIGUSR1, sigusr1Handler); // switch to the next xrun policy
     // suspend this thread until the `g_continue` becomes false
+    std::uint32_t reportedDiscontinuities = jackClient::clockDiscontinuityCount();
+    long reportedDrops = 0;
     while (g_continue) {
       std::this_thread::sleep_for(100ms);
+      g_stagingBuffer.reclaim(); // free a staging buffer replaced after a period change.
+      if (g_xrunPolicySwitch) {
+        g_xrunPolicySwitch = 0;
+        g_xrunRecovery.setPolicy(nextPolicy(g_xrunRecovery.policy()));
+        SPDLOG_LOGGER_INFO(g_logger, "xrun recovery policy switched to {}.",
+                           policyName(g_xrunRecovery.policy()));
+      }
+      if (jackClient::clockDiscontinuityCount() != reportedDiscontinuities) {
+        reportedDiscontinuities = jackClient::clockDiscontinuityCount();
+        const long drops = g_droppedEventCount;
+        SPDLOG_LOGGER_WARN(g_logger,
+                           "clock discontinuity (system suspended?) - {} queued events dropped.",
+                           drops - reportedDrops);
+        reportedDrops = drops;
+      }
+      const bool compensationMoved = arguments.placement == Placement::previousCycle &&
+                                     jitter::compensation() != g_reportedCompensation;
+      if (g_latencyOutdated.exchange(false) || compensationMoved) {
+        // the period or the adaptive jitter compensation have changed, publish the new latency.
+        jackClient::recomputeLatencies();
+      }
     }
 
     close();
@@ -199,7 +628,7 @@ int run(const CommandLineInterpretation &arguments) noexcept {
     std::cout << arguments.message.str();
     return 0;
   case CommandLineAction::run:
-    return run(arguments.clientName, arguments.connectTo, arguments.startJack);
+    return runBridge(arguments);
   }
 }
 
@@ -19,6 +19,14 @@
 #ifndef A_J_MIDI_SRC_A2JMIDI_H
 #define A_J_MIDI_SRC_A2JMIDI_H
 
+#include "alsa_client.h"
+#include "event_filter.h"
+#include "event_placement.h"
+#include "realtime.h"
+#include "jitter_estimator.h"
+#include "spill_buffer.h"
+#include "sysex_arena.h"
+#include "xrun_recovery.h"
 #include <sstream>
 #include <string>
 
@@ -53,6 +61,20 @@ public:
   std::string clientName{APPLICATION}; ///< a proposed default device name
   std::string connectTo;               ///< name of a port to connect to
   bool startJack{false};               ///< should the JACK server be started
+  bool kernelTimestamps{false};        ///< should ALSA stamp each event on arrival
+  double jitterPercentile{jitter::DEFAULT_PERCENTILE}; ///< percentile of delays to compensate
+  Placement placement{Placement::previousCycle}; ///< how events are placed into the buffers
+  int fixedDelay{0}; ///< the delay in frames for `Placement::constantLatency`
+  XrunPolicy xrunPolicy{XrunPolicy::spread}; ///< what to do with the events skipped by an xrun
+  OverflowPolicy overflowPolicy{OverflowPolicy::spill}; ///< what to do when JACK's buffer is full
+  bool coalesceControllers{false}; ///< write only the last controller value per cycle
+  double controllerIntervalMs{0.0}; ///< minimum interval between values of a controller
+  SysexPolicy sysexPolicy{SysexPolicy::defer}; ///< SysEx that does not fit into JACK's buffer
+  alsaClient::EventFilter eventFilter; ///< the event types the kernel shall not deliver
+  int inputPool{alsaClient::DEFAULT_INPUT_POOL};     ///< events the kernel holds for us
+  int inputBuffer{alsaClient::DEFAULT_INPUT_BUFFER}; ///< events read from the kernel at once
+  alsaClient::BusyPoll busyPoll; ///< how the listener thread waits for incoming events
+  RealtimeSettings realtime;     ///< thread scheduling, CPU affinity and memory locking
 };
 
 /**
@@ -35,6 +35,11 @@ public:
    * @return the estimated current time in in frames.
    */
   virtual long now() = 0;
+  /**
+   * The resolution of the clock.
+   * @return the number of ticks (of `now()`) per second, zero if unknown.
+   */
+  virtual long ticksPerSecond() = 0;
 };
 /**
  * A smart pointer that owns and manages an Clock-object through a pointer and
@@ -35,6 +35,25 @@ namespace a2jmidi {
 #define CLIENT_NAME_OPT "name"
 #define START_SERVER_OPT "startjack"
 #define CONNECT_TO "connect"
+#define KERNEL_TIMESTAMPS_OPT "kernel-timestamps"
+#define JITTER_PERCENTILE_OPT "jitter-percentile"
+#define LOW_LATENCY_OPT "low-latency"
+#define FIXED_DELAY_OPT "fixed-delay"
+#define XRUN_RECOVERY_OPT "xrun-recovery"
+#define OVERFLOW_OPT "overflow"
+#define COALESCE_OPT "coalesce"
+#define CONTROLLER_INTERVAL_OPT "controller-interval"
+#define SYSEX_OPT "sysex"
+#define FILTER_OPT "filter"
+#define INPUT_POOL_OPT "input-pool"
+#define INPUT_BUFFER_OPT "input-buffer"
+#define BUSY_POLL_OPT "busy-poll"
+#define BACKOFF_OPT "backoff"
+#define LISTENER_POLICY_OPT "listener-policy"
+#define LISTENER_PRIORITY_OPT "listener-priority"
+#define LISTENER_CPU_OPT "listener-cpu"
+#define MONITOR_CPU_OPT "monitor-cpu"
+#define MLOCK_OPT "mlock"
 
 /**
  * This function provides the Command-Line-Interface (CLI)
@@ -57,7 +76,40 @@ CommandLineInterpretation parseCommandLine(int ac, const char *av[]) noexcept {
         (HELP_OPT ",h", "display this help and exit")                                  //
         (VERSION_OPT ",v", "display version information and exit")                     //
         (START_SERVER_OPT ",s", "Try to start the JACK server if not already running") //
-        (CONNECT_TO ",c", boostPO::value<string>(), "connect to an ALSA port")            //
+        (CONNECT_TO ",c", boostPO::value<string>(), "connect to an ALSA port")         //
+        (KERNEL_TIMESTAMPS_OPT ",k", "let ALSA timestamp each event when it arrives")  //
+        (JITTER_PERCENTILE_OPT ",j", boostPO::value<double>(),                         //
+         "percentile of the listener delays covered by the jitter compensation")       //
+        (LOW_LATENCY_OPT ",l", "emit events in the current cycle (lower latency)")     //
+        (FIXED_DELAY_OPT ",f", boostPO::value<int>(),                                  //
+         "delay every event by exactly this many frames")                              //
+        (XRUN_RECOVERY_OPT ",x", boostPO::value<string>(),                             //
+         "after an xrun: flush, compress or spread (default) the skipped events")      //
+        (OVERFLOW_OPT ",o", boostPO::value<string>(),                                  //
+         "when JACK's buffer is full: spill (default), drop-newest or drop-oldest")    //
+        (COALESCE_OPT ",C", "write only the last value of each controller per cycle")  //
+        (CONTROLLER_INTERVAL_OPT ",i", boostPO::value<double>(),                       //
+         "minimum interval in ms between two values of the same controller")           //
+        (SYSEX_OPT ",e", boostPO::value<string>(),                                     //
+         "SysEx that does not fit into JACK's buffer: defer (default) or reject")      //
+        (FILTER_OPT ",F", boostPO::value<string>(),                                    //
+         "comma separated messages to drop in the kernel: clock, sensing, transport, "
+         "timecode, sysex, aftertouch, program, pitchbend, controller")                //
+        (INPUT_POOL_OPT ",p", boostPO::value<int>(),                                   //
+         "number of events the kernel can hold for the bridge (at most 2000)")         //
+        (INPUT_BUFFER_OPT ",b", boostPO::value<int>(),                                 //
+         "number of events read from the kernel at once")                              //
+        (BUSY_POLL_OPT ",B", boostPO::value<int>(),                                    //
+         "listen without sleeping, on the given (isolated) CPU")                       //
+        (BACKOFF_OPT ",y", boostPO::value<string>(),                                   //
+         "busy poll back-off when idle: spin, pause (default) or yield")               //
+        (LISTENER_POLICY_OPT ",P", boostPO::value<string>(),                           //
+         "scheduling of the listener thread: other (default), fifo or rr")             //
+        (LISTENER_PRIORITY_OPT ",R", boostPO::value<int>(),                            //
+         "real-time priority (1 to 99) of the listener thread")                        //
+        (LISTENER_CPU_OPT ",L", boostPO::value<int>(), "pin the listener thread to a CPU") //
+        (MONITOR_CPU_OPT ",M", boostPO::value<int>(), "pin the monitor thread to a CPU")   //
+        (MLOCK_OPT ",m", "lock all memory into RAM and prefault the heap")             //
         (CLIENT_NAME_OPT ",n", boostPO::value<string>(), "(optional) client name");
 
     try {
@@ -90,6 +142,195 @@ CommandLineInterpretation parseCommandLine(int ac, const char *av[]) noexcept {
         result.startJack = true;
       }
 
+      if (varMap.count(KERNEL_TIMESTAMPS_OPT)) {
+        // stamp events with an ALSA queue instead of the listener thread
+        result.kernelTimestamps = true;
+      }
+
+      if (varMap.count(JITTER_PERCENTILE_OPT)) {
+        double percentile = varMap[JITTER_PERCENTILE_OPT].as<double>();
+        if (percentile <= 0.0 || percentile > 100.0) {
+          throw boostPO::error("the jitter percentile must lie in (0, 100]");
+        }
+        result.jitterPercentile = percentile;
+      }
+
+      if (varMap.count(LOW_LATENCY_OPT) && varMap.count(FIXED_DELAY_OPT)) {
+        throw boostPO::error("--" LOW_LATENCY_OPT " and --" FIXED_DELAY_OPT " exclude each other");
+      }
+
+      if (varMap.count(LOW_LATENCY_OPT)) {
+        // place events into the current cycle
+        result.placement = Placement::currentCycle;
+      }
+
+      if (varMap.count(FIXED_DELAY_OPT)) {
+        // place events at a constant delay
+        int fixedDelay = varMap[FIXED_DELAY_OPT].as<int>();
+        if (fixedDelay < 0) {
+          throw boostPO::error("the fixed delay must not be negative");
+        }
+        result.placement = Placement::constantLatency;
+        result.fixedDelay = fixedDelay;
+      }
+
+      if (varMap.count(XRUN_RECOVERY_OPT)) {
+        const string policy = varMap[XRUN_RECOVERY_OPT].as<string>();
+        if (policy == "flush") {
+          result.xrunPolicy = XrunPolicy::flush;
+        } else if (policy == "compress") {
+          result.xrunPolicy = XrunPolicy::compress;
+        } else if (policy == "spread") {
+          result.xrunPolicy = XrunPolicy::spread;
+        } else {
+          throw boostPO::error("the xrun recovery must be one of flush, compress or spread");
+        }
+      }
+
+      if (varMap.count(OVERFLOW_OPT)) {
+        const string policy = varMap[OVERFLOW_OPT].as<string>();
+        if (policy == "spill") {
+          result.overflowPolicy = OverflowPolicy::spill;
+        } else if (policy == "drop-newest") {
+          result.overflowPolicy = OverflowPolicy::dropNewest;
+        } else if (policy == "drop-oldest") {
+          result.overflowPolicy = OverflowPolicy::dropOldest;
+        } else {
+          throw boostPO::error("the overflow policy must be one of spill, drop-newest or "
+                               "drop-oldest");
+        }
+      }
+
+      if (varMap.count(COALESCE_OPT)) {
+        // collapse redundant controller values
+        result.coalesceControllers = true;
+      }
+
+      if (varMap.count(CONTROLLER_INTERVAL_OPT)) {
+        double interval = varMap[CONTROLLER_INTERVAL_OPT].as<double>();
+        if (interval < 0.0) {
+          throw boostPO::error("the controller interval must not be negative");
+        }
+        result.controllerIntervalMs = interval;
+      }
+
+      if (varMap.count(SYSEX_OPT)) {
+        const string policy = varMap[SYSEX_OPT].as<string>();
+        if (policy == "defer") {
+          result.sysexPolicy = SysexPolicy::defer;
+        } else if (policy == "reject") {
+          result.sysexPolicy = SysexPolicy::reject;
+        } else {
+          throw boostPO::error("the SysEx policy must be one of defer or reject");
+        }
+      }
+
+      if (varMap.count(FILTER_OPT)) {
+        // comma separated categories of messages, that shall never leave the kernel
+        stringstream categories{varMap[FILTER_OPT].as<string>()};
+        string category;
+        while (getline(categories, category, ',')) {
+          if (!result.eventFilter.blockCategory(category)) {
+            throw boostPO::error("unknown message category \"" + category + "\" in --" FILTER_OPT);
+          }
+        }
+      }
+
+      if (varMap.count(INPUT_POOL_OPT)) {
+        int inputPool = varMap[INPUT_POOL_OPT].as<int>();
+        if (inputPool < 1 || inputPool > alsaClient::MAX_INPUT_POOL) {
+          throw boostPO::error("the input pool must hold between 1 and 2000 events");
+        }
+        result.inputPool = inputPool;
+      }
+
+      if (varMap.count(INPUT_BUFFER_OPT)) {
+        int inputBuffer = varMap[INPUT_BUFFER_OPT].as<int>();
+        if (inputBuffer < 1) {
+          throw boostPO::error("the input buffer must hold at least one event");
+        }
+        result.inputBuffer = inputBuffer;
+      }
+
+      if (varMap.count(BACKOFF_OPT) && !varMap.count(BUSY_POLL_OPT)) {
+        throw boostPO::error("--" BACKOFF_OPT " requires --" BUSY_POLL_OPT);
+      }
+
+      if (varMap.count(BUSY_POLL_OPT)) {
+        int cpu = varMap[BUSY_POLL_OPT].as<int>();
+        if (cpu < 0) {
+          throw boostPO::error("the CPU number must not be negative");
+        }
+        result.busyPoll.enabled = true;
+        result.busyPoll.cpu = cpu;
+      }
+
+      if (varMap.count(BACKOFF_OPT)) {
+        const string backoff = varMap[BACKOFF_OPT].as<string>();
+        if (backoff == "spin") {
+          result.busyPoll.backoff = alsaClient::Backoff::spin;
+        } else if (backoff == "pause") {
+          result.busyPoll.backoff = alsaClient::Backoff::pause;
+        } else if (backoff == "yield") {
+          result.busyPoll.backoff = alsaClient::Backoff::yield;
+        } else {
+          throw boostPO::error("the back-off must be one of spin, pause or yield");
+        }
+      }
+
+      if (varMap.count(LISTENER_POLICY_OPT)) {
+        const string policy = varMap[LISTENER_POLICY_OPT].as<string>();
+        if (policy == "other") {
+          result.realtime.listener.policy = SCHED_OTHER;
+        } else if (policy == "fifo") {
+          result.realtime.listener.policy = SCHED_FIFO;
+        } else if (policy == "rr") {
+          result.realtime.listener.policy = SCHED_RR;
+        } else {
+          throw boostPO::error("the listener policy must be one of other, fifo or rr");
+        }
+        if (policy != "other") {
+          result.realtime.listener.priority = DEFAULT_LISTENER_PRIORITY;
+        }
+      }
+
+      if (varMap.count(LISTENER_PRIORITY_OPT)) {
+        int priority = varMap[LISTENER_PRIORITY_OPT].as<int>();
+        if (priority < 1 || priority > 99) {
+          throw boostPO::error("the listener priority must lie between 1 and 99");
+        }
+        if (!varMap.count(LISTENER_POLICY_OPT)) {
+          result.realtime.listener.policy = SCHED_FIFO;
+        } else if (result.realtime.listener.policy == SCHED_OTHER) {
+          throw boostPO::error("a listener priority requires the policy fifo or rr");
+        }
+        result.realtime.listener.priority = priority;
+      }
+
+      if (varMap.count(LISTENER_CPU_OPT)) {
+        if (varMap.count(BUSY_POLL_OPT)) {
+          throw boostPO::error("--" BUSY_POLL_OPT " already pins the listener thread");
+        }
+        int cpu = varMap[LISTENER_CPU_OPT].as<int>();
+        if (cpu < 0) {
+          throw boostPO::error("the CPU number must not be negative");
+        }
+        result.realtime.listener.cpu = cpu;
+      }
+
+      if (varMap.count(MONITOR_CPU_OPT)) {
+        int cpu = varMap[MONITOR_CPU_OPT].as<int>();
+        if (cpu < 0) {
+          throw boostPO::error("the CPU number must not be negative");
+        }
+        result.realtime.monitor.cpu = cpu;
+      }
+
+      if (varMap.count(MLOCK_OPT)) {
+        // lock the memory and prefault the heap when the bridge is activated
+        result.realtime.lockMemory = true;
+      }
+
       if (varMap.count(CLIENT_NAME_OPT)) {
         // set the client name as named variable
         result.clientName = varMap[CLIENT_NAME_OPT].as<string>();
@@ -38,16 +38,21 @@ static auto g_connectionsLogger = spdlog::stdout_color_mt("alsa_client-connectio
 
 static int g_portId{NULL_ID};                 ///< the ID-number of our ALSA input port
 static snd_seq_t *g_sequencerHandle{nullptr}; ///< handle to access the ALSA sequencer
-static snd_midi_event_t *g_midiEventParserHandle{
-    nullptr};                            ///< handle to access the ALSA MIDI parser
-static int g_clientId{NULL_ID};          ///< the client-number of this client
-static State g_stateFlag{State::closed}; ///< the current state of the alsaClient
-static std::mutex g_stateAccessMutex;    ///< protects g_stateFlag against race conditions.
-static std::string g_connectTo;          ///< the name of a port we shall try to connect to
+static int g_clientId{NULL_ID}; ///< the client-number of this client
+static int g_queueId{NULL_ID};  ///< the ALSA queue that stamps incoming events (if any)
+/**
+ * The current state of the alsaClient. It is modified under the protection of
+ * `g_stateAccessMutex`, but `retrieve()` reads it without lock.
+ */
+static std::atomic<State> g_stateFlag{State::closed};
+std::mutex g_stateAccessMutex;  ///< protects g_stateFlag against race conditions.
+static std::string g_connectTo; ///< the name of a port we shall try to connect to
 
-// this should be large enough to hold the largest MIDI message to be encoded by the
-// AlsaMidiEventParser
-constexpr int MAX_MIDI_EVENT_SIZE{16};
+/**
+ * The threads that start after the memory has been locked: the connection monitor, the
+ * listener and the process thread of JACK (the bridge is activated before JACK).
+ */
+static constexpr int THREADS_STARTED_AFTER_LOCKING = 3;
 
 /**
  * The `g_onMonitorConnectionsHandler` is invoked on regular time intervals.
@@ -119,29 +124,121 @@ void monitorLoop() {
   }
 }
 
-void activateConnectionMonitoring() {
+void activateConnectionMonitoring(const a2jmidi::ThreadSettings &settings) {
   SPDLOG_LOGGER_TRACE(g_connectionsLogger, "activateConnectionMonitoring");
   g_monitoringActive = true;
   // create and start the monitoring thread.
   std::thread monitorThread(monitorLoop);
 
-  // set the priority to the lowest possible level
-  sched_param schParams;
-  schParams.sched_priority = 1; // = lowest
-  if (pthread_setschedparam(monitorThread.native_handle(), SCHED_RR, &schParams)) {
-    SPDLOG_LOGGER_ERROR(g_connectionsLogger, "Failed to set Thread scheduling : {}",
-                        std::strerror(errno));
-  }
+  // by default, the priority is set to the lowest real-time level.
+  a2jmidi::applyThreadSettings(monitorThread.native_handle(), settings, "monitor");
 
   // Separate the thread of execution from the `monitorThread` object,
   // allowing execution to continue once this function is excited.
   monitorThread.detach();
 }
 
-void activateInternal(a2jmidi::ClockPtr clock) {
-  activateConnectionMonitoring();
-  alsaClient::receiverQueue::start(g_sequencerHandle, std::move(clock));
+void activateInternal(a2jmidi::ClockPtr clock, const BusyPoll &busyPoll,
+                      const a2jmidi::RealtimeSettings &realtime) {
+  if (realtime.lockMemory) {
+    // lock before the threads start, so that their stacks are locked too: the monitor and the
+    // listener, and the process thread that `jack_activate()` starts afterwards.
+    if (a2jmidi::lockMemory(THREADS_STARTED_AFTER_LOCKING)) {
+      a2jmidi::prefaultHeap(a2jmidi::HEAP_PREFAULT_SIZE);
+    } else {
+      SPDLOG_LOGGER_WARN(g_logger, "memory not locked, the heap is not prefaulted.");
+    }
+  }
+  activateConnectionMonitoring(realtime.monitor);
+  int timestampQueue = (g_queueId == NULL_ID) ? receiverQueue::NO_TIMESTAMP_QUEUE : g_queueId;
+  alsaClient::receiverQueue::start(g_sequencerHandle, std::move(clock),
+                                   receiverQueue::DEFAULT_CAPACITY, timestampQueue, busyPoll,
+                                   realtime.listener);
+}
+
+/**
+ * Create and start an ALSA queue whose only purpose is to stamp incoming events.
+ * @param name - a name for the queue.
+ * @return the id of the running queue.
+ */
+int createTimestampQueue(const std::string &name) {
+  int queueId = snd_seq_alloc_named_queue(g_sequencerHandle, name.c_str());
+  if (ALSA_ERROR(queueId, "snd_seq_alloc_named_queue")) {
+    throw std::runtime_error("ALSA cannot create queue");
+  }
+  int err = snd_seq_start_queue(g_sequencerHandle, queueId, nullptr);
+  if (err >= 0) {
+    err = snd_seq_drain_output(g_sequencerHandle);
+  }
+  if (ALSA_ERROR(err, "snd_seq_start_queue")) {
+    snd_seq_free_queue(g_sequencerHandle, queueId);
+    throw std::runtime_error("ALSA cannot start queue");
+  }
+  SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::createTimestampQueue - queue {} started.", queueId);
+  return queueId;
+}
+
+/**
+ * Stop and dispose the timestamp queue (if there is one).
+ */
+void freeTimestampQueue() {
+  if (g_queueId == NULL_ID) {
+    return;
+  }
+  int err = snd_seq_free_queue(g_sequencerHandle, g_queueId);
+  ALSA_ERROR(err, "snd_seq_free_queue");
+  g_queueId = NULL_ID;
+}
+
+/**
+ * Create the receiver port.
+ * @param portName - a desired name for the new port.
+ * @param queueId - the queue that shall stamp incoming events in real time, or NULL_ID.
+ * @return the port id or a negative error code.
+ */
+int createPort(const std::string &portName, int queueId) {
+  snd_seq_port_info_t *portInfo;
+  snd_seq_port_info_alloca(&portInfo);
+  snd_seq_port_info_set_name(portInfo, portName.c_str());
+  snd_seq_port_info_set_capability(portInfo,
+                                   SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE);
+  snd_seq_port_info_set_type(portInfo, SND_SEQ_PORT_TYPE_APPLICATION);
+  if (queueId != NULL_ID) {
+    snd_seq_port_info_set_timestamping(portInfo, 1);
+    snd_seq_port_info_set_timestamp_real(portInfo, 1);
+    snd_seq_port_info_set_timestamp_queue(portInfo, queueId);
+  }
+  int err = snd_seq_create_port(g_sequencerHandle, portInfo);
+  if (err < 0) {
+    return err;
+  }
+  return snd_seq_port_info_get_port(portInfo);
 }
+
+/**
+ * Let the kernel drop the event types blocked by the given filter.
+ *
+ * The ALSA client event filter is a list of admitted types: once a type is registered, the
+ * kernel delivers nothing else. So every type that is not blocked has to be registered.
+ * @param sequencerHandle - the client to be filtered.
+ * @param filter - the event types to block. If the filter is empty, all types are delivered.
+ * @return zero on success or a negative error code.
+ */
+int installEventFilter(snd_seq_t *sequencerHandle, const EventFilter &filter) {
+  if (filter.empty()) {
+    return 0;
+  }
+  for (int type = 0; type < 256; type++) {
+    if (!filter.blocks(type)) {
+      int err = snd_seq_set_client_event_filter(sequencerHandle, type);
+      if (err < 0) {
+        return err;
+      }
+    }
+  }
+  return 0;
+}
+
 int identifierStrToInt(const std::string &identifier) noexcept {
   try {
     return std::stoi(identifier);
@@ -305,24 +402,6 @@ std::vector<PortID> receiverPortGetConnectionsInternal() {
   return result;
 }
 
-midi::Event parseAlsaEvent(const snd_seq_event_t &alsaEvent) {
-  static const midi::Event emptyEvent{};
-  unsigned char pMidiData[MAX_MIDI_EVENT_SIZE];
-  long evLength =
-      snd_midi_event_decode(g_midiEventParserHandle, pMidiData, MAX_MIDI_EVENT_SIZE, &alsaEvent);
-  if (evLength <= 0) {
-    if (evLength == -ENOENT) {
-      // The sequencer event does not correspond to one or more MIDI messages.
-      return emptyEvent; // that's OK ... just ignore
-    }
-    ALSA_ERROR(evLength, "snd_midi_event_decode");
-    return emptyEvent;
-  }
-
-  midi::Event result(pMidiData, pMidiData + evLength);
-  return result;
-}
-
 /**
  * Register a handler that shall be called at regular time-intervals
  * to control the state of the connections to the port.
@@ -370,13 +449,13 @@ PortID defaultConnectionsHandler(const std::string &connectTo, const PortID &con
 /**
  * Open the ALSA sequencer in non-blocking mode.
  */
-void open(const std::string &clientName) noexcept(false) {
+void open(const std::string &clientName, const EventFilter &filter, int inputPool,
+          int inputBuffer) noexcept(false) {
   std::unique_lock<std::mutex> lock{g_stateAccessMutex};
   if (g_stateFlag != State::closed) {
     throw BadStateException("Cannot open ALSA client. Wrong state " + stateAsString(g_stateFlag));
   }
   snd_seq_t *newSequencerHandle;
-  snd_midi_event_t *newParserHandle;
   int err;
   // open sequencer (do we need a duplex stream?).
   err = snd_seq_open(&newSequencerHandle, "default", SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK);
@@ -390,19 +469,30 @@ void open(const std::string &clientName) noexcept(false) {
     throw std::runtime_error("ALSA cannot set client name.");
   }
 
-  // create the event parser
-  err = snd_midi_event_new(MAX_MIDI_EVENT_SIZE, &newParserHandle);
-  if (ALSA_ERROR(err, "snd_midi_event_new")) {
-    throw std::runtime_error("ALSA cannot create MIDI parser.");
+  // let the kernel drop the events we are not interested in.
+  err = installEventFilter(newSequencerHandle, filter);
+  if (ALSA_ERROR(err, "snd_seq_set_client_event_filter")) {
+    throw std::runtime_error("ALSA cannot set the event filter.");
+  }
+  if (!filter.empty()) {
+    SPDLOG_LOGGER_INFO(g_logger, "{} event types are filtered by the kernel.",
+                       filter.blockedCount());
+  }
+
+  // make room for bursts, in the kernel and in alsa-lib.
+  err = snd_seq_set_client_pool_input(newSequencerHandle, inputPool);
+  if (ALSA_ERROR(err, "snd_seq_set_client_pool_input")) {
+    throw std::runtime_error("ALSA cannot set the input pool size.");
+  }
+  err = snd_seq_set_input_buffer_size(newSequencerHandle,
+                                      inputBuffer * sizeof(snd_seq_event_t));
+  if (ALSA_ERROR(err, "snd_seq_set_input_buffer_size")) {
+    throw std::runtime_error("ALSA cannot set the input buffer size.");
   }
-  snd_midi_event_init(newParserHandle);
-  snd_midi_event_no_status(newParserHandle, 1); // no running status byte!!!
-  SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::open - MIDI Event parser created.");
 
   // set common variables.
   g_portId = NULL_ID;
   g_sequencerHandle = newSequencerHandle;
-  g_midiEventParserHandle = newParserHandle;
   g_clientId = snd_seq_client_id(g_sequencerHandle);
   if (ALSA_ERROR(g_clientId, "snd_seq_client_id")) {
     throw std::runtime_error("ALSA cannot create client");
@@ -424,12 +514,16 @@ void open(const std::string &clientName) noexcept(false) {
  * @param connectTo - the designation of a sender-port that this port shall try to connect.
  * If the connection fails, the port is nevertheless created. An empty string denotes
  * that no connection shall be attempted.
+ * @param kernelTimestamps - if true, an ALSA queue is created and the kernel stamps every
+ * incoming event with the real time of its arrival. Otherwise, the events are stamped when
+ * the listener thread picks them up, so that all events of a burst get the same time stamp.
  * @return the input port.
  * @throws BadStateException - if port creation is attempted from a state other than `idle`.
  * @throws ServerException - if the ALSA server has encountered a problem.
  */
 ReceiverPort newReceiverPort(const std::string &portName,
-                             const std::string &connectTo) noexcept(false) {
+                             const std::string &connectTo,
+                             bool kernelTimestamps) noexcept(false) {
   std::unique_lock<std::mutex> lock{g_stateAccessMutex};
   if (g_stateFlag != State::idle) {
     throw BadStateException("Cannot create input port. Wrong state " + stateAsString(g_stateFlag));
@@ -437,11 +531,13 @@ ReceiverPort newReceiverPort(const std::string &portName,
   if (g_portId != NULL_ID) {
     throw ServerException("Cannot create more that one port.");
   }
-  g_portId = snd_seq_create_simple_port(g_sequencerHandle, portName.c_str(),
-                                        SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
-                                        SND_SEQ_PORT_TYPE_APPLICATION);
+  if (kernelTimestamps) {
+    g_queueId = createTimestampQueue(portName);
+  }
+  g_portId = createPort(portName, g_queueId);
   if (ALSA_ERROR(g_portId, "create port")) {
     g_portId = NULL_ID;
+    freeTimestampQueue();
     throw std::runtime_error("ALSA cannot create port");
   }
   SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::newInputAlsaPort - port \"{}\" created.", portName);
@@ -475,16 +571,15 @@ void close() noexcept {
   }
   // make sure that the input queue is stopped.
   stopInternal();
+  freeTimestampQueue();
 
   SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::closeAlsaSequencer - closing client {}.", g_clientId);
-  snd_midi_event_free(g_midiEventParserHandle);
   int err = snd_seq_close(g_sequencerHandle);
   ALSA_ERROR(err, "close sequencer");
 
   // reset common variables to their null values.
   g_portId = NULL_ID;
   g_sequencerHandle = nullptr;
-  g_midiEventParserHandle = nullptr;
   g_clientId = NULL_ID;
   g_stateFlag = State::closed;
 }
@@ -538,10 +633,13 @@ State state() {
  * Once activation succeeds, the `alsaClient` is in `running` state and
  * will listen for incoming MIDI events.
  * @param clock - the clock to be used to timestamp incoming events.
+ * @param busyPoll - how the listener thread waits for incoming events (see `BusyPoll`).
+ * @param realtime - the scheduling of the listener and monitor threads and the memory locking.
  * @throws BadStateException - if activation is attempted from a state other than `connected`.
  * @throws ServerException - if the ALSA server has encountered a problem.
  */
-void activate(a2jmidi::ClockPtr clock) noexcept(false) {
+void activate(a2jmidi::ClockPtr clock, const BusyPoll &busyPoll,
+              const a2jmidi::RealtimeSettings &realtime) noexcept(false) {
   std::unique_lock<std::mutex> lock{g_stateAccessMutex};
   if (g_stateFlag != State::idle) {
     throw BadStateException("Cannot create activate. Wrong state " + stateAsString(g_stateFlag));
@@ -549,7 +647,7 @@ void activate(a2jmidi::ClockPtr clock) noexcept(false) {
   if (!clock) {
     throw std::runtime_error("Clock pointer empty.");
   }
-  activateInternal(std::move(clock));
+  activateInternal(std::move(clock), busyPoll, realtime);
   g_stateFlag = State::running;
   // make sure that the port monitor runs at least once.
   std::this_thread::sleep_for(MONITOR_INTERVAL);
@@ -565,20 +663,21 @@ void stop() noexcept {
 }
 
 int retrieve(const a2jmidi::TimePoint deadline, const RetrieveCallback &forEachClosure) noexcept {
-  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
-  if (g_stateFlag != State::running) {
+  // no lock here! The receiverQueue makes sure that `stop()` and `close()`
+  // wait until we have left the `process()` call below.
+  if (g_stateFlag.load() != State::running) {
     return -1;
   }
 
   int err = 0;
 
   // we define the procedure to be executed on each MIDI event in the queue
-  auto processClosure = [&forEachClosure, &err](const snd_seq_event_t &event,
+  // (the events have already been decoded by the listener thread).
+  auto processClosure = [&forEachClosure, &err](const unsigned char *midiData, int size,
                                                 a2jmidi::TimePoint timeStamp) {
-    const midi::Event midiEvent = parseAlsaEvent(event);
-    if (!midiEvent.empty() && !err) {
+    if (!err) {
       // we delegate to the given forEachClosure
-      err = forEachClosure(midiEvent, timeStamp);
+      err = forEachClosure(midi::Event(midiData, size), timeStamp);
     }
   };
   // apply the processClosure on the queue
@@ -586,4 +685,11 @@ int retrieve(const a2jmidi::TimePoint deadline, const RetrieveCallback &forEachC
   return err;
 }
 
+int discardPending() noexcept {
+  if (g_stateFlag.load() != State::running) {
+    return 0;
+  }
+  return alsaClient::receiverQueue::discard();
+}
+
 } // namespace alsaClient
@@ -20,10 +20,14 @@
 #define A_J_MIDI_SRC_ALSA_CLIENT_H
 
 #include "a2jmidi_clock.h"
+#include "busy_poll.h"
+#include "event_filter.h"
+#include "realtime.h"
 #include "midi.h"
 #include "sys_clock.h"
 #include <alsa/asoundlib.h>
 #include <functional>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -32,6 +36,20 @@
 namespace alsaClient {
 
 constexpr int NULL_ID = -1;
+/**
+ * The largest number of events that the kernel can hold for one client (its input pool).
+ */
+constexpr int MAX_INPUT_POOL = 2000;
+/**
+ * The size of the input pool, unless specified otherwise. The kernel default (200 events)
+ * overflows during bursts, such as a controller dump or a full MIDI file played at once.
+ */
+constexpr int DEFAULT_INPUT_POOL = MAX_INPUT_POOL;
+/**
+ * The number of events alsa-lib reads from the kernel with one system call, unless specified
+ * otherwise. The alsa-lib default is 500 events.
+ */
+constexpr int DEFAULT_INPUT_BUFFER = 2000;
 struct PortID {
 public:
   int client;
@@ -141,6 +159,11 @@ using OnMonitorConnectionsHandler = std::function<PortID(const std::string &conn
  */
 void onMonitorConnections(const OnMonitorConnectionsHandler &handler) noexcept(false) ;
 
+/**
+ * Serializes the control functions (`open`, `activate`, `stop`, `close` ...).
+ * The real-time function `retrieve` never acquires it.
+ */
+extern std::mutex g_stateAccessMutex;
 
 } // namespace impl
 
@@ -183,9 +206,17 @@ State state();
  *
  * @param clientName - a desired name for this client.
  * The server may modify this name to create a unique variant, if needed.
+ * @param filter - the event types that the kernel shall not deliver to this client. The filter
+ * applies to the whole client, and therefore also to the port created by `newReceiverPort`.
+ * @param inputPool - the number of events the kernel can hold for this client, at most
+ * `MAX_INPUT_POOL`. When the pool is exhausted, the kernel drops events (see
+ * `receiverQueue::getOverrunCount()`).
+ * @param inputBuffer - the number of events alsa-lib reads from the kernel at once.
  * @throws BadStateException - if the `alsaClient` is not in `closed` state.
  */
-void open(const std::string &clientName) noexcept(false);
+void open(const std::string &clientName, const EventFilter &filter = EventFilter{},
+          int inputPool = DEFAULT_INPUT_POOL,
+          int inputBuffer = DEFAULT_INPUT_BUFFER) noexcept(false);
 /**
  * In future, we might introduce a dedicated `ReceiverPort` class.
  */
@@ -204,12 +235,16 @@ using ReceiverPort = void;
  * @param connectTo - the designation of a sender-port that this port shall try to connect.
  * If the connection fails, the port is nevertheless created. An empty string denotes
  * that no connection shall be attempted.
+ * @param kernelTimestamps - if true, an ALSA queue is created and the kernel stamps every
+ * incoming event with the real time of its arrival. Otherwise, the events are stamped when
+ * the listener thread picks them up, so that all events of a burst get the same time stamp.
  * @return the input port.
  * @throws BadStateException - if port creation is attempted from a state other than `idle`.
  * @throws ServerException - if the ALSA server has encountered a problem.
  */
 ReceiverPort newReceiverPort(const std::string &portName,
-                             const std::string &connectTo = "") noexcept(false);
+                             const std::string &connectTo = "",
+                             bool kernelTimestamps = false) noexcept(false);
 
 /**
  * List all ports that are connected to the ReceiverPort.
@@ -226,10 +261,14 @@ std::vector<PortID> receiverPortGetConnections();
  * Once activation succeeds, the `alsaClient` is in `running` state and
  * will listen for incoming MIDI events.
  * @param clock - the clock to be used to timestamp incoming events.
+ * @param busyPoll - how the listener thread waits for incoming events (see `BusyPoll`).
+ * @param realtime - the scheduling and the CPUs of the listener and monitor threads, and
+ * whether the memory shall be locked and the heap prefaulted before the threads start.
  * @throws BadStateException - if activation is attempted from a state other than `connected`.
  * @throws ServerException - if the ALSA server has encountered a problem.
  */
-void activate(a2jmidi::ClockPtr clock) noexcept(false);
+void activate(a2jmidi::ClockPtr clock, const BusyPoll &busyPoll = BusyPoll{},
+              const a2jmidi::RealtimeSettings &realtime = {}) noexcept(false);
 /**
  * Tell the  ALSA server to stop listening for incoming events.
  *
@@ -245,7 +284,7 @@ void close() noexcept;
 
 /**
  * The function type to be used in the `retrieve` call.
- * @param event - the current MIDI event.
+ * @param event - the current MIDI event. It is only valid for the duration of the call.
  * @param timeStamp - the point in time when the event was recorded.
  * @return a non zero value if an error occurred.
  */
@@ -259,11 +298,24 @@ using RetrieveCallback =
  *
  * All processed events will be removed from the input queue (and from memory).
  *
+ * __Real-time guarantee__: this function is meant to be called from the JACK process
+ * callback. It takes no lock, it never waits for the control functions (`activate`,
+ * `stop`, `close`, connection monitoring ...) and it never sleeps.
+ *
  * @param deadline - the time limit beyond which events will remain in the queue.
  * @param forEachClosure - the function to execute on each Event. It must be of type `ProcessCallback`.
  * @return zero on success, a non zero value if an error occurred.
  */
 int retrieve(a2jmidi::TimePoint deadline, const RetrieveCallback &forEachClosure) noexcept;
+
+/**
+ * Remove all events that have been received so far, without retrieving them.
+ *
+ * __Real-time guarantee__: the same as for `retrieve()`.
+ *
+ * @return the number of events removed.
+ */
+int discardPending() noexcept;
 /**
  * The client-name aka device-name identifies a midi device or an application.
  * @return the name chosen by the ALSA system.
@@ -0,0 +1,203 @@
+/*
+ * File: alsa_event_decoder.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_ALSA_EVENT_DECODER_H
+#define A_J_MIDI_SRC_ALSA_EVENT_DECODER_H
+
+#include <alsa/asoundlib.h>
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+namespace alsaClient {
+
+/**
+ * How the MIDI bytes are obtained from a sequencer event.
+ */
+enum class Layout : unsigned char {
+  none,                ///< the event does not correspond to a MIDI message.
+  note,                ///< status, note, velocity.
+  control,             ///< status, controller (param), value.
+  value,               ///< status, value.
+  pitchBend,           ///< status, LSB, MSB of value + 8192.
+  songPosition,        ///< status, LSB, MSB of value.
+  statusOnly,          ///< a single status byte.
+  sysex,               ///< the bytes of the variable length data.
+  control14,           ///< a 14 bit controller: MSB and LSB as two control changes.
+  nonRegisteredParam,  ///< four control changes (NRPN number, data entry).
+  registeredParam,     ///< four control changes (RPN number, data entry).
+};
+
+/**
+ * One entry of the decoding table.
+ */
+struct Decoding {
+  Layout layout{Layout::none};
+  unsigned char status{0}; ///< the status byte (without channel).
+};
+
+/**
+ * Build the decoding table, indexed by the sequencer event type.
+ */
+constexpr std::array<Decoding, 256> makeDecodingTable() {
+  std::array<Decoding, 256> table{};
+  table[SND_SEQ_EVENT_NOTEOFF] = {Layout::note, 0x80};
+  table[SND_SEQ_EVENT_NOTEON] = {Layout::note, 0x90};
+  table[SND_SEQ_EVENT_KEYPRESS] = {Layout::note, 0xA0};
+  table[SND_SEQ_EVENT_CONTROLLER] = {Layout::control, 0xB0};
+  table[SND_SEQ_EVENT_PGMCHANGE] = {Layout::value, 0xC0};
+  table[SND_SEQ_EVENT_CHANPRESS] = {Layout::value, 0xD0};
+  table[SND_SEQ_EVENT_PITCHBEND] = {Layout::pitchBend, 0xE0};
+  table[SND_SEQ_EVENT_SYSEX] = {Layout::sysex, 0xF0};
+  table[SND_SEQ_EVENT_QFRAME] = {Layout::value, 0xF1};
+  table[SND_SEQ_EVENT_SONGPOS] = {Layout::songPosition, 0xF2};
+  table[SND_SEQ_EVENT_SONGSEL] = {Layout::value, 0xF3};
+  table[SND_SEQ_EVENT_TUNE_REQUEST] = {Layout::statusOnly, 0xF6};
+  table[SND_SEQ_EVENT_CLOCK] = {Layout::statusOnly, 0xF8};
+  table[SND_SEQ_EVENT_START] = {Layout::statusOnly, 0xFA};
+  table[SND_SEQ_EVENT_CONTINUE] = {Layout::statusOnly, 0xFB};
+  table[SND_SEQ_EVENT_STOP] = {Layout::statusOnly, 0xFC};
+  table[SND_SEQ_EVENT_SENSING] = {Layout::statusOnly, 0xFE};
+  table[SND_SEQ_EVENT_RESET] = {Layout::statusOnly, 0xFF};
+  table[SND_SEQ_EVENT_CONTROL14] = {Layout::control14, 0xB0};
+  table[SND_SEQ_EVENT_NONREGPARAM] = {Layout::nonRegisteredParam, 0xB0};
+  table[SND_SEQ_EVENT_REGPARAM] = {Layout::registeredParam, 0xB0};
+  return table;
+}
+
+/**
+ * The decoding of each sequencer event type, computed at compile time.
+ */
+constexpr std::array<Decoding, 256> DECODING_TABLE = makeDecodingTable();
+
+/**
+ * The largest number of bytes a fixed length event decodes to (an (N)RPN message).
+ */
+constexpr int MAX_DECODED_SIZE = 12;
+
+/**
+ * Translate an ALSA-sequencer-event into MIDI 1.0 bytes.
+ *
+ * The result is the same as with alsa-lib's `snd_midi_event_decode()` on a parser set to
+ * `snd_midi_event_no_status(parser, 1)`: every message starts with its status byte. Unlike
+ * the alsa-lib parser, this function has no state; it can be called from any thread and
+ * never allocates.
+ * @param event - the event to decode.
+ * @param buffer - receives the MIDI bytes.
+ * @param capacity - the size of the buffer.
+ * @return the number of bytes, `-ENOENT` if the event does not correspond to a MIDI message,
+ * `-ENOMEM` if the buffer is too small, `-EINVAL` for a SysEx event whose data is not of
+ * variable length (this is checked before the size of the buffer).
+ */
+inline long decodeEvent(const snd_seq_event_t &event, unsigned char *buffer,
+                        long capacity) noexcept {
+  const Decoding decoding = DECODING_TABLE[event.type];
+  // data.note.channel and data.control.channel are at the same place.
+  const auto channelStatus =
+      static_cast<unsigned char>(decoding.status | (event.data.note.channel & 0x0FU));
+  const unsigned int param = event.data.control.param;
+  const int value = event.data.control.value;
+  unsigned char bytes[MAX_DECODED_SIZE];
+  long size = 0;
+  auto put = [&bytes, &size](unsigned int byte) {
+    bytes[size++] = static_cast<unsigned char>(byte);
+  };
+  // the controller numbers of (N)RPN: parameter MSB, parameter LSB, data entry MSB and LSB.
+  constexpr unsigned char nrpnControllers[4] = {0x63, 0x62, 0x06, 0x26};
+  constexpr unsigned char rpnControllers[4] = {0x65, 0x64, 0x06, 0x26};
+
+  switch (decoding.layout) {
+  case Layout::none:
+    return -ENOENT;
+  case Layout::note:
+    put(channelStatus);
+    put(event.data.note.note & 0x7FU);
+    put(event.data.note.velocity & 0x7FU);
+    break;
+  case Layout::control:
+    put(channelStatus);
+    put(param & 0x7FU);
+    put(value & 0x7F);
+    break;
+  case Layout::value:
+    put(decoding.status < 0xF0 ? channelStatus : decoding.status);
+    put(value & 0x7F);
+    break;
+  case Layout::pitchBend:
+    put(channelStatus);
+    put((value + 8192) & 0x7F);
+    put(((value + 8192) >> 7) & 0x7F);
+    break;
+  case Layout::songPosition:
+    put(decoding.status);
+    put(value & 0x7F);
+    put((value >> 7) & 0x7F);
+    break;
+  case Layout::statusOnly:
+    put(decoding.status);
+    break;
+  case Layout::sysex: {
+    // like snd_midi_event_decode: only variable length data (not fixed, not VARUSR).
+    if ((event.flags & SND_SEQ_EVENT_LENGTH_MASK) != SND_SEQ_EVENT_LENGTH_VARIABLE) {
+      return -EINVAL;
+    }
+    const long length = event.data.ext.len;
+    if (capacity < length) {
+      return -ENOMEM;
+    }
+    std::memcpy(buffer, event.data.ext.ptr, length);
+    return length;
+  }
+  case Layout::control14:
+    if (param < 32) {
+      put(channelStatus);
+      put(param);
+      put((value >> 7) & 0x7F);
+      put(channelStatus);
+      put(param + 32);
+      put(value & 0x7F);
+    } else {
+      put(channelStatus);
+      put(param & 0x7FU);
+      put(value & 0x7F);
+    }
+    break;
+  case Layout::nonRegisteredParam:
+  case Layout::registeredParam: {
+    const unsigned char *controllers =
+        (decoding.layout == Layout::registeredParam) ? rpnControllers : nrpnControllers;
+    const unsigned int data[4] = {(param & 0x3F80U) >> 7, param & 0x7FU,
+                                  (static_cast<unsigned int>(value) & 0x3F80U) >> 7,
+                                  static_cast<unsigned int>(value) & 0x7FU};
+    for (int i = 0; i < 4; i++) {
+      put(channelStatus);
+      put(controllers[i]);
+      put(data[i]);
+    }
+    break;
+  }
+  }
+  if (capacity < size) {
+    return -ENOMEM;
+  }
+  std::memcpy(buffer, bytes, size);
+  return size;
+}
+
+} // namespace alsaClient
+#endif // A_J_MIDI_SRC_ALSA_EVENT_DECODER_H
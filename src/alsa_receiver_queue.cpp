@@ -17,63 +17,98 @@
  * limitations under the License.
  */
 #include "alsa_receiver_queue.h"
+#include "alsa_event_decoder.h"
+#include "jitter_estimator.h"
+#include "realtime.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
-#include <forward_list>
+#include "spsc_ring.h"
+#include "sysex_arena.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <poll.h>
+#include <thread>
 #include <utility>
 
 namespace alsaClient::receiverQueue {
 static auto g_logger = spdlog::stdout_color_mt("alsa_receiver_queue");
-class AlsaEventBatch;
+
+static std::atomic<bool> g_carryOnFlag{false}; ///< when false, the receiverQueue will be shut down.
 /**
- * A smart pointer that owns and manages an AlsaEventBatch-object through a pointer and
- * disposes of that object when the AlsaEventPtr goes out of scope.
+ * the time in milliseconds between two consecutive tests of the carryOnFlag.
  */
-using AlsaEventPtr = std::unique_ptr<AlsaEventBatch>;
+constexpr int SHUTDOWN_POLL_PERIOD_MS = 10;
 /**
- * The FutureAlsaEvents provides the mechanism to access the result
- * of asynchronously listen for incoming Alsa sequencer events.
- *
- * Once an event is received, the future is said to be ready.
- * and the received sequencer-event can be retrieved through the
- * function FutureAlsaEvents::get().
- *
- * When a future gets ready it recursively starts the
- * next FutureAlsaEvents.
+ * The pause before the listener thread resumes after an unexpected ALSA error.
  */
-using FutureAlsaEvents = std::future<AlsaEventPtr>;
+constexpr int LISTENER_RESTART_DELAY_MS = 10;
 
 /**
- * A container that can hold several sequencer events.
+ * The state is read without lock by the real-time consumer (see `process()`).
  */
-using EventList = std::forward_list<snd_seq_event_t>;
-
-static std::atomic<bool> g_carryOnFlag{false}; ///< when false, the receiverQueue will be shut down.
+static std::atomic<State> g_stateFlag{State::stopped};
 /**
- * the time in milliseconds between two consecutive tests of the carryOnFlag.
+ * True while the consumer is inside `process()`. The `stop()` function waits
+ * for it to become false before it empties the queue.
  */
-constexpr int SHUTDOWN_POLL_PERIOD_MS = 10;
-
-static State g_stateFlag{State::stopped};
+static std::atomic<bool> g_consumerActive{false};
 
 /**
- * The number of event-batches currently stored in the queue.
+ * The number of sequencer events discarded because the queue was full.
+ */
+static std::atomic<int> g_lostEventCount{0};
+/**
+ * The number of SysEx messages discarded (too long, arena full or incomplete).
+ */
+static std::atomic<int> g_lostSysexCount{0};
+/**
+ * The number of times the listener thread was woken up by incoming events.
+ */
+static std::atomic<long> g_wakeUpCount{0};
+/**
+ * The number of MIDI messages stored into the queue.
+ */
+static std::atomic<long> g_receivedEventCount{0};
+/**
+ * The number of times the kernel reported that this client's input pool had overflowed.
+ */
+static std::atomic<int> g_overrunCount{0};
+/**
+ * The number of times the listener thread resumed after an unexpected error.
  */
-static std::atomic<int> g_currentEventBatchCount{0};
+static std::atomic<int> g_listenerRestartCount{0};
 /**
- * The first (and oldest) element in the receiverQueue.
+ * The largest number of slots that were simultaneously in use since `start()`.
  */
-static FutureAlsaEvents g_queueHead{};
+static std::atomic<int> g_poolHighWatermark{0};
 /**
- * Protects the receiverQueue from being simultaneously accessed by multiple threads.
+ * The one and only thread that listens for incoming events.
  */
-static std::mutex g_queueAccessMutex;
+static std::thread g_listenerThread;
+inline namespace impl {
+/**
+ * Protects the receiverQueue from being simultaneously accessed by multiple control threads.
+ * The consumer (`process()`) does not use this mutex.
+ */
+std::mutex g_queueAccessMutex;
+} // namespace impl
 /**
  * The clock to be used for timestamping incoming events.
  */
 static a2jmidi::ClockPtr g_clock;
+/**
+ * The ALSA queue that stamps incoming events, or `NO_TIMESTAMP_QUEUE`.
+ */
+static int g_timestampQueue{NO_TIMESTAMP_QUEUE};
+/**
+ * How the listener thread waits for incoming events.
+ */
+static BusyPoll g_busyPoll{};
+/**
+ * The scheduling and the CPU of the listener thread.
+ */
+static a2jmidi::ThreadSettings g_listenerSettings{};
 
 /**
  * Error handling for ALSA functions.
@@ -92,74 +127,82 @@ void checkAlsa(const char *operation, int alsaResult) {
   }
 }
 
+static_assert(MAX_MIDI_EVENT_SIZE >= MAX_DECODED_SIZE, "a decoded event must fit a record");
+
 /**
- * The class AlsaEventBatch wraps the midi data and sequencer instructions
- * recorded at one precise point of time.
+ * A MIDI message, decoded from an ALSA-sequencer-event and ready to be written
+ * into a JACK buffer.
+ */
+struct MidiRecord {
+  a2jmidi::TimePoint timeStamp{0};           ///< the time point when the event was recorded.
+  int size{0};                               ///< the number of valid bytes.
+  unsigned char data[MAX_MIDI_EVENT_SIZE]{}; ///< the raw MIDI bytes.
+  const unsigned char *sysex{nullptr}; ///< the bytes in the SysEx arena, instead of `data`.
+  std::size_t sysexEnd{0};             ///< releases the SysEx bytes (see `SysexArena`).
+};
+
+/**
+ * An AlsaEventBatch is a slot of the pool. It holds the MIDI messages
+ * that the listener thread found together in the sequencer FIFO, in the order of their arrival.
+ *
+ * Without a timestamp queue, all events of a batch carry the same time stamp. With
+ * a timestamp queue, each event carries its own (non decreasing) time stamp and the
+ * consumer may leave the tail of a batch for a later period.
  *
- * It holds a pointer to the next FutureAlsaEvents, thus every AlsaEventBatch forms
- * the head of a queue of recorded `AlsaEventBatch`s.
+ * The slots are allocated once, when the queue is started, and are recycled
+ * as soon as `process()` has consumed them. A burst of more than `BATCH_CAPACITY`
+ * events occupies several consecutive slots.
  */
 struct AlsaEventBatch {
-private:
-  FutureAlsaEvents m_next;
-  EventList m_eventList;
-  const a2jmidi::TimePoint m_timeStamp;
-
-public:
-  /**
-   * Constructor for an ALSA Events Batch container.
-   * @param next - a pointer to the next ALSA event
-   * @param eventList - the recorded ALSA sequencer data.
-   * @param timeStamp - the time point when the events were recorded.
-   */
-  AlsaEventBatch(FutureAlsaEvents next, EventList eventList, a2jmidi::TimePoint timeStamp)
-      : m_next{std::move(next)}, m_eventList{std::move(eventList)}, m_timeStamp{timeStamp} {
-    g_currentEventBatchCount++;
-    SPDLOG_LOGGER_TRACE(g_logger, "AlsaEventBatch::constructor, event-count {}, state {}",
-                        g_currentEventBatchCount, g_stateFlag);
-  }
-
-  AlsaEventBatch(const AlsaEventBatch &other) = delete; // no copy constructor
+  int eventCount{0};                   ///< the number of valid entries in `events`.
+  int consumedCount{0};                ///< the number of entries already processed.
+  MidiRecord events[BATCH_CAPACITY]{}; ///< the recorded MIDI messages.
+}; // AlsaEventBatch
 
-  AlsaEventBatch &operator=(const AlsaEventBatch &other) = delete; // no copy assignment
+/**
+ * The pool of event-batches, in the order of their arrival.
+ * The listener thread is the only producer, the `process` function the only consumer.
+ */
+static a2jmidi::SpscRing<AlsaEventBatch> g_queue;
 
-  ~AlsaEventBatch() {
-    g_currentEventBatchCount--;
-    SPDLOG_LOGGER_TRACE(g_logger, "AlsaEventBatch::destructor, event-count {}, state {}",
-                        g_currentEventBatchCount, g_stateFlag);
-  }
+/**
+ * Holds the bytes of the SysEx messages in the queue. The listener thread reassembles the
+ * messages, the consumer releases them once processed.
+ */
+static a2jmidi::SysexArena g_sysexArena;
 
-  /**
-   * Consume the next Future.
-   *
-   * The returned value points to the head of a queue of interleaved Futures and
-   * Midi Events.
-   *
-   * This function passes the ownership of the next FutureAlsaEvents to the
-   * caller by moving the pointer to the caller. This means, this function can only be
-   * called once on a given AlsaEventBatch instance.
-   *
-   * @return a unique pointer to the next future midi event.
-   */
-  [[nodiscard]] FutureAlsaEvents grabNext() {
-    SPDLOG_LOGGER_TRACE(g_logger, "AlsaEventBatch::grabNext");
-    return std::move(m_next);
-  }
+/**
+ * Get the number of event-batches currently stored in the queue (each holding up to
+ * `BATCH_CAPACITY` events).
+ * @return the number of batches in the queue.
+ */
+int getCurrentEventBatchCount() { return static_cast<int>(g_queue.size()); }
 
-  /**
-   * Indicates the point in time when the events in this batch have been recorded.
-   * @return the point in time when the events in this batch have been recorded.
-   */
-  a2jmidi::TimePoint getTimeStamp() const { return m_timeStamp; }
+/**
+ * @return the number of slots in the pool of event-batches.
+ */
+int getPoolCapacity() { return static_cast<int>(g_queue.capacity()); }
 
-  const EventList &getEventList() { return m_eventList; }
-}; // AlsaEventBatch
+/**
+ * @return the largest number of slots that were simultaneously in use since `start()`.
+ */
+int getPoolHighWatermark() { return g_poolHighWatermark; }
 
 /**
- * Get the number of events currently stored in the queue.
- * @return the number of events in the queue.
+ * Get the number of events that had to be discarded because the queue was full.
+ * @return the number of discarded events.
  */
-int getCurrentEventBatchCount() { return g_currentEventBatchCount; }
+int getLostEventCount() { return g_lostEventCount; }
+
+int getLostSysexCount() { return g_lostSysexCount; }
+
+long getWakeUpCount() { return g_wakeUpCount; }
+
+long getReceivedEventCount() { return g_receivedEventCount; }
+
+int getOverrunCount() { return g_overrunCount; }
+
+int getListenerRestartCount() { return g_listenerRestartCount; }
 
 /**
  * Indicates the state of the current `receiverQueue`.
@@ -171,57 +214,43 @@ State getState() {
   return g_stateFlag;
 }
 
-inline void invokeClosureForeachEvent(const EventList &eventsList, a2jmidi::TimePoint current,
+/**
+ * Invoke the closure on the events of the given batch that were recorded before the deadline.
+ * @return true if the whole batch has been consumed.
+ */
+inline bool invokeClosureForeachEvent(AlsaEventBatch &batch, a2jmidi::TimePoint deadline,
                                       const ProcessCallback &closure) {
-  for (const auto &event : eventsList) {
-    closure(event, current);
+  for (; batch.consumedCount < batch.eventCount; batch.consumedCount++) {
+    const MidiRecord &record = batch.events[batch.consumedCount];
+    if (record.timeStamp >= deadline) {
+      // this event (and all that follow) belong to a later period.
+      return false;
+    }
+    if (record.sysex) {
+      closure(record.sysex, record.size, record.timeStamp);
+      g_sysexArena.release(record.sysexEnd);
+    } else {
+      closure(record.data, record.size, record.timeStamp);
+    }
   }
+  return true;
 }
 
 /**
- * Indicates whether the given FutureAlsaEvents is ready to deliver a result.
- * @return true - if there is a result,
- *         false - if the future is still waiting for an incoming MIDI event.
+ * The not-synchronized version of `process()`.
+ *
+ * Consumes the oldest events from the queue until the queue is empty or
+ * until an event recorded at or after the deadline is found.
+ * @param deadline - the time limit beyond which events will remain in the queue.
+ * @param closure - the function to execute on each Event.
  */
-bool isReady(const FutureAlsaEvents &futureAlsaEvent) {
-  if (!futureAlsaEvent.valid()) {
-    return false;
-  }
-  // get status, waiting for the shortest possible time.
-  auto status = futureAlsaEvent.wait_for(std::chrono::microseconds(0));
-  bool result = (status == std::future_status::ready);
-  // SPDLOG_LOGGER_TRACE(g_logger,"receiverQueue::isReady - {}", result);
-  return result;
-}
-
-FutureAlsaEvents processInternal(FutureAlsaEvents &&queueHeadInternal, a2jmidi::TimePoint deadline,
-                                 const ProcessCallback &closure) {
-  //  SPDLOG_LOGGER_TRACE(g_logger,"receiverQueue::processInternal() - event-count {}, deadline {}
-  //  us",
-  //                currentEventBatchCount,
-  //                std::chrono::duration<double,std::micro>(Sys_clock::now()-deadline).count());
-
-  while (isReady(queueHeadInternal)) {
-    try {
-      AlsaEventPtr alsaEvents = queueHeadInternal.get(); // might throw when queue has been stopped.
-      auto timestamp = alsaEvents->getTimeStamp();
-      if (timestamp >= deadline) {
-        // we have prematurely retrieved some AlsaEvents.
-        // We must give them back. To this end, we will repack them
-        // again into a FutureAlsaEvents object.
-        std::promise<AlsaEventPtr> restartEvents;
-        restartEvents.set_value(std::move(alsaEvents));
-        return restartEvents.get_future();
-      }
-      invokeClosureForeachEvent(alsaEvents->getEventList(), timestamp, closure);
-      queueHeadInternal = std::move(alsaEvents->grabNext());
-    } catch (const InterruptedException &) {
-      // we have tried to get an alsaEventPtr from a future that has been stopped.
-      // So we will stop here.
-      break;
+void processInternal(a2jmidi::TimePoint deadline, const ProcessCallback &closure) {
+  while (AlsaEventBatch *queueHead = g_queue.front()) {
+    if (!invokeClosureForeachEvent(*queueHead, deadline, closure)) {
+      return;
     }
+    g_queue.pop(); // recycle the slot
   }
-  return std::move(queueHeadInternal);
 }
 
 /**
@@ -232,90 +261,321 @@ FutureAlsaEvents processInternal(FutureAlsaEvents &&queueHeadInternal, a2jmidi::
  *
  * All processed events will be removed from the queue (and from memory).
  *
+ * This function takes no lock. It announces itself through `g_consumerActive`
+ * and then checks the state; `stopInternal()` does the same in reverse order.
+ * Thanks to the sequential consistency of both atomics, either the consumer sees
+ * that the queue is stopping, or the stopping thread sees the consumer and waits for it.
+ *
  * @param deadline - the time limit beyond which events will remain in the queue.
  * @param closure - the function to execute on each Event. It must be of type `processCallback`.
  */
 void process(a2jmidi::TimePoint deadline, const ProcessCallback &closure) noexcept {
-  std::unique_lock<std::mutex> lock{g_queueAccessMutex};
-  if (g_queueHead.valid()) {
-    g_queueHead = std::move(processInternal(std::move(g_queueHead), deadline, closure));
+  g_consumerActive.store(true);
+  if (g_stateFlag.load() == State::running) {
+    processInternal(deadline, closure);
   }
+  g_consumerActive.store(false);
 }
+
+int discard() noexcept {
+  int count = 0;
+  g_consumerActive.store(true);
+  if (g_stateFlag.load() == State::running) {
+    while (AlsaEventBatch *queueHead = g_queue.front()) {
+      for (int i = queueHead->consumedCount; i < queueHead->eventCount; i++) {
+        if (queueHead->events[i].sysex) {
+          g_sysexArena.release(queueHead->events[i].sysexEnd);
+        }
+      }
+      count += queueHead->eventCount - queueHead->consumedCount;
+      g_queue.pop(); // recycle the slot
+    }
+  }
+  g_consumerActive.store(false);
+  return count;
+}
+
+/**
+ * Remove all queued data.
+ * The listener thread must have ceased before calling this function.
+ */
+void clearQueue() {
+  while (g_queue.front()) {
+    g_queue.pop();
+  }
+}
+
 /**
  * The not-synchronized version of `stop()`. It is used internally to avoid dead locks.
  */
 void stopInternal() {
-  SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::stopInternal(), event-count {}, state {}",
-                      g_currentEventBatchCount, g_stateFlag);
+  SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::stopInternal(), batch-count {}",
+                      getCurrentEventBatchCount());
+  // from now on, the consumer will not touch the queue anymore.
+  g_stateFlag.store(State::stopped);
+  // ... but it might still be in the middle of a `process()` call.
+  while (g_consumerActive.load()) {
+    std::this_thread::yield();
+  }
   // this will interrupt processing in "listenForEvents".
   g_carryOnFlag = false;
-  // lets wait until all processes have polled the `carryOnFlag`.
-  std::this_thread::sleep_for(std::chrono::milliseconds(2 * SHUTDOWN_POLL_PERIOD_MS));
-  // remove (delete from memory) all queued data.
-  g_queueHead = std::move(FutureAlsaEvents{/*empty*/});
-
-  g_stateFlag = State::stopped;
+  // lets wait until the listener thread has polled the `carryOnFlag`.
+  if (g_listenerThread.joinable()) {
+    g_listenerThread.join();
+  }
+  clearQueue();
+  if (g_lostEventCount > 0) {
+    SPDLOG_LOGGER_INFO(g_logger, "receiverQueue - {} events discarded, the queue was full.",
+                       g_lostEventCount.load());
+  }
+  if (g_wakeUpCount > 0) {
+    SPDLOG_LOGGER_INFO(g_logger, "receiverQueue - {} wake-ups for {} MIDI messages.",
+                       g_wakeUpCount.load(), g_receivedEventCount.load());
+  }
+  if (g_lostSysexCount > 0) {
+    SPDLOG_LOGGER_INFO(g_logger, "receiverQueue - {} SysEx messages discarded.",
+                       g_lostSysexCount.load());
+  }
+  if (g_overrunCount > 0 || g_listenerRestartCount > 0) {
+    SPDLOG_LOGGER_INFO(g_logger, "receiverQueue - {} input overruns, {} listener restarts.",
+                       g_overrunCount.load(), g_listenerRestartCount.load());
+  }
   g_clock.reset();
+  g_timestampQueue = NO_TIMESTAMP_QUEUE;
 }
 
 /**
- * Force all processes to stop listening for incoming events.
+ * Force the listener thread to stop listening for incoming events.
  *
- * This function blocks until all listening processes have
- * ceased.
+ * This function blocks until the listener thread has ceased.
  */
 void stop() noexcept {
-  SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::stop, event-count {}, state {}",
-                      g_currentEventBatchCount, g_stateFlag);
+  SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::stop, batch-count {}",
+                      getCurrentEventBatchCount());
   // we lock access to the queue during the full shutdown-time.
   std::unique_lock<std::mutex> lock{g_queueAccessMutex};
   stopInternal();
 }
 
-// forward declaration.
-FutureAlsaEvents startNextFuture(snd_seq_t *hSequencer);
+/**
+ * Hand the given slot over to the consumer.
+ *
+ * The delay between the time stamp of each event and its publication is reported
+ * to the jitter estimator.
+ * @param batch - the slot obtained from `g_queue.back()`, all its events are stamped.
+ */
+void publishBatch(AlsaEventBatch *batch) {
+  batch->consumedCount = 0;
+  g_queue.publish();
+  const a2jmidi::TimePoint publishedAt = g_clock->now();
+  for (int i = 0; i < batch->eventCount; i++) {
+    a2jmidi::jitter::addWakeUpDelay(publishedAt - batch->events[i].timeStamp);
+  }
+  int occupied = getCurrentEventBatchCount();
+  if (occupied > g_poolHighWatermark.load(std::memory_order_relaxed)) {
+    g_poolHighWatermark.store(occupied, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * Translate an ALSA-sequencer-event into raw MIDI bytes.
+ * @param alsaEvent - the event to decode.
+ * @param record - the record that receives the MIDI bytes.
+ * @return true if the event corresponds to a MIDI message, false otherwise.
+ */
+bool decodeAlsaEvent(const snd_seq_event_t &alsaEvent, MidiRecord &record) {
+  record.sysex = nullptr;
+  long evLength = decodeEvent(alsaEvent, record.data, MAX_MIDI_EVENT_SIZE);
+  if (evLength <= 0) {
+    if (evLength != -ENOENT) {
+      // -ENOENT just means the sequencer event does not correspond to a MIDI message.
+      SPDLOG_LOGGER_ERROR(g_logger, "Cannot decode event - {}", snd_strerror(evLength));
+    }
+    return false;
+  }
+  record.size = static_cast<int>(evLength);
+  return true;
+}
+
+/**
+ * Add a chunk of a SysEx message to the arena.
+ *
+ * The sequencer splits long SysEx messages into several events; the first chunk starts with
+ * 0xF0, the last one ends with 0xF7.
+ * @param alsaEvent - a `SND_SEQ_EVENT_SYSEX` event.
+ * @param record - receives the complete message when the last chunk has arrived.
+ * @return true if the message is complete.
+ */
+bool assembleSysex(const snd_seq_event_t &alsaEvent, MidiRecord &record) {
+  const auto *chunk = static_cast<const unsigned char *>(alsaEvent.data.ext.ptr);
+  const std::size_t size = alsaEvent.data.ext.len;
+  if (size == 0) {
+    return false;
+  }
+  if (chunk[0] == 0xF0) {
+    if (g_sysexArena.isOpen()) {
+      g_lostSysexCount++; // the previous message never ended.
+    }
+    g_sysexArena.begin();
+  } else if (!g_sysexArena.isOpen()) {
+    return false; // the rest of a message that has already been discarded.
+  }
+  if (!g_sysexArena.append(chunk, size)) {
+    g_lostSysexCount++;
+    return false;
+  }
+  if (chunk[size - 1] != 0xF7) {
+    return false; // more chunks to come.
+  }
+  const a2jmidi::SysexArena::Message message = g_sysexArena.finish();
+  record.sysex = message.data;
+  record.size = message.size;
+  record.sysexEnd = message.end;
+  return true;
+}
+
+/**
+ * Relates the real-time of the timestamp queue to the time of `g_clock`.
+ */
+struct ClockMapping {
+  a2jmidi::TimePoint clockNow{0}; ///< the clock time when the mapping was taken.
+  long queueNowNs{0};             ///< the queue time (in nanoseconds) at the same moment.
+  long ticksPerSecond{0};         ///< the resolution of the clock.
+  bool valid{false};              ///< false if the queue time could not be obtained.
+};
+
+inline long toNanoseconds(const snd_seq_real_time_t &time) {
+  return static_cast<long>(time.tv_sec) * 1000000000L + static_cast<long>(time.tv_nsec);
+}
 
 /**
- * Retrieve all events currently in the sequencers FIFO-queue.
+ * Take a snapshot of the clock and of the timestamp queue.
  * @param hSequencer - a handle for the ALSA sequencer.
- * @return the list of sequencer events that were retrieved.
+ * @return the mapping, or an invalid mapping if no timestamp queue is used.
+ */
+ClockMapping takeClockMapping(snd_seq_t *hSequencer) {
+  ClockMapping mapping;
+  mapping.clockNow = g_clock->now();
+  if (g_timestampQueue == NO_TIMESTAMP_QUEUE) {
+    return mapping;
+  }
+  snd_seq_queue_status_t *queueStatus;
+  snd_seq_queue_status_alloca(&queueStatus);
+  int err = snd_seq_get_queue_status(hSequencer, g_timestampQueue, queueStatus);
+  if (err < 0) {
+    SPDLOG_LOGGER_ERROR(g_logger, "Cannot snd_seq_get_queue_status - {}", snd_strerror(err));
+    return mapping;
+  }
+  mapping.queueNowNs = toNanoseconds(*snd_seq_queue_status_get_real_time(queueStatus));
+  mapping.ticksPerSecond = g_clock->ticksPerSecond();
+  mapping.valid = true;
+  return mapping;
+}
+
+/**
+ * Translate the kernel time stamp of an event into a time point of `g_clock`.
+ * @param alsaEvent - the event as delivered by the sequencer.
+ * @param mapping - a recent snapshot of the clock and the timestamp queue.
+ * @return the time point when the event arrived at the receiver port.
  */
-EventList retrieveEvents(snd_seq_t *hSequencer) {
+a2jmidi::TimePoint toTimePoint(const snd_seq_event_t &alsaEvent, const ClockMapping &mapping) {
+  if (!mapping.valid || !snd_seq_ev_is_real(&alsaEvent)) {
+    return mapping.clockNow;
+  }
+  long ageNs = mapping.queueNowNs - toNanoseconds(alsaEvent.time.time);
+  // the division is done last, ageNs * ticksPerSecond fits into 64 bits for ages below one hour.
+  return mapping.clockNow - (ageNs * mapping.ticksPerSecond) / 1000000000L;
+}
+
+/**
+ * The input pool overflowed (the sequencer reported `-ENOSPC`) and the kernel has dropped
+ * the pending events. A SysEx message in progress has lost some of its chunks.
+ */
+void registerOverrun() {
+  g_overrunCount++;
+  if (g_sysexArena.isOpen()) {
+    g_sysexArena.abandon();
+    g_lostSysexCount++;
+  }
+}
+
+/**
+ * Retrieve all events currently in the sequencers FIFO-queue, decode them
+ * and copy them, in the order of their arrival, into free slots of the pool.
+ * @param hSequencer - a handle for the ALSA sequencer.
+ */
+void retrieveEvents(snd_seq_t *hSequencer) {
   SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::retrieveEvents");
   snd_seq_event_t *eventPtr;
-  EventList eventList{};
+  AlsaEventBatch *batch{nullptr};
+  int lostCount{0};
   int sequencerStatus;
+  const ClockMapping mapping = takeClockMapping(hSequencer);
 
   do {
     sequencerStatus = snd_seq_event_input(hSequencer, &eventPtr);
     switch (sequencerStatus) {
-    case -EAGAIN: // sequencers FIFO is empty, return eventList.
+    case -EAGAIN: // sequencers FIFO is empty, publish what we have.
+      break;
+    case -ENOSPC:
+      registerOverrun();
       break;
     default: //
       checkAlsa("snd_seq_event_input", sequencerStatus);
     }
-    if (eventPtr) {
-      eventList.push_front(*eventPtr);
+    if (!eventPtr) {
+      continue;
+    }
+    if (!batch) {
+      batch = g_queue.back();
+      if (!batch) {
+        lostCount++; // the pool is exhausted, the event is discarded.
+        if (eventPtr->type == SND_SEQ_EVENT_SYSEX && g_sysexArena.isOpen()) {
+          g_sysexArena.abandon(); // a chunk is missing.
+          g_lostSysexCount++;
+        }
+        continue;
+      }
+      batch->eventCount = 0;
+    }
+    MidiRecord &record = batch->events[batch->eventCount];
+    if (eventPtr->type == SND_SEQ_EVENT_SYSEX) {
+      if (!assembleSysex(*eventPtr, record)) {
+        continue;
+      }
+    } else if (!decodeAlsaEvent(*eventPtr, record)) {
+      continue;
+    }
+    record.timeStamp = toTimePoint(*eventPtr, mapping);
+    g_receivedEventCount.fetch_add(1, std::memory_order_relaxed);
+    batch->eventCount++;
+    if (batch->eventCount == BATCH_CAPACITY) {
+      publishBatch(batch);
+      batch = nullptr;
     }
   } while (sequencerStatus > 0);
 
-  return eventList;
+  if (batch && batch->eventCount > 0) {
+    publishBatch(batch);
+  }
+  a2jmidi::jitter::update();
+  if (lostCount > 0) {
+    g_lostEventCount += lostCount;
+    SPDLOG_LOGGER_ERROR(g_logger, "receiverQueue - queue full, {} events discarded.", lostCount);
+  }
 }
 
 /**
- * This is the main listening loop which listens for a batch of incoming events.
+ * This is the main listening loop of the listener thread.
  *
- * Once such a batch is received, immediately a new follow-on thread is launched.
- * This new thread will listen for the next incoming events and the current thread ends normally.
+ * Every batch of incoming events is stamped (either with the current time, or with
+ * the kernel time stamps of the events) and appended to the queue.
  *
- * If, while waiting, the `carryOnFlag` turns `false`, the current thread will end on
- * a `InterruptedException` and no follow-on thread will be launched.
+ * The loop ends when the `carryOnFlag` turns `false`.
  *
  * @param hSequencer - a handle for the ALSA sequencer.
- * @return a smart pointer to an AlsaEventBatch object which holds the received events and
- * the newly created future.
  */
-AlsaEventPtr listenForEvents(snd_seq_t *hSequencer) {
+void listenForEvents(snd_seq_t *hSequencer) {
   SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::listenForEvents");
 
   // poll descriptors for the poll function below.
@@ -330,63 +590,135 @@ AlsaEventPtr listenForEvents(snd_seq_t *hSequencer) {
     // wait until one or several incoming ALSA-sequencer-events are registered.
     auto hasEvents = poll(fds, fdsCount, SHUTDOWN_POLL_PERIOD_MS);
     if ((hasEvents > 0) && g_carryOnFlag) {
-      auto events = retrieveEvents(hSequencer);
-      if (!events.empty()) {
-        // recursively call `startNextFuture()` to listen for the next ALSA sequencer event.
-        FutureAlsaEvents nextFuture = startNextFuture(hSequencer);
-
-        // pack the the events data and the next future into an `AlsaEventBatch`- object.
-        auto *pAlsaEvent = new AlsaEventBatch(std::move(nextFuture), events, g_clock->now());
-        // delegate the ownership of the `AlsaEventBatch`-object to the caller by using a smart
-        // pointer
-        // ... and return (ending the current thread).
-        return AlsaEventPtr(pAlsaEvent);
-      }
+      g_wakeUpCount.fetch_add(1, std::memory_order_relaxed);
+      retrieveEvents(hSequencer);
     }
   }
-  // Here `carryOnFlag` is false -> we end this thread on the appropriate exception.
-  throw InterruptedException();
 }
+
 /**
- * Launch a new thread that will be listening for the next ALSA sequencer event.
+ * The main listening loop of the listener thread in busy poll mode.
+ *
+ * Instead of sleeping in `poll()`, the loop keeps asking the sequencer, without blocking,
+ * whether events are pending; in between it backs off as configured. The thread never
+ * sleeps in the kernel, so an event is picked up without a scheduler wake-up.
+ *
+ * The loop ends when the `carryOnFlag` turns `false`.
+ *
+ * @param hSequencer - a handle for the ALSA sequencer.
+ */
+void spinForEvents(snd_seq_t *hSequencer) {
+  SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::spinForEvents");
+  IdleBackoff backoff{g_busyPoll.backoff};
+
+  while (g_carryOnFlag) {
+    // a non-blocking read from the kernel into alsa-lib's input buffer.
+    int pending = snd_seq_event_input_pending(hSequencer, 1);
+    if (pending > 0) {
+      g_wakeUpCount.fetch_add(1, std::memory_order_relaxed);
+      retrieveEvents(hSequencer);
+      backoff.reset();
+      continue;
+    }
+    if (pending == -ENOSPC) {
+      registerOverrun();
+    } else if (pending != -EAGAIN) {
+      checkAlsa("snd_seq_event_input_pending", pending);
+    }
+    backoff.idle();
+  }
+}
+
+/**
+ * The body of the listener thread. Should listening fail, it is resumed until the queue
+ * is stopped.
  * @param hSequencer - a handle for the ALSA sequencer.
- * @return an object of type `FutureAlsaEvents` that holds the future result.
  */
-FutureAlsaEvents startNextFuture(snd_seq_t *hSequencer) {
-  SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::startNextFuture");
-  return std::async(std::launch::async,
-                    [hSequencer]() -> AlsaEventPtr { return listenForEvents(hSequencer); });
+void listenerThreadMain(snd_seq_t *hSequencer) noexcept {
+  a2jmidi::applyThreadSettings(pthread_self(), g_listenerSettings, "listener");
+  a2jmidi::prefaultStack(); // the first burst shall not take page faults.
+  while (g_carryOnFlag) {
+    try {
+      if (g_busyPoll.enabled) {
+        spinForEvents(hSequencer);
+      } else {
+        listenForEvents(hSequencer);
+      }
+    } catch (const std::exception &ex) {
+      // the listener must not die silently, try to carry on after a short pause.
+      g_listenerRestartCount++;
+      SPDLOG_LOGGER_ERROR(g_logger, "receiverQueue - listener error, restarting: {}", ex.what());
+      if (g_sysexArena.isOpen()) {
+        g_sysexArena.abandon();
+        g_lostSysexCount++;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(LISTENER_RESTART_DELAY_MS));
+    }
+  }
 }
 
 /**
  * Internally called by `receiverQueue::start()`
  *
- * A new FutureAlsaEvents is created.
- * The newly created future will be listening to
- * new ALSA sequencer events.
+ * The pool of event-batches is allocated and the listener thread is launched.
+ * From here on, no memory is allocated until the queue is stopped.
  * @param hSequencer handle to the ALSA sequencer.
- * @return the newly created future.
+ * @param capacity - the maximum number of event-batches in the queue.
+ * @param timestampQueue - the ALSA queue that stamps incoming events, or `NO_TIMESTAMP_QUEUE`.
+ * @param busyPoll - how the listener thread waits for incoming events.
+ * @param listenerSettings - the scheduling and the CPU of the listener thread.
  */
-FutureAlsaEvents startInternal(snd_seq_t *hSequencer) {
+void startInternal(snd_seq_t *hSequencer, int capacity, int timestampQueue,
+                   const BusyPoll &busyPoll, const a2jmidi::ThreadSettings &listenerSettings) {
   SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::startInternal");
   if (g_stateFlag == State::running) {
     stopInternal();
     SPDLOG_LOGGER_ERROR(g_logger, "receiverQueue::startInternal, attempt to start twice.");
     throw std::runtime_error("Cannot start the receiverQueue, it is already running.");
   }
+  g_queue.reset(capacity);
+  g_sysexArena.reset(SYSEX_ARENA_CAPACITY, midi::MAX_SYSEX_SIZE);
+  g_timestampQueue = timestampQueue;
+  g_busyPoll = busyPoll;
+  g_listenerSettings = listenerSettings;
+  if (busyPoll.enabled && busyPoll.cpu >= 0) {
+    g_listenerSettings.cpu = busyPoll.cpu; // a busy polling listener owns its CPU.
+  }
+  if (busyPoll.enabled && busyPoll.backoff == Backoff::spin &&
+      (listenerSettings.policy == SCHED_FIFO || listenerSettings.policy == SCHED_RR)) {
+    SPDLOG_LOGGER_WARN(g_logger,
+                       "receiverQueue - a real-time listener that spins never gives CPU {} "
+                       "away; other threads on this CPU starve (or the kernel throttles all "
+                       "real-time threads). Consider --backoff pause or yield.",
+                       busyPoll.cpu);
+  }
+  g_lostEventCount = 0;
+  g_lostSysexCount = 0;
+  g_wakeUpCount = 0;
+  g_receivedEventCount = 0;
+  g_overrunCount = 0;
+  g_listenerRestartCount = 0;
+  g_poolHighWatermark = 0;
   g_carryOnFlag = true;
   g_stateFlag = State::running;
-  return startNextFuture(hSequencer);
+  g_listenerThread = std::thread(listenerThreadMain, hSequencer);
 }
 
 /**
  * Start listening for incoming ALSA sequencer event.
  * @param hSequencer handle to the ALSA sequencer.
+ * @param clock - the clock to be used to timestamp incoming events.
+ * @param capacity - the maximum number of event-batches in the queue.
+ * @param timestampQueue - the ALSA queue that stamps incoming events, or `NO_TIMESTAMP_QUEUE`.
+ * @param busyPoll - how the listener thread waits for incoming events.
+ * @param listenerSettings - the scheduling and the CPU of the listener thread.
  */
-void start(snd_seq_t *hSequencer, a2jmidi::ClockPtr clock) noexcept(false) {
+void start(snd_seq_t *hSequencer, a2jmidi::ClockPtr clock, int capacity, int timestampQueue,
+           const BusyPoll &busyPoll,
+           const a2jmidi::ThreadSettings &listenerSettings) noexcept(false) {
   std::unique_lock<std::mutex> lock{g_queueAccessMutex};
   g_clock = std::move(clock);
-  g_queueHead = std::move(startInternal(hSequencer));
+  startInternal(hSequencer, capacity, timestampQueue, busyPoll, listenerSettings);
 }
 
 /**
@@ -396,7 +728,7 @@ void start(snd_seq_t *hSequencer, a2jmidi::ClockPtr clock) noexcept(false) {
  */
 bool hasResult() {
   std::unique_lock<std::mutex> lock{g_queueAccessMutex};
-  return isReady(g_queueHead);
+  return (g_stateFlag == State::running) && !g_queue.empty();
 }
 
-} // namespace alsaClient::receiverQueue
\ No newline at end of file
+} // namespace alsaClient::receiverQueue
@@ -20,12 +20,15 @@
 #define A_J_MIDI_SRC_ALSA_RECEIVER_QUEUE_H
 
 #include "a2jmidi_clock.h"
+#include "busy_poll.h"
+#include "realtime.h"
+#include "midi.h"
 #include "sys_clock.h"
 
 #include <alsa/asoundlib.h>
 #include <chrono>
 #include <functional>
-#include <future>
+#include <mutex>
 #include <stdexcept>
 
 namespace alsaClient::receiverQueue {
@@ -39,28 +42,61 @@ enum class State : int {
 };
 
 /**
- * When a listener process is forced to stop, it throws
- * the InterruptedException.
- * @note this exception does not denote an error, rather it
- * is denotes the usual end of the listening processes.
+ * The default number of event-batches the queue can hold.
  */
-class InterruptedException : public std::future_error {
-public:
-  InterruptedException() : std::future_error(std::future_errc::broken_promise){};
-};
+constexpr int DEFAULT_CAPACITY = 512;
+/**
+ * The maximum number of events in one event-batch. Bursts with more events are
+ * spread over several batches.
+ */
+constexpr int BATCH_CAPACITY = 16;
+/**
+ * This should be large enough to hold the largest MIDI message produced by
+ * `alsaClient::decodeEvent` (see `MAX_DECODED_SIZE`). SysEx messages are not decoded, they
+ * are reassembled in the SysEx arena.
+ */
+constexpr int MAX_MIDI_EVENT_SIZE = 16;
+/**
+ * The number of bytes reserved for SysEx messages that wait to be processed.
+ */
+constexpr int SYSEX_ARENA_CAPACITY = 4 * midi::MAX_SYSEX_SIZE;
+/**
+ * Indicates that no ALSA queue is used; incoming events are timestamped by the listener thread.
+ */
+constexpr int NO_TIMESTAMP_QUEUE = -1;
 
 /**
  * Start listening for incoming ALSA events.
+ *
+ * The pool of event-batches is allocated here. While the queue is running
+ * no further memory is allocated.
+ *
+ * A single listener thread is launched. It stays alive until `stop()` is called.
+ *
+ * By default, all events that the listener thread finds in the sequencer FIFO are stamped
+ * with the same `clock->now()`. When a `timestampQueue` is given, each event carries the
+ * real-time stamp the kernel attached when the event arrived; this stamp is mapped onto
+ * the clock, so that the spacing of the events inside a burst is preserved.
  * @param hSequencer handle to the ALSA sequencer.
+ * @param clock - the clock to be used to timestamp incoming events.
+ * @param capacity - the maximum number of event-batches that can be stored in the queue.
+ * @param timestampQueue - the running ALSA queue that stamps the events of the receiver
+ * port (see `snd_seq_port_info_set_timestamp_queue`), or `NO_TIMESTAMP_QUEUE`.
+ * @param busyPoll - how the listener thread waits for incoming events. In busy poll mode, the
+ * listener is pinned to the given CPU and never sleeps.
+ * @param listenerSettings - the scheduling policy, priority and CPU of the listener thread.
+ * The CPU of a busy polling listener takes precedence.
  */
-void start(snd_seq_t *hSequencer, a2jmidi::ClockPtr clock) noexcept(false);
+void start(snd_seq_t *hSequencer, a2jmidi::ClockPtr clock, int capacity = DEFAULT_CAPACITY,
+           int timestampQueue = NO_TIMESTAMP_QUEUE, const BusyPoll &busyPoll = BusyPoll{},
+           const a2jmidi::ThreadSettings &listenerSettings = {}) noexcept(false);
 
 /**
- * Force all processes to stop listening for incoming events.
+ * Force the listener thread to stop listening for incoming events.
  *
  * The queue will be emptied all recorded events will be removed from the queue (and from memory).
  *
- * This function blocks until all listening processes have ceased.
+ * This function blocks until the listener thread has ceased.
  */
 void stop() noexcept;
 
@@ -81,30 +117,126 @@ bool hasResult();
 
 /**
  * Get an estimate of the number of events currently stored in the queue.
+ *
+ * This is also the current occupancy of the pool of event-batches.
  * @return the number of Batches (events received at the same moment) in the queue.
  */
 int getCurrentEventBatchCount();
 
+/**
+ * Get the number of slots in the pool of event-batches.
+ * @return the capacity given to `start()`, rounded up to a power of two.
+ */
+int getPoolCapacity();
+
+/**
+ * Get the largest number of pool slots that were simultaneously in use.
+ * The high watermark is reset by `start()`.
+ * @return the largest occupancy of the pool since the queue was started.
+ */
+int getPoolHighWatermark();
+
+/**
+ * Get the number of events that had to be discarded because the queue was full.
+ * The counter is reset by `start()`.
+ * @return the number of discarded events.
+ */
+int getLostEventCount();
+
+/**
+ * Get the number of SysEx messages that had to be discarded, because they were longer than
+ * `midi::MAX_SYSEX_SIZE`, because the SysEx arena was full, or because they were incomplete.
+ * The counter is reset by `start()`.
+ * @return the number of discarded SysEx messages.
+ */
+int getLostSysexCount();
+
+/**
+ * Get the number of times the listener thread was woken up by incoming ALSA-sequencer-events.
+ * Events blocked by the client's event filter (see `alsaClient::EventFilter`) never wake it up.
+ * The counter is reset by `start()`.
+ * @return the number of wake-ups since the queue was started.
+ */
+long getWakeUpCount();
+
+/**
+ * Get the number of MIDI messages the listener thread has stored into the queue.
+ * The counter is reset by `start()`.
+ * @return the number of received MIDI messages since the queue was started.
+ */
+long getReceivedEventCount();
+
+/**
+ * Get the number of input overruns: the kernel reported (with `-ENOSPC`) that the input pool
+ * of the client had overflowed and that the pending events were dropped. The input pool is
+ * sized by `alsaClient::open()`.
+ * The counter is reset by `start()`.
+ * @return the number of overruns since the queue was started.
+ */
+int getOverrunCount();
+
+/**
+ * Get the number of times the listener thread resumed listening after an unexpected error.
+ * The counter is reset by `start()`.
+ * @return the number of listener restarts since the queue was started.
+ */
+int getListenerRestartCount();
+
 /**
  * The function type to be used in the `process` call.
- * @param event - the current ALSA-sequencer-event.
+ * @param midiData - the raw MIDI bytes of the current event.
+ * @param size - the number of bytes in `midiData`.
  * @param timeStamp - the point in time when the event was recorded.
  */
-using ProcessCallback =
-    std::function<void(const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp)>;
+using ProcessCallback = std::function<void(const unsigned char *midiData, int size,
+                                           a2jmidi::TimePoint timeStamp)>;
 
 /**
  * The process method executes a provided closure once for each registered
- * ALSA-sequencer-event.
+ * MIDI event.
  *
+ * The listener thread has already translated the ALSA-sequencer-events into
+ * raw MIDI bytes; sequencer-events that do not correspond to a MIDI message
+ * are not stored in the queue at all.
+ *
+ * Events are delivered in the order in which ALSA delivered them; a SysEx message that
+ * ALSA delivered in several chunks is delivered once, complete, with the time stamp of its
+ * last chunk. The bytes handed to the closure are only valid during the call.
  * Events received beyond a given deadline will not be processed.
  *
  * All processed events will be removed from the queue (and from memory).
  *
+ * __Real-time guarantee__: this function may be called from the JACK process callback.
+ * It takes no lock, it never waits for the listener thread nor for the control functions
+ * (`start`, `stop`, `getState` ...) and it never sleeps. Only one thread at a time
+ * shall call `process`.
+ *
  * @param deadline - the time limit beyond which events will remain in the queue.
  * @param closure - the function to execute on each Event. It must be of type `processCallback`.
  */
 void process(a2jmidi::TimePoint deadline, const ProcessCallback &closure) noexcept;
 
+/**
+ * Remove all queued events without processing them (for example after the clock
+ * has jumped, when the time stamps of the queued events have become meaningless).
+ *
+ * The same real-time guarantee as for `process()` applies; `discard` and `process` shall
+ * be called from the same thread.
+ *
+ * @return the number of events removed.
+ */
+int discard() noexcept;
+
+/**
+ * Implementation specific stuff.
+ */
+inline namespace impl {
+/**
+ * Serializes the control functions (`start`, `stop`, `getState` ...).
+ * The real-time function `process` never acquires it.
+ */
+extern std::mutex g_queueAccessMutex;
+} // namespace impl
+
 } // namespace alsaClient::receiverQueue
 #endif // A_J_MIDI_SRC_ALSA_RECEIVER_QUEUE_H
@@ -0,0 +1,109 @@
+/*
+ * File: busy_poll.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_BUSY_POLL_H
+#define A_J_MIDI_SRC_BUSY_POLL_H
+
+#include <algorithm>
+#include <thread>
+
+namespace alsaClient {
+
+/**
+ * What a busy polling listener does when it finds no event.
+ */
+enum class Backoff : int {
+  spin,  ///< poll again at once.
+  pause, ///< execute a growing number of CPU pause instructions before polling again.
+  yield  ///< like `pause`, but once the pauses have reached their maximum, yield the CPU.
+};
+
+/**
+ * How the listener thread waits for incoming events.
+ *
+ * By default, the listener sleeps in `poll()` until the kernel wakes it up. In busy poll mode,
+ * the listener never sleeps: it polls the sequencer without blocking, on a dedicated CPU
+ * (ideally one that is isolated with `isolcpus`). This saves the scheduler wake-up on every
+ * event, at the cost of one CPU that is permanently busy.
+ */
+struct BusyPoll {
+  bool enabled{false};             ///< if false, the listener sleeps in `poll()`.
+  int cpu{-1};                     ///< the CPU to pin the listener to, or -1 for any CPU.
+  Backoff backoff{Backoff::pause}; ///< what to do when no event is pending.
+};
+
+/**
+ * Tell the CPU that we are in a spin-wait loop. This reduces the power consumption and
+ * frees resources for a sibling hyper-thread.
+ */
+inline void cpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#endif
+}
+
+/**
+ * The back-off of a busy polling loop: each unsuccessful poll is followed by a call to
+ * `idle()`, each successful poll by a call to `reset()`.
+ */
+class IdleBackoff {
+private:
+  Backoff m_strategy;
+  int m_pauses{1}; ///< the number of pause instructions at the next `idle()`.
+
+public:
+  /**
+   * The largest number of pause instructions between two polls (a few microseconds).
+   */
+  static constexpr int MAX_PAUSES = 64;
+
+  explicit IdleBackoff(Backoff strategy) noexcept : m_strategy{strategy} {}
+
+  /**
+   * Wait a little before the next poll. The wait doubles with each call, until it reaches
+   * `MAX_PAUSES`. The thread never sleeps in the kernel.
+   */
+  void idle() noexcept {
+    if (m_strategy == Backoff::spin) {
+      return;
+    }
+    if (m_strategy == Backoff::yield && m_pauses == MAX_PAUSES) {
+      std::this_thread::yield();
+      return;
+    }
+    for (int i = 0; i < m_pauses; i++) {
+      cpuRelax();
+    }
+    m_pauses = std::min(2 * m_pauses, MAX_PAUSES);
+  }
+
+  /**
+   * An event was found, poll at full speed again.
+   */
+  void reset() noexcept { m_pauses = 1; }
+
+  /**
+   * @return the number of pause instructions at the next `idle()`.
+   */
+  int pauses() const noexcept { return m_pauses; }
+};
+
+} // namespace alsaClient
+#endif // A_J_MIDI_SRC_BUSY_POLL_H
@@ -0,0 +1,142 @@
+/*
+ * File: controller_coalescer.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "controller_coalescer.h"
+#include <cstring>
+
+namespace a2jmidi {
+
+ControllerCoalescer::ControllerCoalescer()
+    : m_staged{std::make_unique<int[]>(midi::CONTINUOUS_KEY_COUNT)},
+      m_stagedCycle{std::make_unique<std::uint32_t[]>(midi::CONTINUOUS_KEY_COUNT)},
+      m_stagedEpoch{std::make_unique<std::uint32_t[]>(midi::CONTINUOUS_KEY_COUNT)},
+      m_lastWritten{std::make_unique<TimePoint[]>(midi::CONTINUOUS_KEY_COUNT)},
+      m_written{std::make_unique<bool[]>(midi::CONTINUOUS_KEY_COUNT)},
+      m_held{std::make_unique<unsigned char[]>(midi::CONTINUOUS_KEY_COUNT * MAX_CONTINUOUS_SIZE)},
+      m_heldSize{std::make_unique<int[]>(midi::CONTINUOUS_KEY_COUNT)},
+      m_heldKeys{std::make_unique<int[]>(midi::CONTINUOUS_KEY_COUNT)} {}
+
+void ControllerCoalescer::beginCycle() noexcept {
+  m_cycle++;
+  if (m_cycle == 0) {
+    // after the wrap-around, old stamps could be mistaken for the current cycle.
+    for (int key = 0; key < midi::CONTINUOUS_KEY_COUNT; key++) {
+      m_stagedCycle[key] = 0;
+    }
+    m_cycle = 1;
+  }
+}
+
+bool ControllerCoalescer::stage(StagingBuffer &staging, int key, TimePoint timeStamp, int frame,
+                                const unsigned char *data, int size) noexcept {
+  const std::uint32_t epoch = m_channelEpoch[data[0] & 0x0FU];
+  if (m_coalesce && m_stagedCycle[key] == m_cycle && m_stagedEpoch[key] == epoch) {
+    staging.replace(m_staged[key], frame, data);
+    m_coalescedCount.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    if (!staging.add(frame, data, size)) {
+      return false;
+    }
+    m_staged[key] = staging.size() - 1;
+    m_stagedCycle[key] = m_cycle;
+    m_stagedEpoch[key] = epoch;
+  }
+  m_lastWritten[key] = timeStamp;
+  m_written[key] = true;
+  return true;
+}
+
+bool ControllerCoalescer::add(StagingBuffer &staging, TimePoint timeStamp, int frame,
+                              const unsigned char *data, int size) noexcept {
+  const TimePoint interval = m_minInterval.load(std::memory_order_relaxed);
+  const int key = midi::continuousKey(data, size);
+  // channel pressure has two bytes, the others three. Malformed messages pass unchanged.
+  const int expectedSize = ((data[0] & 0xF0U) == 0xD0) ? 2 : 3;
+  if (key < 0 || size != expectedSize || (!m_coalesce && interval == 0)) {
+    if (data[0] >= 0x80 && data[0] < 0xF0) {
+      // a value staged before this channel message must not be moved past it.
+      m_channelEpoch[data[0] & 0x0FU]++;
+    }
+    return staging.add(frame, data, size);
+  }
+  const TimePoint sinceWritten = timeStamp - m_lastWritten[key];
+  if (interval > 0 && m_written[key] && sinceWritten >= 0 && sinceWritten < interval) {
+    // too early: hold back, replacing whatever has been held back before.
+    if (m_heldSize[key] == 0) {
+      m_heldKeys[m_heldKeyCount++] = key;
+    }
+    std::memcpy(&m_held[key * MAX_CONTINUOUS_SIZE], data, size);
+    m_heldSize[key] = size;
+    m_heldCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  if (m_heldSize[key] > 0) {
+    // superseded by this value. A negative size keeps the key listed until `flush()`.
+    m_heldSize[key] = -1;
+  }
+  return stage(staging, key, timeStamp, frame, data, size);
+}
+
+int ControllerCoalescer::flush(StagingBuffer &staging, const CycleWindow &window) noexcept {
+  const TimePoint interval = m_minInterval.load(std::memory_order_relaxed);
+  int lost = 0;
+  int i = 0;
+  while (i < m_heldKeyCount) {
+    const int key = m_heldKeys[i];
+    const int size = m_heldSize[key];
+    const TimePoint due = m_lastWritten[key] + interval;
+    if (size > 0 && due >= window.deadline) {
+      i++; // still too early, keep it for a later cycle.
+      continue;
+    }
+    if (size > 0) {
+      int frame = placeEvent(window, due);
+      if (frame == DISCARD_EVENT) {
+        frame = 0; // the newest value of a key is never discarded.
+      }
+      if (!stage(staging, key, due, frame, &m_held[key * MAX_CONTINUOUS_SIZE], size)) {
+        lost++;
+      }
+    }
+    m_heldSize[key] = 0;
+    m_heldKeys[i] = m_heldKeys[--m_heldKeyCount];
+  }
+  return lost;
+}
+
+void ControllerCoalescer::resynchronize() noexcept {
+  for (int i = 0; i < m_heldKeyCount; i++) {
+    m_heldSize[m_heldKeys[i]] = 0;
+  }
+  m_heldKeyCount = 0;
+  for (int key = 0; key < midi::CONTINUOUS_KEY_COUNT; key++) {
+    m_written[key] = false;
+  }
+}
+
+void ControllerCoalescer::reset() noexcept {
+  resynchronize();
+  for (int key = 0; key < midi::CONTINUOUS_KEY_COUNT; key++) {
+    m_stagedCycle[key] = 0;
+  }
+  m_cycle = 0;
+  m_coalescedCount = 0;
+  m_heldCount = 0;
+}
+
+} // namespace a2jmidi
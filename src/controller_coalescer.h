@@ -0,0 +1,154 @@
+/*
+ * File: controller_coalescer.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_CONTROLLER_COALESCER_H
+#define A_J_MIDI_SRC_CONTROLLER_COALESCER_H
+
+#include "a2jmidi_clock.h"
+#include "event_placement.h"
+#include "midi_priority.h"
+#include "staging_buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace a2jmidi {
+
+/**
+ * Thins out continuous messages (controllers, pitch bend, aftertouch; see
+ * `midi::continuousKey()`) on their way into the staging buffer.
+ *
+ * - _coalescing_: within one cycle, only the last value of each key is written. A newer
+ * value overwrites the staged one, and moves it to the newer position. Any other channel
+ * message (a note, a program change, an (N)RPN controller ...) ends the coalescing of the
+ * keys on its channel, so that no value is moved past it.
+ * - _rate limiting_: a key is written at most once per minimum interval. A value that comes
+ * too early is held back; only the latest held value is written, as soon as the interval
+ * has elapsed (see `flush()`). So the final value of a gesture is never lost.
+ *
+ * All other messages pass unchanged. With both stages switched off, the coalescer is
+ * transparent.
+ *
+ * The functions `beginCycle()`, `add()` and `flush()` shall only be called from the process
+ * thread; they never allocate.
+ */
+class ControllerCoalescer {
+private:
+  static constexpr int MAX_CONTINUOUS_SIZE = 3;
+
+  bool m_coalesce{false};
+  std::atomic<TimePoint> m_minInterval{0};
+  std::uint32_t m_cycle{0}; ///< identifies the current cycle in `m_stagedCycle`.
+  /// for each channel: incremented by every other message, ends the coalescing on the channel.
+  std::uint32_t m_channelEpoch[16]{};
+
+  /// for each key: the index of the staged event (valid if stamped with the current cycle and
+  /// the current epoch of its channel).
+  std::unique_ptr<int[]> m_staged;
+  std::unique_ptr<std::uint32_t[]> m_stagedCycle;
+  std::unique_ptr<std::uint32_t[]> m_stagedEpoch;
+  /// for each key: the time stamp of the last value written.
+  std::unique_ptr<TimePoint[]> m_lastWritten;
+  std::unique_ptr<bool[]> m_written; ///< false until a value of the key has been written.
+  /// for each key: the value held back by the rate limit.
+  std::unique_ptr<unsigned char[]> m_held;
+  std::unique_ptr<int[]> m_heldSize; ///< zero if no value is held back.
+  std::unique_ptr<int[]> m_heldKeys; ///< the keys with a value held back.
+  int m_heldKeyCount{0};
+
+  std::atomic<std::uint32_t> m_coalescedCount{0};
+  std::atomic<std::uint32_t> m_heldCount{0};
+
+  bool stage(StagingBuffer &staging, int key, TimePoint timeStamp, int frame,
+             const unsigned char *data, int size) noexcept;
+
+public:
+  ControllerCoalescer();
+  ControllerCoalescer(const ControllerCoalescer &) = delete;            ///< no copy constructor
+  ControllerCoalescer &operator=(const ControllerCoalescer &) = delete; ///< no copy assignment
+
+  /**
+   * Switch coalescing on or off. Shall not be called while the process thread is active.
+   * @param coalesce - true if only the last value per key and cycle shall be written.
+   */
+  void setCoalescing(bool coalesce) noexcept { m_coalesce = coalesce; }
+  /**
+   * @return true if only the last value per key and cycle is written.
+   */
+  bool coalescing() const noexcept { return m_coalesce; }
+  /**
+   * Set the minimum interval between two values of the same key. Can be called from any
+   * thread (for example when the sample rate changes).
+   * @param frames - the interval in frames, zero switches the rate limit off.
+   */
+  void setMinInterval(TimePoint frames) noexcept { m_minInterval = frames; }
+  /**
+   * @return the minimum interval in frames.
+   */
+  TimePoint minInterval() const noexcept { return m_minInterval; }
+
+  /**
+   * Start a new cycle.
+   */
+  void beginCycle() noexcept;
+
+  /**
+   * Stage an event, unless it is superseded or held back.
+   * @param staging - the staging buffer of the current cycle.
+   * @param timeStamp - the time stamp of the event.
+   * @param frame - the position of the event in the JACK buffer.
+   * @param data - the MIDI bytes.
+   * @param size - the number of MIDI bytes.
+   * @return false if the event was due but did not fit into the staging buffer.
+   */
+  bool add(StagingBuffer &staging, TimePoint timeStamp, int frame, const unsigned char *data,
+           int size) noexcept;
+
+  /**
+   * Stage the held back values whose interval elapses before the end of the current cycle.
+   * To be called after the last `add()` of a cycle.
+   * @param staging - the staging buffer of the current cycle.
+   * @param window - the window of the current cycle.
+   * @return the number of values that did not fit into the staging buffer.
+   */
+  int flush(StagingBuffer &staging, const CycleWindow &window) noexcept;
+
+  /**
+   * Forget the held back values and the time of the last values (for example after a
+   * clock discontinuity).
+   */
+  void resynchronize() noexcept;
+
+  /**
+   * @return the number of values overwritten by a newer value of the same cycle.
+   */
+  std::uint32_t coalescedCount() const noexcept { return m_coalescedCount; }
+  /**
+   * @return the number of values held back by the rate limit (and superseded or delayed).
+   */
+  std::uint32_t heldCount() const noexcept { return m_heldCount; }
+
+  /**
+   * Reset the counters and forget all values. Shall not be called while the process thread
+   * is active.
+   */
+  void reset() noexcept;
+};
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_CONTROLLER_COALESCER_H
@@ -0,0 +1,123 @@
+/*
+ * File: delay_locked_loop.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "delay_locked_loop.h"
+#include <cmath>
+
+namespace a2jmidi {
+
+static constexpr double PI = 3.14159265358979323846;
+
+void DelayLockedLoop::reset() { m_initialized = false; }
+
+void DelayLockedLoop::initialize(std::uint64_t usecs, std::uint32_t periodFrames,
+                                 double sampleRate) {
+  const double periodUsecs = 1e6 * periodFrames / sampleRate;
+  const double omega = 2.0 * PI * m_bandwidth * periodUsecs / 1e6;
+  m_b = std::sqrt(2.0) * omega;
+  m_c = omega * omega;
+  m_originUsecs = usecs;
+  m_periodFrames = periodFrames;
+  m_t0 = 0.0;
+  m_e2 = periodUsecs;
+  m_t1 = m_t0 + m_e2;
+  m_initialized = true;
+}
+
+bool DelayLockedLoop::update(std::uint32_t frames, std::uint64_t usecs,
+                             std::uint32_t periodFrames, double sampleRate) {
+  if (periodFrames == 0 || sampleRate <= 0.0) {
+    return false;
+  }
+  // unsigned subtraction keeps the distance correct across the 32 bit wrap-around.
+  const std::uint32_t advance = frames - m_lastFrames32;
+  const bool backwards = static_cast<std::int32_t>(advance) < 0;
+  bool discontinuity = false;
+  if (m_initialized) {
+    // (after a `reset()` there is no previous cycle to compare with.)
+    const auto maxFrames = static_cast<std::int64_t>(DISCONTINUITY_SECONDS * sampleRate);
+    const auto maxUsecs = static_cast<std::uint64_t>(DISCONTINUITY_SECONDS * 1e6);
+    discontinuity = backwards || static_cast<std::int64_t>(advance) > maxFrames ||
+                    usecs < m_lastUsecs || usecs - m_lastUsecs > maxUsecs;
+  }
+  if (isValid()) {
+    // re-base a frame count that went backwards, so that the time points keep increasing.
+    m_frames64 += backwards ? periodFrames : advance;
+  } else {
+    m_frames64 = frames; // the very first cycle: start where JACK stands.
+  }
+  m_lastFrames32 = frames;
+  m_lastUsecs = usecs;
+  if (discontinuity) {
+    m_discontinuityCount.fetch_add(1, std::memory_order_release);
+    m_initialized = false;
+  }
+
+  if (!m_initialized || advance != m_periodFrames || periodFrames != m_periodFrames) {
+    initialize(usecs, periodFrames, sampleRate);
+  } else {
+    const double error = static_cast<double>(usecs - m_originUsecs) - m_t1;
+    m_t0 = m_t1;
+    m_t1 += m_b * error + m_e2;
+    m_e2 += m_c * error;
+  }
+  publish();
+  return discontinuity;
+}
+
+void DelayLockedLoop::publish() {
+  const std::uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+  m_sequence.store(sequence + 1, std::memory_order_relaxed); // odd: writing
+  std::atomic_thread_fence(std::memory_order_release);
+  m_publishedFrame.store(m_frames64, std::memory_order_relaxed);
+  m_publishedOrigin.store(m_originUsecs, std::memory_order_relaxed);
+  m_publishedTime.store(m_t0, std::memory_order_relaxed);
+  m_publishedRate.store(m_periodFrames / (m_t1 - m_t0), std::memory_order_relaxed);
+  m_sequence.store(sequence + 2, std::memory_order_release); // even: consistent
+  m_publishedValid.store(true, std::memory_order_release);
+}
+
+std::int64_t DelayLockedLoop::cycleStartFrame() const {
+  return m_publishedFrame.load(std::memory_order_acquire);
+}
+
+double DelayLockedLoop::framePosition(std::uint64_t usecs) const {
+  if (!isValid()) {
+    return 0.0;
+  }
+  std::int64_t frame;
+  std::uint64_t origin;
+  double time;
+  double rate;
+  std::uint32_t sequence;
+  do {
+    sequence = m_sequence.load(std::memory_order_acquire);
+    frame = m_publishedFrame.load(std::memory_order_relaxed);
+    origin = m_publishedOrigin.load(std::memory_order_relaxed);
+    time = m_publishedTime.load(std::memory_order_relaxed);
+    rate = m_publishedRate.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((sequence & 1U) || sequence != m_sequence.load(std::memory_order_relaxed));
+
+  // the time since the cycle start may be negative (the caller's time stamp is older).
+  const double elapsed = (usecs >= origin) ? static_cast<double>(usecs - origin) - time
+                                           : -static_cast<double>(origin - usecs) - time;
+  return static_cast<double>(frame) + elapsed * rate;
+}
+
+} // namespace a2jmidi
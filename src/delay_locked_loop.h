@@ -0,0 +1,144 @@
+/*
+ * File: delay_locked_loop.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_DELAY_LOCKED_LOOP_H
+#define A_J_MIDI_SRC_DELAY_LOCKED_LOOP_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace a2jmidi {
+
+/**
+ * A delay-locked loop (DLL) that relates the system time to the frame count of
+ * the audio interface.
+ *
+ * On every process cycle, the loop is fed with the (32 bit) frame count and the
+ * system time (in microseconds) at the start of the cycle, as reported by
+ * `jack_get_cycle_times()`. From this, the loop estimates the frame position at any given
+ * system time. The frame positions are 64 bit wide and carry a fractional part. They
+ * do not wrap around when the 32 bit frame count does.
+ *
+ * See Fons Adriaensen, "Using a DLL to filter time" (2005).
+ *
+ * Only one thread (the JACK process thread) shall call `update()` and `reset()`.
+ * The estimates may be read from any thread, concurrently to `update()`. No function
+ * takes a lock, allocates memory or makes a system call.
+ */
+class DelayLockedLoop {
+public:
+  /**
+   * The default bandwidth of the loop in Hertz.
+   */
+  static constexpr double DEFAULT_BANDWIDTH = 0.5;
+  /**
+   * Two consecutive cycles that lie further apart than this (in seconds), or a frame
+   * count that goes backwards, are taken as a discontinuity of the clock (for example
+   * after the system has been suspended, or after the server has been restarted).
+   */
+  static constexpr double DISCONTINUITY_SECONDS = 0.5;
+
+private:
+  const double m_bandwidth;
+
+  // --- the state of the loop, only touched by the updating thread.
+  bool m_initialized{false};
+  std::uint32_t m_lastFrames32{0}; ///< the frame count given to the last update.
+  std::int64_t m_frames64{0};      ///< the unwrapped frame count given to the last update.
+  std::uint64_t m_originUsecs{0};  ///< system times are relative to this origin.
+  std::uint64_t m_lastUsecs{0};    ///< the system time given to the last update.
+  std::uint32_t m_periodFrames{0}; ///< the number of frames per cycle.
+  double m_b{0.0};                 ///< first coefficient of the loop filter.
+  double m_c{0.0};                 ///< second coefficient of the loop filter.
+  double m_t0{0.0};                ///< filtered time (usecs) of the current cycle start.
+  double m_t1{0.0};                ///< predicted time (usecs) of the next cycle start.
+  double m_e2{0.0};                ///< filtered duration (usecs) of one cycle.
+
+  // --- the published estimate, guarded by a sequence counter (odd while being written).
+  std::atomic<std::uint32_t> m_sequence{0};
+  std::atomic<std::int64_t> m_publishedFrame{0};    ///< the frame at the current cycle start.
+  std::atomic<std::uint64_t> m_publishedOrigin{0};  ///< the origin of the published times.
+  std::atomic<double> m_publishedTime{0.0};         ///< the usecs of the current cycle start.
+  std::atomic<double> m_publishedRate{0.0};         ///< frames per microsecond.
+  std::atomic<bool> m_publishedValid{false};
+  std::atomic<std::uint32_t> m_discontinuityCount{0};
+
+  void initialize(std::uint64_t usecs, std::uint32_t periodFrames, double sampleRate);
+  void publish();
+
+public:
+  /**
+   * @param bandwidth - the bandwidth of the loop in Hertz. Smaller values smooth out
+   * more jitter but follow changes of the sample rate more slowly.
+   */
+  explicit DelayLockedLoop(double bandwidth = DEFAULT_BANDWIDTH) : m_bandwidth{bandwidth} {}
+  DelayLockedLoop(const DelayLockedLoop &) = delete;            ///< no copy constructor
+  DelayLockedLoop &operator=(const DelayLockedLoop &) = delete; ///< no copy assignment
+
+  /**
+   * Forget all previous measurements. The next `update()` restarts the loop.
+   * The unwrapped frame count continues where it was.
+   */
+  void reset();
+
+  /**
+   * Feed the loop with the timing of a new process cycle.
+   *
+   * The loop restarts by itself when the cycle does not follow the previous one
+   * (e.g. after an xrun or a change of the buffer size).
+   *
+   * After a discontinuity (see `DISCONTINUITY_SECONDS`) the loop restarts as well. When the
+   * frame count went backwards, the unwrapped frame count is re-based so that it keeps
+   * increasing: the new cycle is taken to follow the previous one immediately.
+   * @param frames - the (wrapping) frame count at the start of the cycle.
+   * @param usecs - the system time in microseconds at the start of the cycle.
+   * @param periodFrames - the number of frames in the cycle.
+   * @param sampleRate - the nominal sample rate in frames per second.
+   * @return true if a discontinuity has been detected.
+   */
+  bool update(std::uint32_t frames, std::uint64_t usecs, std::uint32_t periodFrames,
+              double sampleRate);
+
+  /**
+   * @return the number of discontinuities detected since the loop was constructed.
+   */
+  std::uint32_t discontinuityCount() const {
+    return m_discontinuityCount.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @return true once the loop has been fed with at least one cycle.
+   */
+  bool isValid() const { return m_publishedValid.load(std::memory_order_acquire); }
+
+  /**
+   * The unwrapped frame count at the start of the current cycle.
+   * @return the frame count given to the last `update()` extended to 64 bits.
+   */
+  std::int64_t cycleStartFrame() const;
+
+  /**
+   * Estimate the frame position at a given system time.
+   * @param usecs - a system time in microseconds (the same clock as used by `update()`).
+   * @return the estimated (fractional) frame position, or zero if the loop is not valid.
+   */
+  double framePosition(std::uint64_t usecs) const;
+};
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_DELAY_LOCKED_LOOP_H
@@ -0,0 +1,104 @@
+/*
+ * File: direct_writer.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_DIRECT_WRITER_H
+#define A_J_MIDI_SRC_DIRECT_WRITER_H
+
+#include <cstring>
+
+namespace a2jmidi {
+
+/**
+ * Writes the events of a cycle straight into the output buffer, as they are retrieved.
+ *
+ * The regular path copies each event into the `StagingBuffer`, sorts it, and copies it
+ * again into the JACK buffer. In the common case, the events come in order and there is
+ * plenty of room; then the direct path reserves the space in the output buffer and copies
+ * the bytes only once.
+ *
+ * The direct path is given up for the rest of the cycle as soon as an event comes out of
+ * order, or the free space falls below a threshold (where the `LoadShedder` takes over).
+ * The caller then stages the event (and all events that follow) as usual; the staged events
+ * must not be written before `lastFrame()`.
+ *
+ * @tparam Sink - the output buffer. It must provide
+ * `unsigned char *reserve(int frame, int size)` (nullptr if there is no space) and
+ * `int freeSpace() const` (the largest event that can still be written).
+ */
+template <typename Sink> class DirectWriter {
+private:
+  Sink m_sink{};
+  int m_minFreeSpace{0};
+  int m_lastFrame{0};
+  bool m_active{false};
+
+public:
+  /**
+   * Start a new cycle.
+   * @param sink - the output buffer of this cycle.
+   * @param enabled - false if the direct path shall not be used in this cycle (because
+   * events are pending from an earlier cycle, or the events must be coalesced).
+   * @param minFreeSpace - the direct path is given up when less space is left.
+   */
+  void beginCycle(const Sink &sink, bool enabled, int minFreeSpace) noexcept {
+    m_sink = sink;
+    m_minFreeSpace = minFreeSpace;
+    m_lastFrame = 0;
+    m_active = enabled;
+  }
+
+  /**
+   * @return true as long as events are written directly in this cycle.
+   */
+  bool active() const noexcept { return m_active; }
+
+  /**
+   * @return the position of the last event written directly; the events staged in this
+   * cycle must not be written before.
+   */
+  int lastFrame() const noexcept { return m_lastFrame; }
+
+  /**
+   * Write an event directly, if possible.
+   * @param frame - the position in the output buffer.
+   * @param data - the MIDI bytes.
+   * @param size - the number of MIDI bytes.
+   * @return true if the event has been written; false if it must be staged (from now on,
+   * `active()` is false).
+   */
+  bool write(int frame, const unsigned char *data, int size) noexcept {
+    if (!m_active) {
+      return false;
+    }
+    if (frame < m_lastFrame || m_sink.freeSpace() - size < m_minFreeSpace) {
+      m_active = false;
+      return false;
+    }
+    unsigned char *reserved = m_sink.reserve(frame, size);
+    if (!reserved) {
+      m_active = false;
+      return false;
+    }
+    std::memcpy(reserved, data, size);
+    m_lastFrame = frame;
+    return true;
+  }
+};
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_DIRECT_WRITER_H
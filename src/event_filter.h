@@ -0,0 +1,97 @@
+/*
+ * File: event_filter.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_EVENT_FILTER_H
+#define A_J_MIDI_SRC_EVENT_FILTER_H
+
+#include <alsa/asoundlib.h>
+#include <bitset>
+#include <initializer_list>
+#include <string>
+
+namespace alsaClient {
+
+/**
+ * The set of ALSA-sequencer-event types that the kernel shall not deliver to this client.
+ *
+ * Blocked events never wake up the listener thread. The types are grouped into categories
+ * that can be named on the command line: `clock`, `sensing`, `transport`, `timecode`,
+ * `sysex`, `aftertouch`, `program`, `pitchbend` and `controller`.
+ */
+class EventFilter {
+private:
+  std::bitset<256> m_blocked{};
+
+  void block(std::initializer_list<int> types) {
+    for (int type : types) {
+      m_blocked.set(static_cast<std::size_t>(type));
+    }
+  }
+
+public:
+  /**
+   * Block all event types of the given category.
+   * @param category - the name of a category (see above).
+   * @return false if the category is unknown; the filter is then unchanged.
+   */
+  bool blockCategory(const std::string &category) {
+    if (category == "clock") {
+      block({SND_SEQ_EVENT_CLOCK, SND_SEQ_EVENT_TICK});
+    } else if (category == "sensing") {
+      block({SND_SEQ_EVENT_SENSING});
+    } else if (category == "transport") {
+      block({SND_SEQ_EVENT_START, SND_SEQ_EVENT_CONTINUE, SND_SEQ_EVENT_STOP,
+             SND_SEQ_EVENT_SONGPOS, SND_SEQ_EVENT_SONGSEL});
+    } else if (category == "timecode") {
+      block({SND_SEQ_EVENT_QFRAME});
+    } else if (category == "sysex") {
+      block({SND_SEQ_EVENT_SYSEX});
+    } else if (category == "aftertouch") {
+      block({SND_SEQ_EVENT_KEYPRESS, SND_SEQ_EVENT_CHANPRESS});
+    } else if (category == "program") {
+      block({SND_SEQ_EVENT_PGMCHANGE});
+    } else if (category == "pitchbend") {
+      block({SND_SEQ_EVENT_PITCHBEND});
+    } else if (category == "controller") {
+      block({SND_SEQ_EVENT_CONTROLLER, SND_SEQ_EVENT_CONTROL14, SND_SEQ_EVENT_NONREGPARAM,
+             SND_SEQ_EVENT_REGPARAM});
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @param type - an ALSA-sequencer-event type.
+   * @return true if events of this type are blocked.
+   */
+  bool blocks(int type) const { return m_blocked.test(static_cast<std::size_t>(type & 0xFF)); }
+
+  /**
+   * @return true if no event type is blocked.
+   */
+  bool empty() const { return m_blocked.none(); }
+
+  /**
+   * @return the number of blocked event types.
+   */
+  int blockedCount() const { return static_cast<int>(m_blocked.count()); }
+};
+
+} // namespace alsaClient
+#endif // A_J_MIDI_SRC_EVENT_FILTER_H
@@ -0,0 +1,177 @@
+/*
+ * File: event_placement.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_EVENT_PLACEMENT_H
+#define A_J_MIDI_SRC_EVENT_PLACEMENT_H
+
+#include "a2jmidi_clock.h"
+
+namespace a2jmidi {
+
+/**
+ * How the events are placed into the JACK buffers.
+ */
+enum class Placement : int {
+  /**
+   * The events recorded during the previous cycle are written into the current buffer,
+   * keeping their spacing. Every event is delayed by one period (plus the jitter compensation).
+   */
+  previousCycle,
+  /**
+   * Low latency: every event that is available when the process callback starts is
+   * written into the current buffer, as early as possible. Events recorded after the
+   * start of the cycle keep their position; older events are moved to the start of the
+   * buffer.
+   */
+  currentCycle,
+  /**
+   * Constant latency: every event is placed exactly a fixed delay after its time stamp.
+   * The spacing of the events is preserved exactly; events that arrive too late for
+   * their slot are moved to the start of the buffer (and counted).
+   */
+  constantLatency,
+};
+
+/**
+ * The stretch of time that is mapped onto one JACK buffer.
+ */
+struct CycleWindow {
+  TimePoint bufferStart; ///< the time that corresponds to the first frame of the buffer.
+  TimePoint deadline;    ///< events recorded at or after the deadline belong to a later cycle.
+  int nFrames;           ///< the number of frames in the buffer.
+  int tolerance;         ///< events lying further before the buffer are discarded.
+};
+
+/**
+ * The window for `Placement::previousCycle`.
+ * @param deadline - the start of the current cycle minus the jitter compensation.
+ * @param nFrames - the number of frames in the buffer.
+ * @return the window ending at the deadline.
+ */
+inline CycleWindow previousCycleWindow(TimePoint deadline, int nFrames) {
+  return CycleWindow{deadline - nFrames, deadline, nFrames, nFrames};
+}
+
+/**
+ * The window for `Placement::currentCycle`.
+ *
+ * An event recorded shortly before the previous process callback, but not yet visible
+ * to it, lies up to a period plus the wake-up and listener delays before the buffer;
+ * such events are still emitted.
+ * @param cycleStart - the time of the first frame of the current buffer.
+ * @param processStart - the time when the process callback started.
+ * @param nFrames - the number of frames in the buffer.
+ * @return the window starting at the cycle start.
+ */
+inline CycleWindow currentCycleWindow(TimePoint cycleStart, TimePoint processStart, int nFrames) {
+  return CycleWindow{cycleStart, processStart, nFrames, 2 * nFrames};
+}
+
+/**
+ * The window for `Placement::constantLatency`.
+ * @param cycleStart - the time of the first frame of the current buffer.
+ * @param delay - the fixed delay (in frames) between the time stamp of an event and its position.
+ * @param nFrames - the number of frames in the buffer.
+ * @return the window that lies `delay` frames before the current buffer.
+ */
+inline CycleWindow constantLatencyWindow(TimePoint cycleStart, int delay, int nFrames) {
+  return CycleWindow{cycleStart - delay, cycleStart - delay + nFrames, nFrames, nFrames};
+}
+
+/**
+ * The fixed delay that `Placement::constantLatency` can actually keep.
+ *
+ * An event becomes visible to the process callback one period after the start of its
+ * window at the earliest, plus the wake-up delay of the listener. A shorter delay would let
+ * every event miss its slot, so it is raised to this minimum.
+ * @param requested - the delay asked for on the command line.
+ * @param nFrames - the number of frames in a buffer.
+ * @param compensation - the current jitter compensation (the wake-up delay of the listener).
+ * @return the delay to be used, not smaller than `nFrames + compensation`.
+ */
+inline int usableFixedDelay(int requested, int nFrames, int compensation) {
+  const int minimum = nFrames + compensation;
+  return (requested < minimum) ? minimum : requested;
+}
+
+/**
+ * Indicates that an event lies too far in the past (e.g. after system hibernation)
+ * and shall be discarded.
+ */
+constexpr int DISCARD_EVENT = -1;
+
+/**
+ * The position of an event in the buffer.
+ *
+ * Events that lie before the buffer are moved to its start, events that lie beyond
+ * the buffer are moved to its end.
+ * @param window - the window of the current cycle.
+ * @param timeStamp - the time when the event was recorded.
+ * @return the frame offset in the buffer, or `DISCARD_EVENT`.
+ */
+inline int placeEvent(const CycleWindow &window, TimePoint timeStamp) {
+  TimePoint offset = timeStamp - window.bufferStart;
+  if (offset < -window.tolerance) {
+    return DISCARD_EVENT;
+  }
+  if (offset < 0) {
+    return 0;
+  }
+  if (offset >= window.nFrames) {
+    return window.nFrames - 1;
+  }
+  return static_cast<int>(offset);
+}
+
+/**
+ * The smallest and the largest delay (in frames) between the time stamp of an event and
+ * its position in the JACK timeline.
+ */
+struct LatencyRange {
+  int min;
+  int max;
+};
+
+/**
+ * The latency added by the bridge, as it shall be reported to the JACK server.
+ *
+ * Events that arrive too late for their nominal position (see `placeEvent()`) are not
+ * accounted for; the range describes the regular case.
+ * @param placement - the placement mode.
+ * @param nFrames - the number of frames in a buffer.
+ * @param compensation - the jitter compensation (only used for `Placement::previousCycle`).
+ * @param fixedDelay - the delay actually used (see `usableFixedDelay()`), only used for
+ * `Placement::constantLatency`.
+ * @return the range of latencies.
+ */
+inline LatencyRange placementLatency(Placement placement, int nFrames, int compensation,
+                                     int fixedDelay) {
+  switch (placement) {
+  case Placement::currentCycle:
+    // events recorded after the cycle start are on time, older ones are up to a period late.
+    return LatencyRange{0, nFrames};
+  case Placement::constantLatency:
+    return LatencyRange{fixedDelay, fixedDelay};
+  case Placement::previousCycle:
+  default:
+    return LatencyRange{nFrames + compensation, nFrames + compensation};
+  }
+}
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_EVENT_PLACEMENT_H
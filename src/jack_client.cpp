@@ -17,9 +17,12 @@
  * limitations under the License.
  */
 #include "jack_client.h"
+#include "delay_locked_loop.h"
+#include "jitter_estimator.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
 #include <climits>
+#include <cmath>
 #include <mutex>
 #include <thread>
 namespace jackClient {
@@ -41,6 +44,18 @@ ProcessCallback g_customCallback{nullptr};
  */
 OnServerAbendHandler g_onServerAbendHandler{nullptr};
 
+/**
+ * The `g_latencyFunction` computes the capture latency of the port `g_latencyPort`.
+ */
+LatencyFunction g_latencyFunction{nullptr};
+JackPort g_latencyPort{nullptr};
+
+/**
+ * The handlers invoked when the buffer size or the sample rate change.
+ */
+BufferSizeHandler g_bufferSizeHandler{nullptr};
+SampleRateHandler g_sampleRateHandler{nullptr};
+
 /**
  * Protects the jackClient from being simultaneously accessed by multiple threads
  * while the state might change.
@@ -50,6 +65,28 @@ static std::mutex g_stateAccessMutex;
 static State g_stateFlag{State::closed};
 
 inline State stateInternal() { return g_stateFlag; }
+
+/**
+ * Relates the system time to the frame count of the JACK server.
+ * It is updated at the start of each process cycle.
+ */
+static a2jmidi::DelayLockedLoop g_delayLockedLoop;
+/**
+ * Set (by a non real-time thread) when the delay-locked loop must start over,
+ * the process thread will then reset it at the start of the next cycle.
+ */
+static std::atomic<bool> g_resyncRequested{false};
+/**
+ * The number of xruns reported by the JACK server.
+ */
+static std::atomic<std::uint32_t> g_xrunCount{0};
+/**
+ * The start of the current cycle and the time when the process callback was started.
+ * Only used by the process thread.
+ */
+static a2jmidi::TimePoint g_cycleStart{0};
+static a2jmidi::TimePoint g_processStart{0};
+
 /**
  * The JackClock is an instance of the general clock.
  * This class gets the time from the JACK sever.
@@ -62,13 +99,30 @@ public:
   ~JackClock() override = default;
   /**
    * The estimated current time in frames.
+   *
+   * Once the process callback runs, the time is taken from the delay-locked loop. It is
+   * then a 64 bit frame count that does not wrap around. Before that, it is the
+   * (32 bit) `jack_frame_time()`; both agree until the first wrap-around.
    * @return the estimated current time in system specific ticks.
    */
   long now() override {
     if (!g_jackClientHandle) {
       return LONG_MAX;
     }
-    return jack_frame_time(g_jackClientHandle);
+    if (!g_delayLockedLoop.isValid()) {
+      return jack_frame_time(g_jackClientHandle);
+    }
+    return static_cast<long>(std::floor(g_delayLockedLoop.framePosition(jack_get_time())));
+  }
+  /**
+   * The resolution of the clock.
+   * @return the sample rate of the JACK server.
+   */
+  long ticksPerSecond() override {
+    if (!g_jackClientHandle) {
+      return 0;
+    }
+    return jack_get_sample_rate(g_jackClientHandle);
   }
 };
 
@@ -139,26 +193,110 @@ void stopInternal() {
   }
   g_onServerAbendHandler = nullptr;
   g_customCallback = nullptr;
+  g_latencyFunction = nullptr;
+  g_latencyPort = nullptr;
+  g_bufferSizeHandler = nullptr;
+  g_sampleRateHandler = nullptr;
   g_stateFlag = State::idle;
 }
 
 
 using namespace std::chrono_literals;
-/**
- * A small amount of time (less than half a millisecond) used
- * to compensate for jitter in the JACK library.
- */
-const a2jmidi::TimePoint JITTER_COMPENSATION = 16;
 
 /**
  * The time at the start of the current process cycle.
  *
- * This function may only be used from the process callback.
+ * This function may only be used from the process callback. It feeds the
+ * delay-locked loop with the timing of the current cycle.
  *
+ * The deadline lies a little before the cycle start; the distance is chosen by the
+ * jitter estimator (see `a2jmidi::jitter::compensation()`).
+ *
+ * @param nFrames - number of frames in the current cycle
  * @return the precise time at the start of the current process cycle.
  */
-inline a2jmidi::TimePoint newDeadline() {
-  return jack_last_frame_time(g_jackClientHandle) - JITTER_COMPENSATION;
+inline a2jmidi::TimePoint newDeadline(jack_nframes_t nFrames) {
+  jack_nframes_t currentFrames;
+  jack_time_t currentUsecs;
+  jack_time_t nextUsecs;
+  float periodUsecs;
+  int err = jack_get_cycle_times(g_jackClientHandle, &currentFrames, &currentUsecs, &nextUsecs,
+                                 &periodUsecs);
+  if (g_resyncRequested.exchange(false, std::memory_order_acq_rel)) {
+    g_delayLockedLoop.reset();
+  }
+  if (err) {
+    // the cycle times are not available (e.g. a JACK version without DLL).
+    g_cycleStart = jack_last_frame_time(g_jackClientHandle);
+  } else {
+    g_delayLockedLoop.update(currentFrames, currentUsecs, nFrames, sampleRate());
+    g_cycleStart = g_delayLockedLoop.cycleStartFrame();
+  }
+  g_processStart = g_cycleStart + jack_frames_since_cycle_start(g_jackClientHandle);
+  return g_cycleStart - a2jmidi::jitter::compensation();
+}
+
+/**
+ * This callback will be invoked by the JACK server whenever the latencies of the
+ * graph are recomputed. It publishes the capture latency of the sender port.
+ * @param mode - `JackCaptureLatency` or `JackPlaybackLatency`.
+ * @param arg - (unused) a pointer to an arbitrary, user supplied, data.
+ */
+void jackLatencyCallback(jack_latency_callback_mode_t mode, [[maybe_unused]] void *arg) {
+  if (mode != JackCaptureLatency || !g_latencyFunction || !g_latencyPort) {
+    // the sender port has no inputs, there is no playback latency to propagate.
+    return;
+  }
+  jack_latency_range_t range =
+      g_latencyFunction(static_cast<int>(jack_get_buffer_size(g_jackClientHandle)));
+  jack_port_set_latency_range(g_latencyPort, JackCaptureLatency, &range);
+  SPDLOG_LOGGER_TRACE(g_logger, "jackClient::jackLatencyCallback - capture latency [{}, {}].",
+                      range.min, range.max);
+}
+
+/**
+ * This callback will be invoked by the JACK server (on a non real-time thread)
+ * when the buffer size is about to change.
+ * @param nFrames - the new number of frames per cycle.
+ * @param arg - (unused) a pointer to an arbitrary, user supplied, data.
+ * @return 0 on success, a non-zero value otherwise.
+ */
+int jackBufferSizeCallback(jack_nframes_t nFrames, [[maybe_unused]] void *arg) {
+  SPDLOG_LOGGER_INFO(g_logger, "JACK buffer size changed to {} frames.", nFrames);
+  g_resyncRequested = true;
+  if (g_bufferSizeHandler) {
+    g_bufferSizeHandler(static_cast<int>(nFrames));
+  }
+  return 0;
+}
+
+/**
+ * This callback will be invoked by the JACK server (on a non real-time thread)
+ * when the sample rate changes.
+ * @param sampleRate - the new sample rate in frames per second.
+ * @param arg - (unused) a pointer to an arbitrary, user supplied, data.
+ * @return 0 on success, a non-zero value otherwise.
+ */
+int jackSampleRateCallback(jack_nframes_t sampleRate, [[maybe_unused]] void *arg) {
+  SPDLOG_LOGGER_INFO(g_logger, "JACK sample rate changed to {} Hz.", sampleRate);
+  // the loop's filter coefficients and its time origin depend on the sample rate.
+  g_resyncRequested = true;
+  if (g_sampleRateHandler) {
+    g_sampleRateHandler(static_cast<int>(sampleRate));
+  }
+  return 0;
+}
+
+/**
+ * This callback will be invoked by the JACK server (on a non real-time thread)
+ * after an xrun.
+ * @param arg - (unused) a pointer to an arbitrary, user supplied, data.
+ * @return 0 on success, a non-zero value otherwise.
+ */
+int jackXrunCallback([[maybe_unused]] void *arg) {
+  g_xrunCount.fetch_add(1, std::memory_order_release);
+  SPDLOG_LOGGER_DEBUG(g_logger, "JACK xrun.");
+  return 0;
 }
 
 void jackShutdownCallback([[maybe_unused]] void *arg) {
@@ -181,11 +319,27 @@ void jackShutdownCallback([[maybe_unused]] void *arg) {
  */
 int jackInternalCallback(jack_nframes_t nFrames, [[maybe_unused]] void *arg) {
   if (g_customCallback) {
-    return g_customCallback(nFrames, newDeadline());
+    return g_customCallback(nFrames, newDeadline(nFrames));
   }
   return 0;
 }
 } // namespace impl
+
+a2jmidi::TimePoint cycleStart() noexcept { return g_cycleStart; }
+
+a2jmidi::TimePoint processStart() noexcept { return g_processStart; }
+
+std::uint32_t xrunCount() noexcept { return g_xrunCount.load(std::memory_order_acquire); }
+
+std::uint32_t clockDiscontinuityCount() noexcept {
+  return g_delayLockedLoop.discontinuityCount();
+}
+
+int bufferSize() noexcept {
+  jack_client_t *handle = g_jackClientHandle;
+  return handle ? static_cast<int>(jack_get_buffer_size(handle)) : 0;
+}
+
 /**
  * The name given by the JACK server to this client.
  * As long as the client is not connected to the server, an empty string will be returned.
@@ -253,6 +407,14 @@ void open(const std::string &clientName, bool startServer) noexcept(false) {
 
   // Register a function to be called if and when the JACK server shuts down the client thread.
   jack_on_shutdown(g_jackClientHandle, jackShutdownCallback, nullptr);
+  // These must be registered before activation; the handlers can be set later.
+  if (jack_set_buffer_size_callback(g_jackClientHandle, jackBufferSizeCallback, nullptr) ||
+      jack_set_sample_rate_callback(g_jackClientHandle, jackSampleRateCallback, nullptr)) {
+    SPDLOG_LOGGER_ERROR(g_logger, "jackClient::open - cannot register the format callbacks.");
+  }
+  if (jack_set_xrun_callback(g_jackClientHandle, jackXrunCallback, nullptr)) {
+    SPDLOG_LOGGER_ERROR(g_logger, "jackClient::open - cannot register the xrun callback.");
+  }
   g_stateFlag = State::idle;
 }
 /**
@@ -299,6 +461,7 @@ void activate() noexcept(false) {
                             stateAsString(g_stateFlag));
   }
 
+  g_delayLockedLoop.reset();
   int err = jack_activate(g_jackClientHandle);
   if (err) {
     throw ServerException("Failed to activate JACK client!");
@@ -319,6 +482,32 @@ void onServerAbend(const OnServerAbendHandler &handler) noexcept(false) {
   }
   g_onServerAbendHandler = handler;
 }
+/**
+ * Register a handler that shall be called when the buffer size changes.
+ * @param handler - the function to be called
+ * @throws BadStateException - if this function is called from a state other than `idle`.
+ */
+void onBufferSizeChange(const BufferSizeHandler &handler) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  SPDLOG_LOGGER_TRACE(g_logger, "jackClient::onBufferSizeChange");
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot register handler. Wrong state " + stateAsString(g_stateFlag));
+  }
+  g_bufferSizeHandler = handler;
+}
+/**
+ * Register a handler that shall be called when the sample rate changes.
+ * @param handler - the function to be called
+ * @throws BadStateException - if this function is called from a state other than `idle`.
+ */
+void onSampleRateChange(const SampleRateHandler &handler) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  SPDLOG_LOGGER_TRACE(g_logger, "jackClient::onSampleRateChange");
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot register handler. Wrong state " + stateAsString(g_stateFlag));
+  }
+  g_sampleRateHandler = handler;
+}
 /**
  * Create a new Clock that gets its timing from the JACK server.
  * @return a smart pointer holding the clock.
@@ -381,4 +570,44 @@ JackPort newSenderPort(const std::string &portName) noexcept(false) {
   SPDLOG_LOGGER_TRACE(g_logger, "jackClient::newSenderPort - port \"{}\" created.", portName);
   return result;
 }
+
+/**
+ * Report the latency added by this client to the JACK server.
+ *
+ * `registerLatencyCallback()` can only be called from the `idle` state.
+ *
+ * @param port - a port created by `newSenderPort()`.
+ * @param latencyFunction - the function that computes the latency.
+ * @throws BadStateException - if this function is called from a state other than `idle`.
+ * @throws ServerException - if the JACK server has encountered an other problem.
+ */
+void registerLatencyCallback(JackPort port,
+                             const LatencyFunction &latencyFunction) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  SPDLOG_LOGGER_TRACE(g_logger, "jackClient::registerLatencyCallback");
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot register latency callback. Wrong state " +
+                            stateAsString(g_stateFlag));
+  }
+  g_latencyPort = port;
+  g_latencyFunction = latencyFunction;
+  int err = jack_set_latency_callback(g_jackClientHandle, jackLatencyCallback, nullptr);
+  if (err) {
+    throw ServerException("JACK error when registering latency callback.");
+  }
+}
+
+/**
+ * Tell the JACK server that the result of the latency function has changed.
+ */
+void recomputeLatencies() noexcept {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag != State::running) {
+    return;
+  }
+  int err = jack_recompute_total_latencies(g_jackClientHandle);
+  if (err) {
+    SPDLOG_LOGGER_ERROR(g_logger, "jackClient::recomputeLatencies - Error({})", err);
+  }
+}
 } // namespace jackClient
\ No newline at end of file
@@ -23,6 +23,7 @@
 #include "sys_clock.h"
 #include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <jack/jack.h>
@@ -96,6 +97,15 @@ a2jmidi::ClockPtr clock();
  */
 void open(const std::string &clientName, bool startServer = false) noexcept(false);
 
+/**
+ * The number of frames per cycle.
+ *
+ * As long as the client is not connected to the server (jackClient in closed state),
+ * zero will be returned.
+ * @return the current buffer size.
+ */
+int bufferSize() noexcept;
+
 /**
  * The name given by the JACK server to this client (aka device).
  *
@@ -127,6 +137,39 @@ using JackPort = jack_port_t *;
  */
 JackPort newSenderPort(const std::string& portName) noexcept(false);
 
+/**
+ * Prototype for the client supplied function that computes how long the data in the
+ * sender port has been delayed.
+ * @param nFrames - the current buffer size.
+ * @return the minimal and maximal delay in frames.
+ */
+using LatencyFunction = std::function<jack_latency_range_t(const int nFrames)>;
+
+/**
+ * Report the latency added by this client to the JACK server.
+ *
+ * The result of the given function is published as the _capture latency_ of the port,
+ * so that downstream clients (e.g. a recorder) can compensate for it. The server asks
+ * for it on activation and whenever the latencies of the graph are recomputed.
+ *
+ * `registerLatencyCallback()` can only be called from the `idle` state.
+ *
+ * @param port - a port created by `newSenderPort()`.
+ * @param latencyFunction - the function that computes the latency (it is __not__ called
+ * from the process thread).
+ * @throws BadStateException - if this function is called from a state other than `idle`.
+ * @throws ServerException - if the JACK server has encountered an other problem.
+ */
+void registerLatencyCallback(JackPort port, const LatencyFunction &latencyFunction) noexcept(false);
+
+/**
+ * Tell the JACK server that the result of the latency function has changed.
+ *
+ * The server will then invoke the latency callback again. Calling this function
+ * in a state other than `running` has no effect.
+ */
+void recomputeLatencies() noexcept;
+
 
 /**
  * Tell the JACK server that the client is ready to process.
@@ -166,6 +209,42 @@ void close() noexcept;
  * the client.
  */
 using ProcessCallback = std::function<int(const int nFrames, const a2jmidi::TimePoint deadLine)>;
+
+/**
+ * The time of the first frame in the current buffer.
+ *
+ * This function may only be used from the process callback.
+ * @return the start of the current cycle (without jitter compensation).
+ */
+a2jmidi::TimePoint cycleStart() noexcept;
+
+/**
+ * The time when the current process callback was started, that is the start of the cycle
+ * plus the time the JACK server needed to wake up this client.
+ *
+ * This function may only be used from the process callback.
+ * @return the start of the cycle plus `jack_frames_since_cycle_start()`.
+ */
+a2jmidi::TimePoint processStart() noexcept;
+
+/**
+ * The number of xruns reported by the JACK server since the client was opened.
+ *
+ * The process callback can compare this value with the one of the previous cycle
+ * to find out whether cycles have been skipped. This function is lock-free.
+ * @return the number of xruns.
+ */
+std::uint32_t xrunCount() noexcept;
+
+/**
+ * The number of discontinuities of the JACK clock (for example after the system has been
+ * suspended) since the client was opened.
+ *
+ * When this value changes, all time points taken before are meaningless in relation to
+ * the current cycle. This function is lock-free.
+ * @return the number of clock discontinuities.
+ */
+std::uint32_t clockDiscontinuityCount() noexcept;
 /**
  * Prototype for the client supplied function that will be called when the
  * server is ending abnormally.
@@ -188,6 +267,38 @@ void registerProcessCallback(const ProcessCallback &processCallback) noexcept(fa
  */
 void onServerAbend(const OnServerAbendHandler &handler) noexcept(false) ;
 
+/**
+ * Prototype for the client supplied function that will be called when the
+ * JACK server changes the buffer size.
+ *
+ * It is called from a non real-time thread, before the first process cycle with
+ * the new size. Buffers sized for the period can be re-allocated here.
+ * @param nFrames - the new number of frames per cycle.
+ */
+using BufferSizeHandler = std::function<void(const int nFrames)>;
+/**
+ * Register a handler that shall be called when the buffer size changes.
+ * @param handler - the function to be called
+ * @throws BadStateException - if this function is called from a state other than `idle`.
+ */
+void onBufferSizeChange(const BufferSizeHandler &handler) noexcept(false);
+
+/**
+ * Prototype for the client supplied function that will be called when the
+ * JACK server changes the sample rate.
+ *
+ * It is called from a non real-time thread. Everything measured in frames (for example
+ * the jitter statistics) is outdated from now on.
+ * @param sampleRate - the new sample rate in frames per second.
+ */
+using SampleRateHandler = std::function<void(const int sampleRate)>;
+/**
+ * Register a handler that shall be called when the sample rate changes.
+ * @param handler - the function to be called
+ * @throws BadStateException - if this function is called from a state other than `idle`.
+ */
+void onSampleRateChange(const SampleRateHandler &handler) noexcept(false);
+
 /**
  * Implementation specific stuff.
  */
@@ -0,0 +1,124 @@
+/*
+ * File: jitter_estimator.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "jitter_estimator.h"
+#include <algorithm>
+
+namespace a2jmidi::jitter {
+
+void Histogram::add(TimePoint value) noexcept {
+  TimePoint bin = std::clamp(value / BIN_WIDTH, TimePoint{0}, TimePoint{BIN_COUNT - 1});
+  m_bins[bin].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::uint32_t Histogram::count() const noexcept {
+  std::uint32_t result = 0;
+  for (const auto &bin : m_bins) {
+    result += bin.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+TimePoint Histogram::percentile(double percentile) const noexcept {
+  const double total = count();
+  if (total == 0) {
+    return 0;
+  }
+  const double wanted = total * std::clamp(percentile, 0.0, 100.0) / 100.0;
+  double accumulated = 0;
+  for (int i = 0; i < BIN_COUNT; i++) {
+    accumulated += m_bins[i].load(std::memory_order_relaxed);
+    if (accumulated >= wanted) {
+      return (i + 1) * BIN_WIDTH;
+    }
+  }
+  return BIN_COUNT * BIN_WIDTH;
+}
+
+void Histogram::age() noexcept {
+  if (count() <= AGING_THRESHOLD) {
+    return;
+  }
+  for (auto &bin : m_bins) {
+    // subtracting (instead of storing) keeps increments made in the meantime.
+    bin.fetch_sub(bin.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::clear() noexcept {
+  for (auto &bin : m_bins) {
+    bin.store(0, std::memory_order_relaxed);
+  }
+}
+
+std::vector<std::uint32_t> Histogram::bins() const {
+  std::vector<std::uint32_t> result;
+  result.reserve(BIN_COUNT);
+  for (const auto &bin : m_bins) {
+    result.push_back(bin.load(std::memory_order_relaxed));
+  }
+  return result;
+}
+
+static Histogram g_wakeUpDelay; ///< the wake-up delays (and the needs of late events).
+static Histogram g_lead;        ///< the deadline minus the event time stamps.
+static std::atomic<TimePoint> g_compensation{DEFAULT_COMPENSATION};
+static std::atomic<double> g_percentile{DEFAULT_PERCENTILE};
+static std::atomic<std::uint32_t> g_lateEventCount{0};
+
+void reset(double percentile) noexcept {
+  g_wakeUpDelay.clear();
+  g_lead.clear();
+  g_lateEventCount = 0;
+  g_percentile = std::clamp(percentile, 0.0, 100.0);
+  g_compensation = DEFAULT_COMPENSATION;
+}
+
+void addWakeUpDelay(TimePoint delay) noexcept { g_wakeUpDelay.add(delay); }
+
+void addLead(TimePoint lead, int nFrames) noexcept {
+  g_lead.add(lead);
+  TimePoint lateness = lead - nFrames;
+  if (lateness > 0) {
+    // with this much more compensation, the event would have been in time.
+    g_lateEventCount.fetch_add(1, std::memory_order_relaxed);
+    g_wakeUpDelay.add(g_compensation.load(std::memory_order_relaxed) + lateness);
+  }
+}
+
+void update() noexcept {
+  g_wakeUpDelay.age();
+  g_lead.age();
+  if (g_wakeUpDelay.count() < MIN_SAMPLE_COUNT) {
+    return;
+  }
+  g_compensation.store(g_wakeUpDelay.percentile(g_percentile.load(std::memory_order_relaxed)),
+                       std::memory_order_relaxed);
+}
+
+TimePoint compensation() noexcept { return g_compensation.load(std::memory_order_relaxed); }
+
+double percentile() noexcept { return g_percentile; }
+
+std::uint32_t lateEventCount() noexcept { return g_lateEventCount; }
+
+const Histogram &wakeUpDelayHistogram() noexcept { return g_wakeUpDelay; }
+
+const Histogram &leadHistogram() noexcept { return g_lead; }
+
+} // namespace a2jmidi::jitter
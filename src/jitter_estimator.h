@@ -0,0 +1,168 @@
+/*
+ * File: jitter_estimator.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_JITTER_ESTIMATOR_H
+#define A_J_MIDI_SRC_JITTER_ESTIMATOR_H
+
+#include "a2jmidi_clock.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * The jitter estimator chooses how far the deadline of a JACK cycle is moved into
+ * the past (the _jitter compensation_).
+ *
+ * An event that has been stamped shortly before the start of a cycle might not yet
+ * be visible in the receiver queue when the cycle is processed. Such an event would
+ * end up in the next cycle at a position that lies before the start of the buffer
+ * (a "buffer underrun"). Moving the deadline by the compensation avoids this, at
+ * the cost of the same amount of latency.
+ *
+ * The estimator collects two distributions (in clock ticks, that is in frames):
+ * - the _wake-up delay_: the time between the time stamp of an event and the moment the
+ *   listener thread has put it into the queue.
+ * - the _lead_: the difference between the deadline of the cycle and the time stamp of
+ *   each event written into a JACK buffer. A lead larger than the cycle means the event
+ *   came too late.
+ *
+ * The compensation is the configured percentile of the wake-up delays. Events that came
+ * too late in spite of the compensation feed back into the wake-up delays.
+ */
+namespace a2jmidi::jitter {
+
+/**
+ * The compensation used as long as too few measurements are available.
+ */
+constexpr TimePoint DEFAULT_COMPENSATION = 16;
+/**
+ * The default percentile of the wake-up delays that the compensation shall cover.
+ */
+constexpr double DEFAULT_PERCENTILE = 99.0;
+/**
+ * The number of measurements needed before the compensation adapts.
+ */
+constexpr std::uint32_t MIN_SAMPLE_COUNT = 64;
+
+/**
+ * A histogram of non-negative time differences.
+ *
+ * Values are added lock-free (possibly from several threads). Old values
+ * gradually lose their weight; whenever the total count exceeds `AGING_THRESHOLD`,
+ * `age()` halves all bins.
+ */
+class Histogram {
+public:
+  static constexpr int BIN_COUNT = 512;  ///< the number of bins.
+  static constexpr TimePoint BIN_WIDTH = 4; ///< the width of a bin in clock ticks.
+  static constexpr std::uint32_t AGING_THRESHOLD = 1U << 16U;
+
+private:
+  std::array<std::atomic<std::uint32_t>, BIN_COUNT> m_bins{};
+
+public:
+  /**
+   * Count a value. Negative values are counted in the first bin, values beyond
+   * the range of the histogram in the last bin.
+   * @param value - a time difference in clock ticks.
+   */
+  void add(TimePoint value) noexcept;
+  /**
+   * @return the number of values in the histogram.
+   */
+  std::uint32_t count() const noexcept;
+  /**
+   * The smallest value that is greater than or equal to the given percentage of all values.
+   * @param percentile - a value between 0 and 100.
+   * @return the upper edge of the bin where the percentile is reached, zero if empty.
+   */
+  TimePoint percentile(double percentile) const noexcept;
+  /**
+   * Halve all bins once the total count exceeds `AGING_THRESHOLD`.
+   */
+  void age() noexcept;
+  /**
+   * Remove all values.
+   */
+  void clear() noexcept;
+  /**
+   * A copy of the bins. Bin `i` counts the values in `[i*BIN_WIDTH, (i+1)*BIN_WIDTH)`.
+   * This function allocates memory, it shall not be used on the real-time thread.
+   * @return the current count of every bin.
+   */
+  std::vector<std::uint32_t> bins() const;
+};
+
+/**
+ * Restart the estimation.
+ *
+ * The histograms are cleared and the compensation is set back to `DEFAULT_COMPENSATION`.
+ * @param percentile - the percentile (between 0 and 100) of the wake-up delays
+ * that the compensation shall cover.
+ */
+void reset(double percentile = DEFAULT_PERCENTILE) noexcept;
+
+/**
+ * Record the wake-up delay of one event. Called by the listener thread.
+ * @param delay - the ticks between the time stamp of the event and its insertion into the queue.
+ */
+void addWakeUpDelay(TimePoint delay) noexcept;
+
+/**
+ * Record where an event was placed. Called from the JACK process callback.
+ * @param lead - the deadline minus the time stamp of the event.
+ * @param nFrames - the number of frames in the current cycle.
+ */
+void addLead(TimePoint lead, int nFrames) noexcept;
+
+/**
+ * Recompute the compensation from the collected wake-up delays.
+ * Called by the listener thread after each batch of events.
+ */
+void update() noexcept;
+
+/**
+ * The amount by which the deadline of a cycle shall be moved into the past.
+ * This function may be called from the JACK process callback.
+ * @return the current compensation in clock ticks.
+ */
+TimePoint compensation() noexcept;
+
+/**
+ * @return the percentile of the wake-up delays that the compensation covers.
+ */
+double percentile() noexcept;
+
+/**
+ * @return the number of events that were placed before the start of their buffer.
+ */
+std::uint32_t lateEventCount() noexcept;
+
+/**
+ * @return the distribution of the wake-up delays.
+ */
+const Histogram &wakeUpDelayHistogram() noexcept;
+
+/**
+ * @return the distribution of the deadline minus the event time stamps.
+ */
+const Histogram &leadHistogram() noexcept;
+
+} // namespace a2jmidi::jitter
+#endif // A_J_MIDI_SRC_JITTER_ESTIMATOR_H
@@ -0,0 +1,86 @@
+/*
+ * File: load_shedder.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "load_shedder.h"
+
+namespace a2jmidi {
+
+LoadShedder::LoadShedder()
+    : m_latest{std::make_unique<int[]>(midi::CONTINUOUS_KEY_COUNT)},
+      m_latestCycle{std::make_unique<std::uint32_t[]>(midi::CONTINUOUS_KEY_COUNT)} {}
+
+void LoadShedder::beginCycle(int capacity) noexcept {
+  m_pressureThreshold = capacity / PRESSURE_DIVISOR;
+  m_reserveThreshold = capacity / RESERVE_DIVISOR;
+  m_superseded = false;
+  m_cycle++;
+  if (m_cycle == 0) {
+    // after the wrap-around, old stamps could be mistaken for the current cycle.
+    for (int key = 0; key < midi::CONTINUOUS_KEY_COUNT; key++) {
+      m_latestCycle[key] = 0;
+    }
+    m_cycle = 1;
+  }
+}
+
+void LoadShedder::findLatest(const StagingBuffer &staging, int from) noexcept {
+  for (int position = from; position < staging.size(); position++) {
+    const int key = midi::continuousKey(staging.dataAt(position), staging.sizeAt(position));
+    if (key >= 0) {
+      m_latest[key] = position;
+      m_latestCycle[key] = m_cycle;
+    }
+  }
+  m_superseded = true;
+}
+
+bool LoadShedder::admit(const StagingBuffer &staging, int position, int freeSpace) noexcept {
+  if (freeSpace >= m_pressureThreshold) {
+    return true;
+  }
+  const unsigned char *data = staging.dataAt(position);
+  const int size = staging.sizeAt(position);
+  const midi::Priority priority = midi::classify(data, size);
+  if (priority == midi::Priority::essential || data[0] == 0xF0) {
+    return true; // SysEx is deferred or rejected by the SysEx policy, not shed.
+  }
+  if (priority == midi::Priority::continuous) {
+    if (!m_superseded) {
+      // only computed once per cycle, and only under pressure.
+      findLatest(staging, position);
+    }
+    const int key = midi::continuousKey(data, size);
+    if (key >= 0 && m_latestCycle[key] == m_cycle && m_latest[key] > position) {
+      m_coalescedCount.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true; // the latest value is kept, also below the reserve.
+  }
+  if (freeSpace < m_reserveThreshold) {
+    m_shedCount.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void LoadShedder::reset() noexcept {
+  m_coalescedCount = 0;
+  m_shedCount = 0;
+}
+
+} // namespace a2jmidi
@@ -0,0 +1,108 @@
+/*
+ * File: load_shedder.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_LOAD_SHEDDER_H
+#define A_J_MIDI_SRC_LOAD_SHEDDER_H
+
+#include "midi_priority.h"
+#include "staging_buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace a2jmidi {
+
+/**
+ * Decides which events are written when the JACK buffer is close to full.
+ *
+ * As long as there is enough free space, every event is admitted. Once the free space
+ * falls below a quarter of the buffer (_pressure_), a continuous message (see
+ * `midi::Priority`) is skipped if a later message of the same cycle carries a newer value
+ * for the same parameter (_coalescing_). Below an eighth of the buffer (_reserve_), only
+ * essential messages and the latest value of each continuous parameter are admitted
+ * (_shedding_), so that the remaining space goes to note-offs and the like, and no
+ * parameter is left at a stale value. SysEx messages are never shed: they are left to the
+ * SysEx policy (see `sysexAction()`), which defers them to the next cycle instead.
+ *
+ * The functions `beginCycle()` and `admit()` shall only be called from the process thread;
+ * they never allocate. The counters can be read from any thread.
+ */
+class LoadShedder {
+public:
+  /**
+   * Coalescing starts when the free space falls below the capacity divided by this.
+   */
+  static constexpr int PRESSURE_DIVISOR = 4;
+  /**
+   * Shedding starts when the free space falls below the capacity divided by this.
+   */
+  static constexpr int RESERVE_DIVISOR = 8;
+
+private:
+  int m_pressureThreshold{0};
+  int m_reserveThreshold{0};
+  bool m_superseded{false}; ///< true once `m_latest` has been filled in this cycle.
+  std::uint32_t m_cycle{0}; ///< identifies the current cycle in `m_latestCycle`.
+  /// for each continuous key: the position of the latest event (valid if stamped by this cycle).
+  std::unique_ptr<int[]> m_latest;
+  std::unique_ptr<std::uint32_t[]> m_latestCycle;
+
+  std::atomic<std::uint32_t> m_coalescedCount{0};
+  std::atomic<std::uint32_t> m_shedCount{0};
+
+  void findLatest(const StagingBuffer &staging, int from) noexcept;
+
+public:
+  LoadShedder();
+  LoadShedder(const LoadShedder &) = delete;            ///< no copy constructor
+  LoadShedder &operator=(const LoadShedder &) = delete; ///< no copy assignment
+
+  /**
+   * Start a new cycle.
+   * @param capacity - the free space in the (empty) JACK buffer, as given by
+   * `jack_midi_max_event_size()`.
+   */
+  void beginCycle(int capacity) noexcept;
+
+  /**
+   * Decide whether an event shall be written.
+   * @param staging - the sorted staging buffer of this cycle.
+   * @param position - the position of the event in the staging buffer.
+   * @param freeSpace - the space left in the JACK buffer, as given by
+   * `jack_midi_max_event_size()`.
+   * @return true if the event shall be written, false if it shall be skipped.
+   */
+  bool admit(const StagingBuffer &staging, int position, int freeSpace) noexcept;
+
+  /**
+   * @return the number of continuous messages skipped in favour of a newer value.
+   */
+  std::uint32_t coalescedCount() const noexcept { return m_coalescedCount; }
+  /**
+   * @return the number of normal messages skipped to keep the reserve.
+   */
+  std::uint32_t shedCount() const noexcept { return m_shedCount; }
+
+  /**
+   * Reset the counters. Shall not be called while the process thread is active.
+   */
+  void reset() noexcept;
+};
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_LOAD_SHEDDER_H
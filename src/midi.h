@@ -19,11 +19,75 @@
 #ifndef A_J_MIDI_SRC_MIDI_H
 #define A_J_MIDI_SRC_MIDI_H
 
-#include <vector>
+#include <cstring>
 
 namespace midi {
 
-using Event = std::vector<unsigned char>;
+/**
+ * The longest SysEx message that is bridged (in bytes, including 0xF0 and 0xF7).
+ */
+constexpr int MAX_SYSEX_SIZE = 128 * 1024;
+
+/**
+ * A single MIDI message.
+ *
+ * Channel messages and system messages (at most three bytes) are stored inline, so
+ * creating, copying and passing an `Event` never allocates memory. This makes the type
+ * safe to use on the JACK real-time thread.
+ *
+ * Longer messages (SysEx) take the out-of-line path: the event only refers to
+ * the bytes owned by the producer. Such an event is valid as long as the
+ * producer keeps those bytes alive (for `alsaClient::retrieve` this is the duration
+ * of the callback).
+ */
+class Event {
+public:
+  /**
+   * The number of bytes that are stored inside the event itself.
+   */
+  static constexpr int INLINE_CAPACITY = 3;
+
+private:
+  const unsigned char *m_external{nullptr}; ///< the SysEx bytes, nullptr for inline events.
+  int m_size{0};
+  unsigned char m_inline[INLINE_CAPACITY]{};
+
+public:
+  Event() = default;
+
+  /**
+   * Create an event from raw MIDI bytes.
+   * @param midiData - the MIDI bytes, beginning with the status byte.
+   * @param size - the number of bytes. Events of up to `INLINE_CAPACITY` bytes are
+   * copied, longer events refer to `midiData`.
+   */
+  Event(const unsigned char *midiData, int size) noexcept : m_size{size} {
+    if (size <= INLINE_CAPACITY) {
+      std::memcpy(m_inline, midiData, size);
+    } else {
+      m_external = midiData;
+    }
+  }
+
+  /**
+   * @return the MIDI bytes of this event.
+   */
+  const unsigned char *data() const noexcept { return m_external ? m_external : m_inline; }
+
+  /**
+   * @return the number of MIDI bytes.
+   */
+  int size() const noexcept { return m_size; }
+
+  /**
+   * @return true if the bytes are held outside of this event (SysEx).
+   */
+  bool isExternal() const noexcept { return m_external != nullptr; }
+
+  const unsigned char &operator[](int index) const noexcept { return data()[index]; }
+  const unsigned char *begin() const noexcept { return data(); }
+  const unsigned char *end() const noexcept { return data() + m_size; }
+};
 
 } // namespace midi
 
@@ -0,0 +1,142 @@
+/*
+ * File: midi_priority.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_MIDI_PRIORITY_H
+#define A_J_MIDI_SRC_MIDI_PRIORITY_H
+
+namespace midi {
+
+/**
+ * How important it is that a MIDI message reaches the receiver.
+ */
+enum class Priority : int {
+  /**
+   * Must always get through: note-on and note-off, program change, system real-time,
+   * the channel mode messages (all notes off ...), the pedals that hold notes and the
+   * (N)RPN controllers. Losing one of these leaves notes hanging, the transport out of step
+   * or a data entry applied to the wrong parameter.
+   */
+  essential,
+  /**
+   * Other discrete messages (SysEx, system common, switch-like controllers ...).
+   */
+  normal,
+  /**
+   * Continuous controllers, pitch bend and aftertouch. Each value supersedes the previous
+   * one with the same key (see `continuousKey()`), so thinning them out does little harm.
+   */
+  continuous,
+};
+
+/**
+ * The number of distinct keys returned by `continuousKey()`.
+ */
+constexpr int CONTINUOUS_KEY_COUNT = 16 * 128 + 16 + 16 + 16 * 128;
+
+/**
+ * A controller number is continuous unless it is one of the switches or mode messages
+ * that must not be thinned out. The (N)RPN controllers are not continuous either: a data
+ * entry value belongs to the parameter selected just before it, two values for different
+ * parameters must not be merged.
+ */
+constexpr bool isContinuousController(int controller) {
+  switch (controller) {
+  case 0:   // bank select
+  case 6:   // data entry
+  case 32:  // bank select (LSB)
+  case 38:  // data entry (LSB)
+  case 64:  // sustain
+  case 66:  // sostenuto
+  case 67:  // soft pedal
+  case 96:  // data increment
+  case 97:  // data decrement
+  case 98:  // NRPN (LSB)
+  case 99:  // NRPN (MSB)
+  case 100: // RPN (LSB)
+  case 101: // RPN (MSB)
+    return false;
+  default:
+    return controller < 120; // 120...127 are channel mode messages
+  }
+}
+
+/**
+ * Classify a MIDI message.
+ * @param data - the MIDI bytes (starting with the status byte).
+ * @param size - the number of bytes.
+ * @return the priority of the message.
+ */
+constexpr Priority classify(const unsigned char *data, int size) {
+  if (size < 1) {
+    return Priority::normal;
+  }
+  const unsigned char status = data[0];
+  switch (status & 0xF0U) {
+  case 0x80: // note-off
+  case 0x90: // note-on
+  case 0xC0: // program change
+    return Priority::essential;
+  case 0xA0: // polyphonic aftertouch
+  case 0xD0: // channel pressure
+  case 0xE0: // pitch bend
+    return (size < 2) ? Priority::normal : Priority::continuous;
+  case 0xB0: // control change
+    if (size < 2) {
+      return Priority::normal;
+    }
+    if (isContinuousController(data[1])) {
+      return Priority::continuous;
+    }
+    return (data[1] == 0 || data[1] == 32) ? Priority::normal : Priority::essential;
+  case 0xF0:
+    // system real-time (clock, start, stop ...) versus SysEx and system common.
+    return (status >= 0xF8) ? Priority::essential : Priority::normal;
+  default:
+    return Priority::normal; // running status or garbage
+  }
+}
+
+/**
+ * The key of a continuous message: two messages with the same key address the same
+ * parameter, the later value supersedes the earlier one.
+ * @param data - the MIDI bytes of a message classified as `Priority::continuous`.
+ * @param size - the number of bytes.
+ * @return a value between 0 and `CONTINUOUS_KEY_COUNT - 1`, or -1 if the message is not
+ * continuous.
+ */
+constexpr int continuousKey(const unsigned char *data, int size) {
+  if (classify(data, size) != Priority::continuous || size < 2) {
+    return -1;
+  }
+  const int channel = data[0] & 0x0FU;
+  switch (data[0] & 0xF0U) {
+  case 0xB0:
+    return channel * 128 + data[1];
+  case 0xE0:
+    return 16 * 128 + channel;
+  case 0xD0:
+    return 16 * 128 + 16 + channel;
+  case 0xA0:
+    return 16 * 128 + 32 + channel * 128 + data[1];
+  default:
+    return -1;
+  }
+}
+
+} // namespace midi
+#endif // A_J_MIDI_SRC_MIDI_PRIORITY_H
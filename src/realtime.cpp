@@ -0,0 +1,172 @@
+/*
+ * File: realtime.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "realtime.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace a2jmidi {
+
+/**
+ * The logger for this file.
+ */
+static auto g_logger = spdlog::stdout_color_mt("realtime");
+
+/**
+ * @return the size of a memory page.
+ */
+static std::size_t pageSize() {
+  long size = sysconf(_SC_PAGESIZE);
+  return (size > 0) ? static_cast<std::size_t>(size) : 4096;
+}
+
+bool applyThreadSettings(pthread_t thread, const ThreadSettings &settings,
+                         const std::string &threadName) noexcept {
+  bool success = true;
+  if (settings.policy == SCHED_FIFO || settings.policy == SCHED_RR) {
+    sched_param schParams{};
+    schParams.sched_priority = settings.priority;
+    int err = pthread_setschedparam(thread, settings.policy, &schParams);
+    if (err == EPERM) {
+      SPDLOG_LOGGER_ERROR(g_logger,
+                          "{} thread - no permission for real-time priority {}. Raise the rtprio "
+                          "limit (for example by joining the \"audio\" group).",
+                          threadName, settings.priority);
+      success = false;
+    } else if (err) {
+      SPDLOG_LOGGER_ERROR(g_logger, "{} thread - cannot set the scheduling: {}", threadName,
+                          std::strerror(err));
+      success = false;
+    }
+  }
+  if (settings.cpu >= 0) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(settings.cpu, &cpuSet);
+    int err = pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuSet);
+    if (err) {
+      SPDLOG_LOGGER_ERROR(g_logger, "{} thread - cannot pin to CPU {}: {}", threadName,
+                          settings.cpu, std::strerror(err));
+      success = false;
+    }
+  }
+  if (success) {
+    SPDLOG_LOGGER_TRACE(g_logger, "{} thread - policy {}, priority {}, CPU {}.", threadName,
+                        settings.policy, settings.priority, settings.cpu);
+  }
+  return success;
+}
+
+/**
+ * @return the stack size of a new thread (see `pthread_getattr_default_np`).
+ */
+static std::size_t defaultStackSize() {
+  constexpr std::size_t fallback = 8 * 1024 * 1024;
+  pthread_attr_t attributes;
+  if (pthread_getattr_default_np(&attributes) != 0) {
+    return fallback;
+  }
+  std::size_t size = fallback;
+  pthread_attr_getstacksize(&attributes, &size);
+  pthread_attr_destroy(&attributes);
+  return size;
+}
+
+/**
+ * @return the size of all current mappings of the process (`/proc/self/statm`).
+ */
+static std::size_t mappedSize() {
+  std::ifstream statm{"/proc/self/statm"};
+  std::size_t pages = 0;
+  statm >> pages;
+  return pages * pageSize();
+}
+
+std::size_t lockedFootprint(int futureThreads) noexcept {
+  try {
+    return mappedSize() + futureThreads * defaultStackSize() + HEAP_PREFAULT_SIZE;
+  } catch (...) {
+    return 0;
+  }
+}
+
+bool lockMemory(int futureThreads) noexcept {
+  rlimit limit{};
+  if (geteuid() != 0 && getrlimit(RLIMIT_MEMLOCK, &limit) == 0 &&
+      limit.rlim_cur != RLIM_INFINITY) {
+    const std::size_t footprint = lockedFootprint(futureThreads);
+    if (limit.rlim_cur < footprint) {
+      SPDLOG_LOGGER_WARN(g_logger,
+                         "memory not locked: the memlock limit ({} KiB) is below the expected "
+                         "footprint ({} KiB). Raise the memlock limit (for example by joining "
+                         "the \"audio\" group).",
+                         limit.rlim_cur / 1024, footprint / 1024);
+      return false;
+    }
+  }
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    int err = errno;
+    if (err == EPERM || err == ENOMEM) {
+      SPDLOG_LOGGER_ERROR(g_logger,
+                          "cannot lock memory: {}. Raise the memlock limit (for example by "
+                          "joining the \"audio\" group).",
+                          std::strerror(err));
+    } else {
+      SPDLOG_LOGGER_ERROR(g_logger, "cannot lock memory: {}", std::strerror(err));
+    }
+    return false;
+  }
+  SPDLOG_LOGGER_INFO(g_logger, "memory locked.");
+  return true;
+}
+
+void prefaultStack() noexcept {
+  volatile unsigned char stack[STACK_PREFAULT_SIZE];
+  const std::size_t step = pageSize();
+  for (std::size_t i = 0; i < STACK_PREFAULT_SIZE; i += step) {
+    stack[i] = 0;
+  }
+  (void)stack[0]; // silences -Wunused-but-set-variable.
+}
+
+bool prefaultHeap(std::size_t size) noexcept {
+  // keep freed memory in the process: no trimming, no separately mapped blocks.
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+  auto *block = static_cast<volatile unsigned char *>(std::malloc(size));
+  if (!block) {
+    SPDLOG_LOGGER_ERROR(g_logger, "cannot prefault {} bytes of heap.", size);
+    return false;
+  }
+  const std::size_t step = pageSize();
+  for (std::size_t i = 0; i < size; i += step) {
+    block[i] = 0;
+  }
+  std::free(const_cast<unsigned char *>(block));
+  return true;
+}
+
+} // namespace a2jmidi
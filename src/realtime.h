@@ -0,0 +1,113 @@
+/*
+ * File: realtime.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_REALTIME_H
+#define A_J_MIDI_SRC_REALTIME_H
+
+#include <cstddef>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+
+namespace a2jmidi {
+
+/**
+ * The scheduling and the placement of one of the bridge's own threads.
+ */
+struct ThreadSettings {
+  int policy{SCHED_OTHER}; ///< `SCHED_OTHER`, `SCHED_FIFO` or `SCHED_RR`.
+  int priority{0};         ///< the real-time priority (1 to 99) for `SCHED_FIFO` and `SCHED_RR`.
+  int cpu{-1};             ///< the CPU to pin the thread to, or -1 for any CPU.
+};
+
+/**
+ * The real-time priority of the listener thread, when a real-time policy is requested
+ * without a priority. It stays below the usual priority of JACK's process thread.
+ */
+constexpr int DEFAULT_LISTENER_PRIORITY = 60;
+
+/**
+ * How the threads of the ALSA side run, and whether the memory is locked.
+ */
+struct RealtimeSettings {
+  ThreadSettings listener{};               ///< the thread that receives the ALSA events.
+  ThreadSettings monitor{SCHED_RR, 1, -1}; ///< the thread that monitors the connections.
+  bool lockMemory{false}; ///< lock all memory and prefault the heap at activation.
+};
+
+/**
+ * The number of stack bytes that a thread touches in `prefaultStack()`.
+ */
+constexpr std::size_t STACK_PREFAULT_SIZE = 256 * 1024;
+/**
+ * The number of heap bytes that are touched in `prefaultHeap()`.
+ */
+constexpr std::size_t HEAP_PREFAULT_SIZE = 8 * 1024 * 1024;
+
+/**
+ * Set the scheduling policy, the priority and the CPU affinity of a thread.
+ *
+ * Failures are logged with a hint on how to obtain the missing privileges; the thread then
+ * keeps running with its previous settings.
+ * @param thread - the thread to be modified.
+ * @param settings - the new settings. The policy is only changed for `SCHED_FIFO` and
+ * `SCHED_RR`, the affinity only if a CPU is given.
+ * @param threadName - the name of the thread, for the log.
+ * @return true if all settings were applied.
+ */
+bool applyThreadSettings(pthread_t thread, const ThreadSettings &settings,
+                         const std::string &threadName) noexcept;
+
+/**
+ * The number of bytes that stay locked after `lockMemory()`: the current mappings of the
+ * process, the stacks of the threads started later and the prefaulted heap.
+ * @param futureThreads - the number of threads that will be started after locking.
+ * @return the expected footprint in bytes.
+ */
+std::size_t lockedFootprint(int futureThreads) noexcept;
+
+/**
+ * Lock all current and future pages of the process into RAM (`mlockall`), so that the
+ * real-time threads never wait for a page to be swapped in.
+ *
+ * Future pages include the stacks of threads started later (8 MiB each by default); once
+ * they exceed the memlock limit, starting a thread fails. The memory is therefore only
+ * locked if the limit (`RLIMIT_MEMLOCK`) covers `lockedFootprint(futureThreads)`.
+ * Missing privileges are logged with a hint.
+ * @param futureThreads - the number of threads that will be started after locking.
+ * @return true if the memory is locked.
+ */
+bool lockMemory(int futureThreads) noexcept;
+
+/**
+ * Touch `STACK_PREFAULT_SIZE` bytes of the calling thread's stack, so that later
+ * calls do not take page faults on the stack.
+ */
+void prefaultStack() noexcept;
+
+/**
+ * Touch a heap block of the given size and give it back to the allocator, which is told
+ * to keep the memory. Later allocations then find pages that are already mapped (and locked,
+ * after `lockMemory()`).
+ * @param size - the number of bytes to prefault.
+ * @return true on success, false if the block could not be allocated.
+ */
+bool prefaultHeap(std::size_t size) noexcept;
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_REALTIME_H
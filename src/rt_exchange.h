@@ -0,0 +1,125 @@
+/*
+ * File: rt_exchange.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_RT_EXCHANGE_H
+#define A_J_MIDI_SRC_RT_EXCHANGE_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace a2jmidi {
+
+/**
+ * Hands a pre-allocated object from a non real-time thread over to the real-time thread.
+ *
+ * When a structure used on the real-time thread must be re-sized (for example because the
+ * JACK buffer size has changed), a non real-time thread allocates the replacement and
+ * `publish()`es it. The real-time thread picks it up in its next call to `acquire()`; the
+ * object that has been replaced is not deleted by the real-time thread, it is handed back
+ * and deleted by the next call to `reclaim()` (or `publish()`) on the non real-time side.
+ *
+ * Thus, the real-time thread never allocates or frees memory and never waits.
+ *
+ * Exactly one thread shall call `acquire()`. `publish()` and `reclaim()` may be called
+ * from other threads, also concurrently with each other (in a2jmidi, the JACK buffer-size
+ * callback publishes and the main loop reclaims): both take objects out of the exchange
+ * with an atomic exchange, so each object is deleted by exactly one of them.
+ *
+ * @tparam T - the type of the exchanged objects.
+ */
+template <typename T> class RtExchange {
+private:
+  std::unique_ptr<T> m_current{}; ///< only used by the real-time thread.
+  std::atomic<T *> m_pending{nullptr}; ///< published, but not yet acquired.
+  std::atomic<T *> m_retired{nullptr}; ///< replaced, but not yet reclaimed.
+
+public:
+  RtExchange() = default;
+  RtExchange(const RtExchange &) = delete;            ///< no copy constructor
+  RtExchange &operator=(const RtExchange &) = delete; ///< no copy assignment
+  ~RtExchange() {
+    delete m_pending.exchange(nullptr);
+    delete m_retired.exchange(nullptr);
+  }
+
+  /**
+   * Install the initial object and discard all others.
+   *
+   * This function is __not__ thread safe. It shall only be called while the real-time
+   * thread is not active.
+   * @param initial - the object that `acquire()` shall return from now on.
+   */
+  void reset(std::unique_ptr<T> initial) {
+    delete m_pending.exchange(nullptr);
+    delete m_retired.exchange(nullptr);
+    m_current = std::move(initial);
+  }
+
+  /**
+   * Non real-time side: offer a new object to the real-time thread.
+   *
+   * An object that has been published earlier, but has not yet been acquired, is deleted.
+   * @param next - the replacement.
+   */
+  void publish(std::unique_ptr<T> next) {
+    reclaim();
+    // the real-time thread takes a pending object with an atomic exchange; if we get
+    // the old one back here, it has never been seen by the real-time thread.
+    delete m_pending.exchange(next.release(), std::memory_order_acq_rel);
+  }
+
+  /**
+   * Non real-time side: delete the object that has been replaced by the real-time thread.
+   * @return true if an object has been deleted.
+   */
+  bool reclaim() {
+    T *retired = m_retired.exchange(nullptr, std::memory_order_acq_rel);
+    delete retired;
+    return retired != nullptr;
+  }
+
+  /**
+   * Real-time side: the object to be used in the current cycle.
+   *
+   * If a new object has been published, it replaces the current one, unless the object
+   * replaced last time has not yet been reclaimed (then the exchange is tried again on
+   * the next call).
+   * @return the current object (nullptr if there is none).
+   */
+  T *acquire() noexcept {
+    if (m_retired.load(std::memory_order_acquire) == nullptr) {
+      T *next = m_pending.exchange(nullptr, std::memory_order_acq_rel);
+      if (next) {
+        m_retired.store(m_current.release(), std::memory_order_release);
+        m_current.reset(next);
+      }
+    }
+    return m_current.get();
+  }
+
+  /**
+   * @return true if a published object is waiting to be acquired.
+   */
+  bool hasPending() const noexcept {
+    return m_pending.load(std::memory_order_acquire) != nullptr;
+  }
+};
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_RT_EXCHANGE_H
@@ -0,0 +1,79 @@
+/*
+ * File: spill_buffer.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "spill_buffer.h"
+
+namespace a2jmidi {
+
+SpillBuffer::SpillBuffer(int eventCapacity, int byteCapacity)
+    : m_events{1, eventCapacity, byteCapacity} {}
+
+void SpillBuffer::keep(const StagingBuffer &staging, int first) noexcept {
+  const int unwritten = staging.size() - first;
+  if (unwritten <= 0) {
+    return;
+  }
+  const OverflowPolicy policy = m_policy.load(std::memory_order_relaxed);
+  if (policy == OverflowPolicy::dropNewest) {
+    m_lostCount.fetch_add(unwritten, std::memory_order_relaxed);
+    return;
+  }
+  int start = first;
+  if (policy == OverflowPolicy::dropOldest) {
+    // skip as many of the oldest events as needed for the newest ones to fit.
+    int bytes = 0;
+    for (int i = first; i < staging.size(); i++) {
+      bytes += staging.sizeAt(i);
+    }
+    while (start < staging.size() &&
+           (staging.size() - start > m_events.eventSpace() || bytes > m_events.byteSpace())) {
+      bytes -= staging.sizeAt(start);
+      start++;
+    }
+    m_lostCount.fetch_add(start - first, std::memory_order_relaxed);
+  }
+  staging.forEach(
+      [this]([[maybe_unused]] int frame, const unsigned char *data, int size) {
+        if (m_events.add(0, data, size)) {
+          m_deferredCount.fetch_add(1, std::memory_order_relaxed);
+        } else {
+          m_lostCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        return 0;
+      },
+      start);
+}
+
+void SpillBuffer::release(StagingBuffer &staging) noexcept {
+  m_events.forEach(
+      [this, &staging]([[maybe_unused]] int frame, const unsigned char *data, int size) {
+        if (!staging.add(0, data, size)) {
+          m_lostCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        return 0;
+      });
+  m_events.clear();
+}
+
+void SpillBuffer::reset() noexcept {
+  m_events.clear();
+  m_deferredCount = 0;
+  m_lostCount = 0;
+}
+
+} // namespace a2jmidi
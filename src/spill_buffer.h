@@ -0,0 +1,128 @@
+/*
+ * File: spill_buffer.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_SPILL_BUFFER_H
+#define A_J_MIDI_SRC_SPILL_BUFFER_H
+
+#include "staging_buffer.h"
+#include <atomic>
+#include <cstdint>
+
+namespace a2jmidi {
+
+/**
+ * What happens with the events that did not fit into the JACK buffer of a cycle.
+ */
+enum class OverflowPolicy : int {
+  /**
+   * The events are carried over to the next cycle. When the spill buffer is full,
+   * the newest events are lost.
+   */
+  spill,
+  /**
+   * The events are lost (nothing is carried over).
+   */
+  dropNewest,
+  /**
+   * The events are carried over to the next cycle. When the spill buffer is full, the
+   * oldest events are lost, so that the most recent state reaches the receiver.
+   */
+  dropOldest,
+};
+
+/**
+ * A bounded store for the events that did not fit into the JACK buffer.
+ *
+ * At the end of a cycle, the events that could not be written are `keep()`t; at the start
+ * of the next cycle, they are `release()`d into the staging buffer ahead of all new events
+ * (at frame zero, in their original order).
+ *
+ * `keep()` and `release()` shall only be called from the process thread; they never
+ * allocate. The counters can be read from any thread.
+ */
+class SpillBuffer {
+public:
+  /**
+   * The default maximum number of events carried over.
+   */
+  static constexpr int DEFAULT_EVENT_CAPACITY = 1024;
+  /**
+   * The default maximum number of MIDI bytes carried over.
+   */
+  static constexpr int DEFAULT_BYTE_CAPACITY = 16384;
+
+private:
+  StagingBuffer m_events;
+  std::atomic<OverflowPolicy> m_policy{OverflowPolicy::spill};
+  std::atomic<std::uint32_t> m_deferredCount{0};
+  std::atomic<std::uint32_t> m_lostCount{0};
+
+public:
+  /**
+   * @param eventCapacity - the maximum number of events carried over.
+   * @param byteCapacity - the maximum number of MIDI bytes carried over.
+   */
+  explicit SpillBuffer(int eventCapacity = DEFAULT_EVENT_CAPACITY,
+                       int byteCapacity = DEFAULT_BYTE_CAPACITY);
+
+  /**
+   * Choose what shall happen with the events that do not fit.
+   * @param policy - the new policy.
+   */
+  void setPolicy(OverflowPolicy policy) noexcept { m_policy = policy; }
+  /**
+   * @return the current policy.
+   */
+  OverflowPolicy policy() const noexcept { return m_policy; }
+
+  /**
+   * Keep the events of the staging buffer that could not be written, according to the policy.
+   * @param staging - the (sorted) staging buffer of the ending cycle.
+   * @param first - the position of the first event that could not be written.
+   */
+  void keep(const StagingBuffer &staging, int first) noexcept;
+
+  /**
+   * Hand the kept events over to the staging buffer of the new cycle (at frame zero).
+   * Shall be called before any new event is added to the staging buffer.
+   * @param staging - the (empty) staging buffer of the new cycle.
+   */
+  void release(StagingBuffer &staging) noexcept;
+
+  /**
+   * @return the number of events currently kept.
+   */
+  int size() const noexcept { return m_events.size(); }
+  /**
+   * @return the number of times an event has been carried over to a later cycle.
+   */
+  std::uint32_t deferredCount() const noexcept { return m_deferredCount; }
+  /**
+   * @return the number of events lost because they did not fit.
+   */
+  std::uint32_t lostCount() const noexcept { return m_lostCount; }
+
+  /**
+   * Remove all kept events and reset the counters.
+   * Shall not be called while the process thread is active.
+   */
+  void reset() noexcept;
+};
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_SPILL_BUFFER_H
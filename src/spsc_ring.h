@@ -0,0 +1,166 @@
+/*
+ * File: spsc_ring.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_SPSC_RING_H
+#define A_J_MIDI_SRC_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace a2jmidi {
+
+/**
+ * A bounded, lock-free ring buffer for exactly one producer thread and
+ * exactly one consumer thread.
+ *
+ * The slots are allocated once (by `reset()`) and are then reused; neither
+ * `push` nor `pop` allocate memory, take a lock or make a system call.
+ *
+ * The producer may either `push()` a value, or it may fill the slot returned by `back()`
+ * in place and then `publish()` it. Likewise, the consumer may inspect the oldest slot
+ * through `front()` and release it with `pop()`.
+ *
+ * @tparam T - the type of the elements. It must be default constructible.
+ */
+template <typename T> class SpscRing {
+private:
+  static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+  std::unique_ptr<T[]> m_slots{};
+  std::size_t m_mask{0}; ///< the capacity minus one (the capacity is a power of two).
+
+  alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_head{0}; ///< next slot to be consumed.
+  alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_tail{0}; ///< next slot to be produced.
+
+  static std::size_t roundUpToPowerOfTwo(std::size_t value) {
+    std::size_t result = 1;
+    while (result < value) {
+      result = result << 1U;
+    }
+    return result;
+  }
+
+public:
+  SpscRing() = default;
+  SpscRing(const SpscRing &) = delete;            ///< no copy constructor
+  SpscRing &operator=(const SpscRing &) = delete; ///< no copy assignment
+
+  /**
+   * (Re-)allocate the ring and discard all elements.
+   *
+   * This function is __not__ thread safe. It shall only be called while neither the
+   * producer nor the consumer are active.
+   * @param capacity - the minimal number of elements the ring shall hold. The effective
+   * capacity is rounded up to the next power of two.
+   */
+  void reset(std::size_t capacity) {
+    if (capacity == 0) {
+      throw std::invalid_argument("SpscRing capacity must be positive.");
+    }
+    std::size_t effectiveCapacity = roundUpToPowerOfTwo(capacity);
+    m_slots = std::make_unique<T[]>(effectiveCapacity);
+    m_mask = effectiveCapacity - 1;
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * @return the number of elements the ring can hold.
+   */
+  std::size_t capacity() const { return m_slots ? m_mask + 1 : 0; }
+
+  /**
+   * An estimate of the number of elements currently in the ring.
+   * The value is exact when called from the producer or the consumer thread
+   * while the other side is idle.
+   * @return the number of elements currently in the ring.
+   */
+  std::size_t size() const {
+    return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @return true if there is no element in the ring.
+   */
+  bool empty() const { return size() == 0; }
+
+  /**
+   * Producer side: the slot that will be published next.
+   * @return a pointer to a free slot, or nullptr if the ring is full (or not allocated).
+   */
+  T *back() {
+    if (!m_slots) {
+      return nullptr;
+    }
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+      return nullptr; // full
+    }
+    return &m_slots[tail & m_mask];
+  }
+
+  /**
+   * Producer side: make the slot returned by `back()` visible to the consumer.
+   */
+  void publish() {
+    m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /**
+   * Producer side: move the given value into the ring.
+   * @param value - the value to be enqueued.
+   * @return true on success, false if the ring was full.
+   */
+  bool push(T &&value) {
+    T *slot = back();
+    if (!slot) {
+      return false;
+    }
+    *slot = std::move(value);
+    publish();
+    return true;
+  }
+
+  /**
+   * Consumer side: the oldest element in the ring.
+   * @return a pointer to the oldest element, or nullptr if the ring is empty.
+   */
+  T *front() {
+    if (!m_slots) {
+      return nullptr;
+    }
+    const std::size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return nullptr; // empty
+    }
+    return &m_slots[head & m_mask];
+  }
+
+  /**
+   * Consumer side: give the slot returned by `front()` back to the producer.
+   */
+  void pop() {
+    m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+};
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_SPSC_RING_H
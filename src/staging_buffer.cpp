@@ -0,0 +1,111 @@
+/*
+ * File: staging_buffer.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "staging_buffer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace a2jmidi {
+
+StagingBuffer::StagingBuffer(int nFrames, int eventCapacity, int byteCapacity)
+    : m_nFrames{nFrames}, m_eventCapacity{eventCapacity}, m_byteCapacity{byteCapacity},
+      m_entries{std::make_unique<Entry[]>(eventCapacity)},
+      m_order{std::make_unique<int[]>(eventCapacity)},
+      m_scratch{std::make_unique<int[]>(eventCapacity)},
+      m_counts{std::make_unique<int[]>(nFrames + 1)},
+      m_bytes{std::make_unique<unsigned char[]>(byteCapacity)} {}
+
+int StagingBuffer::clampFrame(int frame) const noexcept {
+  return std::clamp(frame, 0, m_nFrames - 1);
+}
+
+bool StagingBuffer::add(int frame, const unsigned char *data, int size) noexcept {
+  if (m_eventCount >= m_eventCapacity || m_byteCount + size > m_byteCapacity) {
+    return false;
+  }
+  frame = clampFrame(frame);
+  if (m_eventCount > 0 && frame < m_entries[m_eventCount - 1].frame) {
+    m_sorted = false;
+  }
+  std::memcpy(&m_bytes[m_byteCount], data, size);
+  m_entries[m_eventCount] = Entry{frame, size, m_byteCount};
+  m_order[m_eventCount] = m_eventCount;
+  m_eventCount++;
+  m_byteCount += size;
+  return true;
+}
+
+void StagingBuffer::replace(int index, int frame, const unsigned char *data) noexcept {
+  Entry &entry = m_entries[index];
+  frame = clampFrame(frame);
+  std::memcpy(&m_bytes[entry.offset], data, entry.size);
+  entry.frame = frame;
+  if ((index > 0 && frame < m_entries[index - 1].frame) ||
+      (index + 1 < m_eventCount && frame > m_entries[index + 1].frame)) {
+    m_sorted = false;
+  }
+}
+
+void StagingBuffer::insertionSort() noexcept {
+  for (int i = 1; i < m_eventCount; i++) {
+    const int index = m_order[i];
+    const int frame = m_entries[index].frame;
+    int j = i;
+    // strictly greater: equal frames keep their order.
+    for (; j > 0 && m_entries[m_order[j - 1]].frame > frame; j--) {
+      m_order[j] = m_order[j - 1];
+    }
+    m_order[j] = index;
+  }
+}
+
+void StagingBuffer::countingSort() noexcept {
+  std::memset(m_counts.get(), 0, sizeof(int) * (m_nFrames + 1));
+  for (int i = 0; i < m_eventCount; i++) {
+    m_counts[m_entries[i].frame + 1]++;
+  }
+  for (int frame = 0; frame < m_nFrames; frame++) {
+    m_counts[frame + 1] += m_counts[frame];
+  }
+  // the entries are visited in the order they were added, which makes the sort stable.
+  for (int i = 0; i < m_eventCount; i++) {
+    m_scratch[m_counts[m_entries[i].frame]++] = i;
+  }
+  m_order.swap(m_scratch);
+}
+
+void StagingBuffer::sort() noexcept {
+  if (m_sorted) {
+    return; // the common case: the events came in order.
+  }
+  // all frames lie in [0, nFrames), so the counting sort applies to any large cycle.
+  if (m_eventCount <= INSERTION_SORT_LIMIT) {
+    insertionSort();
+  } else {
+    countingSort();
+  }
+  m_sorted = true;
+}
+
+void StagingBuffer::clear() noexcept {
+  m_eventCount = 0;
+  m_byteCount = 0;
+  m_sorted = true;
+}
+
+} // namespace a2jmidi
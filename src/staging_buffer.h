@@ -0,0 +1,176 @@
+/*
+ * File: staging_buffer.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_STAGING_BUFFER_H
+#define A_J_MIDI_SRC_STAGING_BUFFER_H
+
+#include <memory>
+
+namespace a2jmidi {
+
+/**
+ * Collects the events of one process cycle, so that they can be written into the JACK
+ * buffer in the order of their frame offsets (`jack_midi_event_write` refuses offsets
+ * that lie before the previously written one).
+ *
+ * The events are copied (frame, bytes) into pre-allocated storage by `add()`, ordered by
+ * `sort()` and handed over by `forEach()`. Events with equal frame offsets keep the order
+ * in which they were added.
+ *
+ * No function allocates memory except the constructor; the buffer is meant to be used on
+ * the real-time thread. When the number of frames per cycle changes, a new buffer must be
+ * allocated (see `RtExchange`).
+ */
+class StagingBuffer {
+public:
+  /**
+   * The default maximum number of events per cycle.
+   */
+  static constexpr int DEFAULT_EVENT_CAPACITY = 2048;
+  /**
+   * The default maximum number of MIDI bytes per cycle.
+   */
+  static constexpr int DEFAULT_BYTE_CAPACITY = 32768;
+  /**
+   * Up to this number of events, an insertion sort is used; beyond, a counting sort
+   * over the frame offsets.
+   */
+  static constexpr int INSERTION_SORT_LIMIT = 32;
+
+private:
+  struct Entry {
+    int frame;  ///< the offset in the JACK buffer.
+    int size;   ///< the number of bytes.
+    int offset; ///< the position of the bytes in the byte storage.
+  };
+
+  const int m_nFrames;
+  const int m_eventCapacity;
+  const int m_byteCapacity;
+  std::unique_ptr<Entry[]> m_entries;
+  std::unique_ptr<int[]> m_order;   ///< the indices of the entries, sorted by `sort()`.
+  std::unique_ptr<int[]> m_scratch; ///< a second index array for the counting sort.
+  std::unique_ptr<int[]> m_counts;  ///< one counter per frame (plus one) for the counting sort.
+  std::unique_ptr<unsigned char[]> m_bytes;
+  int m_eventCount{0};
+  int m_byteCount{0};
+  bool m_sorted{true}; ///< true while the entries have been added in order.
+
+  void insertionSort() noexcept;
+  void countingSort() noexcept;
+  int clampFrame(int frame) const noexcept;
+
+public:
+  /**
+   * @param nFrames - the number of frames per cycle.
+   * @param eventCapacity - the maximum number of events per cycle.
+   * @param byteCapacity - the maximum number of MIDI bytes per cycle.
+   */
+  explicit StagingBuffer(int nFrames, int eventCapacity = DEFAULT_EVENT_CAPACITY,
+                         int byteCapacity = DEFAULT_BYTE_CAPACITY);
+  StagingBuffer(const StagingBuffer &) = delete;            ///< no copy constructor
+  StagingBuffer &operator=(const StagingBuffer &) = delete; ///< no copy assignment
+
+  /**
+   * @return the number of frames per cycle this buffer has been allocated for.
+   */
+  int nFrames() const noexcept { return m_nFrames; }
+  /**
+   * @return the number of events collected in this cycle.
+   */
+  int size() const noexcept { return m_eventCount; }
+  /**
+   * @return true if no event has been collected.
+   */
+  bool empty() const noexcept { return m_eventCount == 0; }
+  /**
+   * @return the number of further events that can be added.
+   */
+  int eventSpace() const noexcept { return m_eventCapacity - m_eventCount; }
+  /**
+   * @return the number of further MIDI bytes that can be added.
+   */
+  int byteSpace() const noexcept { return m_byteCapacity - m_byteCount; }
+  /**
+   * @param position - the position of an event in the current order.
+   * @return the number of MIDI bytes of this event.
+   */
+  int sizeAt(int position) const noexcept { return m_entries[m_order[position]].size; }
+  /**
+   * @param position - the position of an event in the current order.
+   * @return the MIDI bytes of this event.
+   */
+  const unsigned char *dataAt(int position) const noexcept {
+    return &m_bytes[m_entries[m_order[position]].offset];
+  }
+
+  /**
+   * Copy an event into the buffer.
+   * @param frame - the offset in the JACK buffer (between 0 and `nFrames() - 1`; offsets
+   * outside this range are clamped to the nearest end).
+   * @param data - the MIDI bytes.
+   * @param size - the number of MIDI bytes.
+   * @return false if the event did not fit (too many events or too many bytes).
+   */
+  bool add(int frame, const unsigned char *data, int size) noexcept;
+
+  /**
+   * Overwrite an event that has been added in this cycle with a message of the same size.
+   * Shall not be called between `sort()` and `clear()`.
+   * @param index - the index of the event in the order of adding (that is, `size() - 1`
+   * right after the event has been added).
+   * @param frame - the new offset in the JACK buffer (clamped like in `add()`).
+   * @param data - the new MIDI bytes (as many as the event already has).
+   */
+  void replace(int index, int frame, const unsigned char *data) noexcept;
+
+  /**
+   * Order the collected events by frame offset; events with equal offsets keep the order
+   * in which they were added. Takes time linear in the number of events (beyond
+   * `INSERTION_SORT_LIMIT`).
+   */
+  void sort() noexcept;
+
+  /**
+   * Hand the collected events over in their current order.
+   *
+   * @tparam Function - a callable `int(int frame, const unsigned char *data, int size)`; it
+   * returns zero to continue and a non zero value to stop.
+   * @param function - the function to be called for each event.
+   * @param first - the position of the first event to be handed over.
+   * @return the position of the event for which the function has returned a non zero
+   * value, or `size()` if there was none.
+   */
+  template <typename Function> int forEach(Function &&function, int first = 0) const {
+    for (int i = first; i < m_eventCount; i++) {
+      const Entry &entry = m_entries[m_order[i]];
+      if (function(entry.frame, &m_bytes[entry.offset], entry.size) != 0) {
+        return i;
+      }
+    }
+    return m_eventCount;
+  }
+
+  /**
+   * Remove all events (to be called at the end of each cycle).
+   */
+  void clear() noexcept;
+};
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_STAGING_BUFFER_H
@@ -0,0 +1,88 @@
+/*
+ * File: sysex_arena.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "sysex_arena.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace a2jmidi {
+
+void SysexArena::reset(std::size_t capacity, std::size_t maxMessageSize) {
+  if (maxMessageSize == 0 || 2 * maxMessageSize > capacity) {
+    throw std::invalid_argument("SysexArena capacity must hold two of the longest messages.");
+  }
+  m_bytes = std::make_unique<unsigned char[]>(capacity);
+  m_capacity = capacity;
+  m_maxMessageSize = maxMessageSize;
+  m_open = false;
+  m_openStart = 0;
+  m_openSize = 0;
+  m_head.store(0, std::memory_order_relaxed);
+  m_tail.store(0, std::memory_order_relaxed);
+}
+
+void SysexArena::begin() noexcept {
+  m_open = true;
+  m_openStart = m_tail.load(std::memory_order_relaxed);
+  m_openSize = 0;
+}
+
+bool SysexArena::append(const unsigned char *data, std::size_t size) noexcept {
+  if (!m_open) {
+    return false;
+  }
+  const std::size_t needed = m_openSize + size;
+  if (needed > m_maxMessageSize) {
+    m_open = false;
+    return false;
+  }
+  std::size_t start = m_openStart;
+  const std::size_t offset = start % m_capacity;
+  const bool wrap = offset + needed > m_capacity;
+  if (wrap) {
+    // a message must be contiguous: continue at the beginning of the ring.
+    start += m_capacity - offset;
+  }
+  if (start + needed - m_head.load(std::memory_order_acquire) > m_capacity) {
+    m_open = false; // the consumer lags behind.
+    return false;
+  }
+  if (wrap) {
+    std::memmove(&m_bytes[0], &m_bytes[offset], m_openSize);
+    m_openStart = start;
+  }
+  std::memcpy(&m_bytes[start % m_capacity + m_openSize], data, size);
+  m_openSize = needed;
+  return true;
+}
+
+SysexArena::Message SysexArena::finish() noexcept {
+  if (!m_open) {
+    return Message{};
+  }
+  m_open = false;
+  const std::size_t end = m_openStart + m_openSize;
+  m_tail.store(end, std::memory_order_release);
+  return Message{&m_bytes[m_openStart % m_capacity], static_cast<int>(m_openSize), end};
+}
+
+void SysexArena::release(std::size_t end) noexcept {
+  m_head.store(end, std::memory_order_release);
+}
+
+} // namespace a2jmidi
@@ -0,0 +1,167 @@
+/*
+ * File: sysex_arena.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_SYSEX_ARENA_H
+#define A_J_MIDI_SRC_SYSEX_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace a2jmidi {
+
+/**
+ * A lock-free byte ring for long messages (SysEx), with exactly one producer and exactly
+ * one consumer thread.
+ *
+ * The producer reassembles a message from the chunks the ALSA sequencer delivers
+ * (`begin()`, `append()` ..., `finish()`); each message occupies one contiguous stretch of
+ * the ring. The consumer hands the messages back, in the order they were finished, with
+ * `release()`.
+ *
+ * The ring is allocated once (by `reset()`); no other function allocates memory, takes a
+ * lock or makes a system call.
+ */
+class SysexArena {
+public:
+  /**
+   * A finished message.
+   */
+  struct Message {
+    const unsigned char *data{nullptr}; ///< the bytes, nullptr if there was no message.
+    int size{0};                        ///< the number of bytes.
+    std::size_t end{0};                 ///< to be passed to `release()`.
+  };
+
+private:
+  static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+  std::unique_ptr<unsigned char[]> m_bytes{};
+  std::size_t m_capacity{0};
+  std::size_t m_maxMessageSize{0};
+
+  // the message under construction (producer only).
+  bool m_open{false};
+  std::size_t m_openStart{0}; ///< the (unbounded) position of the first byte.
+  std::size_t m_openSize{0};
+
+  alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_head{0}; ///< the oldest byte in use.
+  alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_tail{0}; ///< behind the newest message.
+
+public:
+  SysexArena() = default;
+  SysexArena(const SysexArena &) = delete;            ///< no copy constructor
+  SysexArena &operator=(const SysexArena &) = delete; ///< no copy assignment
+
+  /**
+   * (Re-)allocate the ring and forget all messages.
+   *
+   * This function is __not__ thread safe. It shall only be called while neither the
+   * producer nor the consumer are active.
+   * @param capacity - the number of bytes in the ring.
+   * @param maxMessageSize - longer messages are refused; at most half the capacity.
+   */
+  void reset(std::size_t capacity, std::size_t maxMessageSize);
+
+  /**
+   * @return the number of bytes in the ring.
+   */
+  std::size_t capacity() const noexcept { return m_capacity; }
+  /**
+   * @return the size of the longest message that can be stored.
+   */
+  std::size_t maxMessageSize() const noexcept { return m_maxMessageSize; }
+
+  /**
+   * Producer side: start a new message. An unfinished message is abandoned.
+   */
+  void begin() noexcept;
+
+  /**
+   * Producer side: add a chunk to the current message.
+   * @param data - the bytes of the chunk.
+   * @param size - the number of bytes.
+   * @return false if the message has been abandoned: either it became longer than
+   * `maxMessageSize()`, or the consumer has not released enough space.
+   */
+  bool append(const unsigned char *data, std::size_t size) noexcept;
+
+  /**
+   * Producer side: give up the current message.
+   */
+  void abandon() noexcept { m_open = false; }
+
+  /**
+   * @return true while a message is under construction.
+   */
+  bool isOpen() const noexcept { return m_open; }
+
+  /**
+   * Producer side: close the current message and make it available for the consumer.
+   * The message must be published to the consumer (for example through a `SpscRing`)
+   * after this call.
+   * @return the message, or an empty message if there was none.
+   */
+  Message finish() noexcept;
+
+  /**
+   * Consumer side: give the space of a message, and of all messages finished before it,
+   * back to the producer.
+   * @param end - the value `Message::end` of the message.
+   */
+  void release(std::size_t end) noexcept;
+};
+
+/**
+ * What to do with a SysEx message that does not fit into the space left in the JACK buffer.
+ */
+enum class SysexPolicy : int {
+  defer,  ///< carry it (and everything behind it) over to the next cycle.
+  reject, ///< drop it (counted), the events behind it are written.
+};
+
+/**
+ * The outcome of `sysexAction()`.
+ */
+enum class SysexAction : int {
+  write,  ///< there is enough space.
+  defer,  ///< leave it for the next cycle.
+  reject, ///< drop it.
+};
+
+/**
+ * Decide what happens to a message when it is about to be written.
+ * Messages larger than the empty JACK buffer can never be written and are always rejected.
+ * @param size - the number of bytes of the message.
+ * @param freeSpace - the space left in the JACK buffer (`jack_midi_max_event_size()`).
+ * @param capacity - the space in the empty JACK buffer.
+ * @param policy - what to do when the message does not fit into the space left.
+ * @return what to do with the message.
+ */
+constexpr SysexAction sysexAction(int size, int freeSpace, int capacity, SysexPolicy policy) {
+  if (size <= freeSpace) {
+    return SysexAction::write;
+  }
+  if (size > capacity || policy == SysexPolicy::reject) {
+    return SysexAction::reject;
+  }
+  return SysexAction::defer;
+}
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_SYSEX_ARENA_H
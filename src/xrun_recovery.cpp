@@ -0,0 +1,106 @@
+/*
+ * File: xrun_recovery.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "xrun_recovery.h"
+#include <algorithm>
+
+namespace a2jmidi {
+
+void XrunRecovery::resynchronize() noexcept {
+  m_started = false;
+  m_lastDeadline = 0;
+  m_recovering = false;
+  m_lastPosition = 0;
+}
+
+void XrunRecovery::reset() noexcept {
+  resynchronize();
+  m_xrunCount = 0;
+  m_flushedCount = 0;
+  m_compressedCount = 0;
+  m_spreadCount = 0;
+}
+
+TimePoint XrunRecovery::beginCycle(const CycleWindow &window, bool xrun) noexcept {
+  m_window = window;
+  m_lastPosition = 0;
+  // events older than this would be moved to the start of the buffer (or be discarded).
+  const TimePoint staleLimit = window.bufferStart - (window.tolerance - window.nFrames);
+
+  if (m_recovering && (m_activePolicy != XrunPolicy::spread || m_lastDeadline >= staleLimit)) {
+    m_recovering = false; // the backlog has been placed.
+  }
+  if (xrun && m_started && m_lastDeadline < staleLimit) {
+    m_xrunCount.fetch_add(1, std::memory_order_relaxed);
+    m_activePolicy = m_policy.load(std::memory_order_relaxed);
+    m_recovering = true;
+    m_backlogStart = m_lastDeadline;
+  }
+  if (m_recovering) {
+    m_staleLimit = staleLimit;
+    m_spreadStart = m_lastDeadline; // continue where the previous cycle stopped.
+  }
+
+  TimePoint deadline = window.deadline;
+  if (m_recovering && m_activePolicy == XrunPolicy::spread) {
+    // only retrieve what can be played at the increased speed, the rest stays queued.
+    deadline = std::min(window.deadline,
+                        m_spreadStart + static_cast<TimePoint>(SPREAD_SPEED) * window.nFrames);
+  }
+  m_started = true;
+  m_lastDeadline = deadline;
+  return deadline;
+}
+
+int XrunRecovery::place(TimePoint timeStamp) noexcept {
+  int position;
+  if (!m_recovering) {
+    return placeEvent(m_window, timeStamp);
+  }
+  switch (m_activePolicy) {
+  case XrunPolicy::flush:
+    if (timeStamp < m_staleLimit) {
+      m_flushedCount.fetch_add(1, std::memory_order_relaxed);
+      return DISCARD_EVENT;
+    }
+    position = placeEvent(m_window, timeStamp);
+    break;
+  case XrunPolicy::compress:
+    if (timeStamp < m_staleLimit) {
+      m_compressedCount.fetch_add(1, std::memory_order_relaxed);
+      const TimePoint span = std::max(TimePoint{1}, m_staleLimit - m_backlogStart);
+      const TimePoint age = std::max(TimePoint{0}, timeStamp - m_backlogStart);
+      const int frames = std::min(COMPRESS_FRAMES, m_window.nFrames);
+      position = static_cast<int>(std::min(age * frames / span, TimePoint{frames - 1}));
+    } else {
+      position = placeEvent(m_window, timeStamp);
+    }
+    break;
+  case XrunPolicy::spread:
+  default:
+    m_spreadCount.fetch_add(1, std::memory_order_relaxed);
+    position = static_cast<int>(std::clamp((timeStamp - m_spreadStart) / SPREAD_SPEED,
+                                           TimePoint{0}, TimePoint{m_window.nFrames - 1}));
+    break;
+  }
+  position = std::max(position, m_lastPosition);
+  m_lastPosition = position;
+  return position;
+}
+
+} // namespace a2jmidi
@@ -0,0 +1,188 @@
+/*
+ * File: xrun_recovery.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_XRUN_RECOVERY_H
+#define A_J_MIDI_SRC_XRUN_RECOVERY_H
+
+#include "a2jmidi_clock.h"
+#include "event_placement.h"
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Recovering from JACK xruns.
+ *
+ * When the JACK server skips one or several cycles, the events recorded during the
+ * skipped cycles (the _backlog_) lie before the window of the next cycle. Placed the
+ * normal way, they would all be piled up at frame zero of one buffer (each one reported
+ * as an underrun), possibly overflowing the buffer.
+ *
+ * The `XrunRecovery` decides, according to its policy, what happens with the backlog.
+ */
+namespace a2jmidi {
+
+/**
+ * What to do with the events that were recorded during the cycles skipped by an xrun.
+ */
+enum class XrunPolicy : int {
+  flush,    ///< discard the backlog.
+  compress, ///< squeeze the backlog into the first frames of the next buffer.
+  spread,   ///< play the backlog at an increased speed over the next cycles.
+};
+
+/**
+ * @param policy - an xrun policy.
+ * @return the name of the policy, as given on the command line.
+ */
+constexpr const char *policyName(XrunPolicy policy) noexcept {
+  switch (policy) {
+  case XrunPolicy::flush:
+    return "flush";
+  case XrunPolicy::compress:
+    return "compress";
+  case XrunPolicy::spread:
+    return "spread";
+  }
+  return "unknown";
+}
+
+/**
+ * The policies in a cycle, used to switch the policy at runtime (SIGUSR1).
+ * @param policy - an xrun policy.
+ * @return the policy after the given one (flush, compress, spread, flush...).
+ */
+constexpr XrunPolicy nextPolicy(XrunPolicy policy) noexcept {
+  switch (policy) {
+  case XrunPolicy::flush:
+    return XrunPolicy::compress;
+  case XrunPolicy::compress:
+    return XrunPolicy::spread;
+  case XrunPolicy::spread:
+    return XrunPolicy::flush;
+  }
+  return XrunPolicy::spread;
+}
+
+/**
+ * Keeps track of xruns and places the events of the backlog.
+ *
+ * The functions `beginCycle()` and `place()` shall only be called from the process
+ * thread; they take no lock and never allocate. The policy can be changed at any time
+ * from any thread, it takes effect with the next xrun.
+ */
+class XrunRecovery {
+public:
+  /**
+   * The number of frames at the start of a buffer that receive the backlog in
+   * `XrunPolicy::compress`.
+   */
+  static constexpr int COMPRESS_FRAMES = 32;
+  /**
+   * The speed at which the backlog is played in `XrunPolicy::spread`. With a speed of two,
+   * the lag behind the regular placement shrinks by one period per cycle.
+   */
+  static constexpr int SPREAD_SPEED = 2;
+
+private:
+  std::atomic<XrunPolicy> m_policy{XrunPolicy::spread};
+
+  // the state of the process thread
+  bool m_started{false};       ///< true once a cycle has been processed.
+  TimePoint m_lastDeadline{0}; ///< events before this point have been retrieved.
+  bool m_recovering{false};    ///< true as long as the backlog is being placed.
+  XrunPolicy m_activePolicy{XrunPolicy::spread}; ///< the policy of the ongoing recovery.
+  TimePoint m_backlogStart{0}; ///< the time stamp of the oldest event of the backlog.
+  TimePoint m_staleLimit{0};   ///< events before this point belong to the backlog.
+  TimePoint m_spreadStart{0};  ///< in spread mode: the time mapped onto frame zero.
+  CycleWindow m_window{};      ///< the regular window of the current cycle.
+  int m_lastPosition{0};       ///< positions must not decrease within a buffer.
+
+  std::atomic<std::uint32_t> m_xrunCount{0};
+  std::atomic<std::uint32_t> m_flushedCount{0};
+  std::atomic<std::uint32_t> m_compressedCount{0};
+  std::atomic<std::uint32_t> m_spreadCount{0};
+
+public:
+  /**
+   * Choose what shall be done after the next xrun.
+   * @param policy - the new policy.
+   */
+  void setPolicy(XrunPolicy policy) noexcept { m_policy = policy; }
+  /**
+   * @return the current policy.
+   */
+  XrunPolicy policy() const noexcept { return m_policy; }
+
+  /**
+   * Start a new process cycle.
+   *
+   * @param window - the regular window of this cycle (as given by the placement mode).
+   * @param xrun - true if an xrun has been reported since the previous cycle.
+   * @return the deadline to be used when retrieving the events of this cycle.
+   */
+  TimePoint beginCycle(const CycleWindow &window, bool xrun) noexcept;
+
+  /**
+   * The position of an event in the current buffer.
+   *
+   * Events of the backlog are handled according to the policy of the ongoing recovery,
+   * all others are placed by `placeEvent()`.
+   * @param timeStamp - the time when the event was recorded.
+   * @return the frame offset in the buffer, or `DISCARD_EVENT`.
+   */
+  int place(TimePoint timeStamp) noexcept;
+
+  /**
+   * @return true if the current cycle is placing the backlog of an xrun.
+   */
+  bool recovering() const noexcept { return m_recovering; }
+
+  /**
+   * @return the number of xruns that left a backlog.
+   */
+  std::uint32_t xrunCount() const noexcept { return m_xrunCount; }
+  /**
+   * @return the number of events discarded by `XrunPolicy::flush`.
+   */
+  std::uint32_t flushedCount() const noexcept { return m_flushedCount; }
+  /**
+   * @return the number of events squeezed into the start of a buffer by
+   * `XrunPolicy::compress`.
+   */
+  std::uint32_t compressedCount() const noexcept { return m_compressedCount; }
+  /**
+   * @return the number of events placed at increased speed by `XrunPolicy::spread`.
+   */
+  std::uint32_t spreadCount() const noexcept { return m_spreadCount; }
+
+  /**
+   * Forget the state of the process thread (but keep the counters), so that the next
+   * cycle is not related to the previous ones. To be used after a clock discontinuity.
+   * Shall only be called from the process thread.
+   */
+  void resynchronize() noexcept;
+
+  /**
+   * Forget the state of the process thread and the counters.
+   * Shall not be called while the process thread is active.
+   */
+  void reset() noexcept;
+};
+
+} // namespace a2jmidi
+#endif // A_J_MIDI_SRC_XRUN_RECOVERY_H
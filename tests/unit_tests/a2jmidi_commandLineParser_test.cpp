@@ -150,4 +150,366 @@ TEST_F(A2jmidiCommandLineParserTest, connectOption) {
   CommandLineInterpretation result3 = parseCommandLine(parmCount, avn);
   EXPECT_EQ(result3.connectTo, "");
 }
+/**
+ *  --kernel-timestamps Option
+ */
+TEST_F(A2jmidiCommandLineParserTest, kernelTimestampsOption) {
+  using namespace a2jmidi;
+  constexpr int parmCount = 1 + 1;
+
+  // the long version
+  const char *avl[parmCount] = {"./a2jmidi", "--kernel-timestamps"};
+  CommandLineInterpretation result1 = parseCommandLine(parmCount, avl);
+  EXPECT_TRUE(result1.kernelTimestamps);
+
+  // the short version
+  const char *avs[parmCount] = {"./a2jmidi", "-k"};
+  CommandLineInterpretation result2 = parseCommandLine(parmCount, avs);
+  EXPECT_TRUE(result2.kernelTimestamps);
+
+  // option not present
+  const char *avn[parmCount] = {"./a2jmidi", "deviceName"};
+  CommandLineInterpretation result3 = parseCommandLine(parmCount, avn);
+  EXPECT_FALSE(result3.kernelTimestamps);
+}
+/**
+ *  --jitter-percentile Option
+ */
+TEST_F(A2jmidiCommandLineParserTest, jitterPercentileOption) {
+  using namespace a2jmidi;
+  constexpr int parmCount = 1 + 2;
+
+  // the long version
+  const char *avl[parmCount] = {"./a2jmidi", "--jitter-percentile", "99.9"};
+  CommandLineInterpretation result1 = parseCommandLine(parmCount, avl);
+  EXPECT_DOUBLE_EQ(result1.jitterPercentile, 99.9);
+
+  // the short version
+  const char *avs[parmCount] = {"./a2jmidi", "-j", "50"};
+  CommandLineInterpretation result2 = parseCommandLine(parmCount, avs);
+  EXPECT_DOUBLE_EQ(result2.jitterPercentile, 50.0);
+
+  // out of range
+  const char *avr[parmCount] = {"./a2jmidi", "-j", "101"};
+  CommandLineInterpretation result3 = parseCommandLine(parmCount, avr);
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+
+  // option not present
+  const char *avn[parmCount] = {"./a2jmidi", "-c", "port"};
+  CommandLineInterpretation result4 = parseCommandLine(parmCount, avn);
+  EXPECT_DOUBLE_EQ(result4.jitterPercentile, jitter::DEFAULT_PERCENTILE);
+}
+/**
+ *  --low-latency Option
+ */
+TEST_F(A2jmidiCommandLineParserTest, lowLatencyOption) {
+  using namespace a2jmidi;
+  constexpr int parmCount = 1 + 1;
+
+  // the long version
+  const char *avl[parmCount] = {"./a2jmidi", "--low-latency"};
+  CommandLineInterpretation result1 = parseCommandLine(parmCount, avl);
+  EXPECT_EQ(result1.placement, Placement::currentCycle);
+
+  // the short version
+  const char *avs[parmCount] = {"./a2jmidi", "-l"};
+  CommandLineInterpretation result2 = parseCommandLine(parmCount, avs);
+  EXPECT_EQ(result2.placement, Placement::currentCycle);
+
+  // option not present
+  const char *avn[parmCount] = {"./a2jmidi", "deviceName"};
+  CommandLineInterpretation result3 = parseCommandLine(parmCount, avn);
+  EXPECT_EQ(result3.placement, Placement::previousCycle);
+}
+/**
+ *  --fixed-delay Option
+ */
+TEST_F(A2jmidiCommandLineParserTest, fixedDelayOption) {
+  using namespace a2jmidi;
+  constexpr int parmCount = 1 + 2;
+
+  // the long version
+  const char *avl[parmCount] = {"./a2jmidi", "--fixed-delay", "512"};
+  CommandLineInterpretation result1 = parseCommandLine(parmCount, avl);
+  EXPECT_EQ(result1.placement, Placement::constantLatency);
+  EXPECT_EQ(result1.fixedDelay, 512);
+
+  // the short version
+  const char *avs[parmCount] = {"./a2jmidi", "-f", "300"};
+  CommandLineInterpretation result2 = parseCommandLine(parmCount, avs);
+  EXPECT_EQ(result2.placement, Placement::constantLatency);
+  EXPECT_EQ(result2.fixedDelay, 300);
+
+  // negative delays are refused
+  const char *avn[parmCount] = {"./a2jmidi", "-f", "-1"};
+  CommandLineInterpretation result3 = parseCommandLine(parmCount, avn);
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+
+  // cannot be combined with low latency
+  const char *avc[1 + 3] = {"./a2jmidi", "-l", "-f", "300"};
+  CommandLineInterpretation result4 = parseCommandLine(1 + 3, avc);
+  EXPECT_EQ(result4.action, CommandLineAction::messageError);
+}
+/**
+ * The xrun recovery policy can be chosen on the command line.
+ */
+TEST_F(A2jmidiCommandLineParserTest, xrunRecoveryOption) {
+  using namespace a2jmidi;
+  constexpr int parmCount = 1 + 2;
+
+  // the default
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result0 = parseCommandLine(1, avd);
+  EXPECT_EQ(result0.xrunPolicy, XrunPolicy::spread);
+
+  // the long version
+  const char *avl[parmCount] = {"./a2jmidi", "--xrun-recovery", "flush"};
+  CommandLineInterpretation result1 = parseCommandLine(parmCount, avl);
+  EXPECT_EQ(result1.xrunPolicy, XrunPolicy::flush);
+
+  // the short version
+  const char *avs[parmCount] = {"./a2jmidi", "-x", "compress"};
+  CommandLineInterpretation result2 = parseCommandLine(parmCount, avs);
+  EXPECT_EQ(result2.xrunPolicy, XrunPolicy::compress);
+
+  // unknown policies are refused
+  const char *avu[parmCount] = {"./a2jmidi", "-x", "ignore"};
+  CommandLineInterpretation result3 = parseCommandLine(parmCount, avu);
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+}
+/**
+ * The overflow policy can be chosen on the command line.
+ */
+TEST_F(A2jmidiCommandLineParserTest, overflowOption) {
+  using namespace a2jmidi;
+  constexpr int parmCount = 1 + 2;
+
+  // the default
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result0 = parseCommandLine(1, avd);
+  EXPECT_EQ(result0.overflowPolicy, OverflowPolicy::spill);
+
+  // the long version
+  const char *avl[parmCount] = {"./a2jmidi", "--overflow", "drop-newest"};
+  CommandLineInterpretation result1 = parseCommandLine(parmCount, avl);
+  EXPECT_EQ(result1.overflowPolicy, OverflowPolicy::dropNewest);
+
+  // the short version
+  const char *avs[parmCount] = {"./a2jmidi", "-o", "drop-oldest"};
+  CommandLineInterpretation result2 = parseCommandLine(parmCount, avs);
+  EXPECT_EQ(result2.overflowPolicy, OverflowPolicy::dropOldest);
+
+  // unknown policies are refused
+  const char *avu[parmCount] = {"./a2jmidi", "-o", "drop"};
+  CommandLineInterpretation result3 = parseCommandLine(parmCount, avu);
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+}
+
+/**
+ * Controller coalescing and rate limiting.
+ */
+TEST_F(A2jmidiCommandLineParserTest, coalesceOptions) {
+  using namespace a2jmidi;
+
+  // the defaults
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result0 = parseCommandLine(1, avd);
+  EXPECT_FALSE(result0.coalesceControllers);
+  EXPECT_EQ(result0.controllerIntervalMs, 0.0);
+
+  // the long versions
+  const char *avl[4] = {"./a2jmidi", "--coalesce", "--controller-interval", "2.5"};
+  CommandLineInterpretation result1 = parseCommandLine(4, avl);
+  EXPECT_TRUE(result1.coalesceControllers);
+  EXPECT_EQ(result1.controllerIntervalMs, 2.5);
+
+  // the short versions
+  const char *avs[4] = {"./a2jmidi", "-C", "-i", "1"};
+  CommandLineInterpretation result2 = parseCommandLine(4, avs);
+  EXPECT_TRUE(result2.coalesceControllers);
+  EXPECT_EQ(result2.controllerIntervalMs, 1.0);
+
+  // negative intervals are refused
+  const char *avn[3] = {"./a2jmidi", "-i", "-1"};
+  CommandLineInterpretation result3 = parseCommandLine(3, avn);
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+}
+
+/**
+ * The SysEx policy.
+ */
+TEST_F(A2jmidiCommandLineParserTest, sysexOption) {
+  using namespace a2jmidi;
+  constexpr int parmCount = 1 + 2;
+
+  // the default
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result0 = parseCommandLine(1, avd);
+  EXPECT_EQ(result0.sysexPolicy, SysexPolicy::defer);
+
+  // the long version
+  const char *avl[parmCount] = {"./a2jmidi", "--sysex", "reject"};
+  CommandLineInterpretation result1 = parseCommandLine(parmCount, avl);
+  EXPECT_EQ(result1.sysexPolicy, SysexPolicy::reject);
+
+  // the short version
+  const char *avs[parmCount] = {"./a2jmidi", "-e", "defer"};
+  CommandLineInterpretation result2 = parseCommandLine(parmCount, avs);
+  EXPECT_EQ(result2.sysexPolicy, SysexPolicy::defer);
+
+  // unknown policies are refused
+  const char *avu[parmCount] = {"./a2jmidi", "-e", "split"};
+  CommandLineInterpretation result3 = parseCommandLine(parmCount, avu);
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+}
+
+/**
+ * The categories of messages to be dropped by the kernel are given as a comma separated list.
+ */
+TEST_F(A2jmidiCommandLineParserTest, filterOption) {
+  using namespace a2jmidi;
+  constexpr int parmCount = 1 + 2;
+
+  // the default
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result0 = parseCommandLine(1, avd);
+  EXPECT_TRUE(result0.eventFilter.empty());
+
+  // the long version
+  const char *avl[parmCount] = {"./a2jmidi", "--filter", "clock,sensing"};
+  CommandLineInterpretation result1 = parseCommandLine(parmCount, avl);
+  EXPECT_EQ(result1.action, CommandLineAction::run);
+  EXPECT_TRUE(result1.eventFilter.blocks(SND_SEQ_EVENT_CLOCK));
+  EXPECT_TRUE(result1.eventFilter.blocks(SND_SEQ_EVENT_SENSING));
+  EXPECT_FALSE(result1.eventFilter.blocks(SND_SEQ_EVENT_NOTEON));
+  EXPECT_FALSE(result1.eventFilter.blocks(SND_SEQ_EVENT_START));
+
+  // the short version
+  const char *avs[parmCount] = {"./a2jmidi", "-F", "transport"};
+  CommandLineInterpretation result2 = parseCommandLine(parmCount, avs);
+  EXPECT_TRUE(result2.eventFilter.blocks(SND_SEQ_EVENT_START));
+  EXPECT_TRUE(result2.eventFilter.blocks(SND_SEQ_EVENT_SONGPOS));
+  EXPECT_FALSE(result2.eventFilter.blocks(SND_SEQ_EVENT_CLOCK));
+
+  // unknown categories are refused
+  const char *avu[parmCount] = {"./a2jmidi", "-F", "clock,notes"};
+  CommandLineInterpretation result3 = parseCommandLine(parmCount, avu);
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+}
+
+/**
+ * The sizes of the input pool and of the input buffer can be given on the command line.
+ */
+TEST_F(A2jmidiCommandLineParserTest, inputSizeOptions) {
+  using namespace a2jmidi;
+
+  // the default
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result0 = parseCommandLine(1, avd);
+  EXPECT_EQ(result0.inputPool, alsaClient::DEFAULT_INPUT_POOL);
+  EXPECT_EQ(result0.inputBuffer, alsaClient::DEFAULT_INPUT_BUFFER);
+
+  // the long version
+  const char *avl[5] = {"./a2jmidi", "--input-pool", "500", "--input-buffer", "100"};
+  CommandLineInterpretation result1 = parseCommandLine(5, avl);
+  EXPECT_EQ(result1.inputPool, 500);
+  EXPECT_EQ(result1.inputBuffer, 100);
+
+  // the short version
+  const char *avs[5] = {"./a2jmidi", "-p", "1000", "-b", "200"};
+  CommandLineInterpretation result2 = parseCommandLine(5, avs);
+  EXPECT_EQ(result2.inputPool, 1000);
+  EXPECT_EQ(result2.inputBuffer, 200);
+
+  // the kernel does not grant more than 2000 events
+  const char *avu[3] = {"./a2jmidi", "-p", "4000"};
+  CommandLineInterpretation result3 = parseCommandLine(3, avu);
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+  const char *avz[3] = {"./a2jmidi", "-b", "0"};
+  CommandLineInterpretation result4 = parseCommandLine(3, avz);
+  EXPECT_EQ(result4.action, CommandLineAction::messageError);
+}
+
+/**
+ * The busy poll mode is selected by giving the CPU for the listener.
+ */
+TEST_F(A2jmidiCommandLineParserTest, busyPollOptions) {
+  using namespace a2jmidi;
+
+  // the default
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result0 = parseCommandLine(1, avd);
+  EXPECT_FALSE(result0.busyPoll.enabled);
+
+  // the long version
+  const char *avl[5] = {"./a2jmidi", "--busy-poll", "3", "--backoff", "yield"};
+  CommandLineInterpretation result1 = parseCommandLine(5, avl);
+  EXPECT_TRUE(result1.busyPoll.enabled);
+  EXPECT_EQ(result1.busyPoll.cpu, 3);
+  EXPECT_EQ(result1.busyPoll.backoff, alsaClient::Backoff::yield);
+
+  // the short version, with the default back-off
+  const char *avs[3] = {"./a2jmidi", "-B", "2"};
+  CommandLineInterpretation result2 = parseCommandLine(3, avs);
+  EXPECT_TRUE(result2.busyPoll.enabled);
+  EXPECT_EQ(result2.busyPoll.cpu, 2);
+  EXPECT_EQ(result2.busyPoll.backoff, alsaClient::Backoff::pause);
+
+  // a back-off without busy poll is refused
+  const char *avb[3] = {"./a2jmidi", "-y", "spin"};
+  CommandLineInterpretation result3 = parseCommandLine(3, avb);
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+
+  // unknown back-offs are refused
+  const char *avu[5] = {"./a2jmidi", "-B", "1", "-y", "sleep"};
+  CommandLineInterpretation result4 = parseCommandLine(5, avu);
+  EXPECT_EQ(result4.action, CommandLineAction::messageError);
+}
+
+/**
+ * The scheduling of the listener and the monitor threads and the memory locking.
+ */
+TEST_F(A2jmidiCommandLineParserTest, realtimeOptions) {
+  using namespace a2jmidi;
+
+  // the default
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result0 = parseCommandLine(1, avd);
+  EXPECT_EQ(result0.realtime.listener.policy, SCHED_OTHER);
+  EXPECT_EQ(result0.realtime.listener.cpu, -1);
+  EXPECT_EQ(result0.realtime.monitor.cpu, -1);
+  EXPECT_FALSE(result0.realtime.lockMemory);
+
+  // the long version
+  const char *avl[10] = {"./a2jmidi", "--listener-policy", "rr", "--listener-priority", "70",
+                         "--listener-cpu", "2", "--monitor-cpu", "0", "--mlock"};
+  CommandLineInterpretation result1 = parseCommandLine(10, avl);
+  EXPECT_EQ(result1.action, CommandLineAction::run);
+  EXPECT_EQ(result1.realtime.listener.policy, SCHED_RR);
+  EXPECT_EQ(result1.realtime.listener.priority, 70);
+  EXPECT_EQ(result1.realtime.listener.cpu, 2);
+  EXPECT_EQ(result1.realtime.monitor.cpu, 0);
+  EXPECT_TRUE(result1.realtime.lockMemory);
+
+  // the short version: a policy without priority gets the default priority
+  const char *avs[4] = {"./a2jmidi", "-P", "fifo", "-m"};
+  CommandLineInterpretation result2 = parseCommandLine(4, avs);
+  EXPECT_EQ(result2.realtime.listener.policy, SCHED_FIFO);
+  EXPECT_EQ(result2.realtime.listener.priority, DEFAULT_LISTENER_PRIORITY);
+  EXPECT_TRUE(result2.realtime.lockMemory);
+
+  // a priority without policy selects fifo
+  const char *avp[3] = {"./a2jmidi", "-R", "50"};
+  CommandLineInterpretation result3 = parseCommandLine(3, avp);
+  EXPECT_EQ(result3.realtime.listener.policy, SCHED_FIFO);
+  EXPECT_EQ(result3.realtime.listener.priority, 50);
+
+  // refused: a priority out of range, a priority for "other", a second pinning of the listener
+  const char *avr[3] = {"./a2jmidi", "-R", "100"};
+  EXPECT_EQ(parseCommandLine(3, avr).action, CommandLineAction::messageError);
+  const char *avo[5] = {"./a2jmidi", "-P", "other", "-R", "10"};
+  EXPECT_EQ(parseCommandLine(5, avo).action, CommandLineAction::messageError);
+  const char *avb[5] = {"./a2jmidi", "-B", "3", "-L", "2"};
+  EXPECT_EQ(parseCommandLine(5, avb).action, CommandLineAction::messageError);
+}
 } // namespace unitTests
@@ -18,9 +18,16 @@
  */
 
 #include "alsa_client.h"
+#include "alsa_receiver_queue.h"
 #include "spdlog/spdlog.h"
+#include "sys_clock.h"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include "alsa_helper.h"
 #include "gmock/gmock.h"
@@ -208,4 +215,322 @@ TEST_F(AlsaClientTest, processEventsError) {
   alsaClient::close();
   unitTestHelpers::AlsaHelper::closeAlsaSequencer();
 }
+/**
+ * With kernel timestamps, every event carries the time of its arrival. Events sent
+ * together share (almost) the same time stamp, events sent apart keep their spacing.
+ */
+TEST_F(AlsaClientTest, kernelTimestamps) {
+  using namespace ::unitTestHelpers;
+
+  unitTestHelpers::AlsaHelper::openAlsaSequencer("sender");
+  auto emitterPort = AlsaHelper::createOutputPort("port");
+
+  alsaClient::open("testClient");
+  alsaClient::newReceiverPort("testPort", "sender:port", true);
+  auto startTime = AlsaHelper::clock()->now();
+  alsaClient::activate(AlsaHelper::clock());
+
+  constexpr int doubleNoteOns = 4;
+  constexpr long intervalMs = 20; // note-ons and note-offs are 10 ms apart.
+  unitTestHelpers::AlsaHelper::sendEvents(emitterPort, doubleNoteOns, intervalMs);
+  auto stopTime = AlsaHelper::clock()->now() + 1000;
+
+  std::vector<a2jmidi::TimePoint> timeStamps;
+  auto processMidi = [&](const midi::Event &event, a2jmidi::TimePoint timeStamp) -> int {
+    timeStamps.push_back(timeStamp);
+    return 0;
+  };
+  int err = alsaClient::retrieve(stopTime, processMidi);
+  EXPECT_FALSE(err);
+  ASSERT_EQ(timeStamps.size(), doubleNoteOns * 4);
+
+  constexpr long halfIntervalUs = intervalMs * 1000 / 2; // the TestClock ticks in microseconds.
+  constexpr long toleranceUs = 3000;
+  for (size_t i = 0; i < timeStamps.size(); i += 2) {
+    EXPECT_GE(timeStamps[i], startTime);
+    EXPECT_LE(timeStamps[i + 1], stopTime);
+    // the two notes of a pair were sent together.
+    EXPECT_NEAR(timeStamps[i + 1], timeStamps[i], toleranceUs);
+    if (i > 0) {
+      EXPECT_NEAR(timeStamps[i] - timeStamps[i - 2], halfIntervalUs, toleranceUs);
+    }
+  }
+
+  alsaClient::close();
+  unitTestHelpers::AlsaHelper::closeAlsaSequencer();
+}
+/**
+ * `retrieve` is called from the JACK real-time thread. It must finish in bounded
+ * time even while the control functions hold their locks.
+ */
+TEST_F(AlsaClientTest, retrieveWhileControlPlaneLocked) {
+  using namespace ::unitTestHelpers;
+  using namespace std::chrono_literals;
+
+  unitTestHelpers::AlsaHelper::openAlsaSequencer("sender");
+  auto emitterPort = AlsaHelper::createOutputPort("port");
+
+  alsaClient::open("testClient");
+  alsaClient::newReceiverPort("testPort", "sender:port");
+  alsaClient::activate(AlsaHelper::clock());
+
+  constexpr int doubleNoteOns = 4;
+  unitTestHelpers::AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 10);
+  auto stopTime = AlsaHelper::clock()->now() + 1000;
+
+  int noteCount = 0;
+  auto processMidi = [&](const midi::Event &event, a2jmidi::TimePoint timeStamp) -> int {
+    noteCount++;
+    return 0;
+  };
+
+  std::future<double> retrieval;
+  {
+    // simulate the connection monitor and a `stop()` that are holding their locks.
+    std::lock_guard<std::mutex> stateLock{alsaClient::impl::g_stateAccessMutex};
+    std::lock_guard<std::mutex> queueLock{alsaClient::receiverQueue::impl::g_queueAccessMutex};
+
+    retrieval = std::async(std::launch::async, [&]() {
+      auto start = sysClock::now();
+      alsaClient::retrieve(stopTime, processMidi);
+      return sysClock::toMicrosecondFloat(sysClock::now() - start);
+    });
+    ASSERT_EQ(retrieval.wait_for(100ms), std::future_status::ready);
+  }
+  auto duration = retrieval.get();
+  SPDLOG_INFO("retrieveWhileControlPlaneLocked - retrieve took {} us", duration);
+  EXPECT_LT(duration, 1000.0);
+  EXPECT_EQ(noteCount, doubleNoteOns * 4);
+
+  alsaClient::close();
+  unitTestHelpers::AlsaHelper::closeAlsaSequencer();
+}
+
+/**
+ * Send a clock and an active sensing stream with some notes in between, one message every
+ * two milliseconds, so that (nearly) every message wakes up the listener thread.
+ * @param filter - the event filter of the receiving client.
+ * @param noteCount - receives the number of retrieved notes.
+ * @param otherCount - receives the number of all other retrieved messages.
+ * @return the number of wake-ups of the listener thread.
+ */
+long receiveClockStream(const alsaClient::EventFilter &filter, int &noteCount, int &otherCount) {
+  using namespace ::unitTestHelpers;
+  constexpr int messageCount = 200;
+
+  AlsaHelper::openAlsaSequencer("sender");
+  auto emitterPort = AlsaHelper::createOutputPort("port");
+  alsaClient::open("testClient", filter);
+  alsaClient::newReceiverPort("testPort", "sender:port");
+  alsaClient::activate(AlsaHelper::clock());
+
+  for (int i = 0; i < messageCount; i++) {
+    if (i % 10 == 0) {
+      AlsaHelper::sendIndexedEvent(emitterPort, i);
+    } else if (i % 10 == 5) {
+      AlsaHelper::sendSimpleEvent(emitterPort, SND_SEQ_EVENT_SENSING);
+    } else {
+      AlsaHelper::sendSimpleEvent(emitterPort, SND_SEQ_EVENT_CLOCK);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  noteCount = 0;
+  otherCount = 0;
+  auto processMidi = [&](const midi::Event &event, a2jmidi::TimePoint timeStamp) -> int {
+    if ((event[0] & 0xF0) == 0x90) {
+      noteCount++;
+    } else {
+      otherCount++;
+    }
+    return 0;
+  };
+  alsaClient::retrieve(AlsaHelper::clock()->now() + 1000, processMidi);
+  long wakeUps = alsaClient::receiverQueue::getWakeUpCount();
+
+  alsaClient::close();
+  AlsaHelper::closeAlsaSequencer();
+  return wakeUps;
+}
+
+/**
+ * Filtered event types never leave the kernel: they do not reach the queue and
+ * they do not wake up the listener thread.
+ */
+TEST_F(AlsaClientTest, eventFilter) {
+  int noteCount;
+  int otherCount;
+  long unfilteredWakeUps = receiveClockStream(alsaClient::EventFilter{}, noteCount, otherCount);
+  EXPECT_EQ(noteCount, 20);
+  EXPECT_EQ(otherCount, 180);
+
+  alsaClient::EventFilter filter;
+  ASSERT_TRUE(filter.blockCategory("clock"));
+  ASSERT_TRUE(filter.blockCategory("sensing"));
+  long filteredWakeUps = receiveClockStream(filter, noteCount, otherCount);
+  EXPECT_EQ(noteCount, 20);
+  EXPECT_EQ(otherCount, 0);
+
+  SPDLOG_INFO("eventFilter - {} wake-ups without filter, {} with filter ({} saved).",
+              unfilteredWakeUps, filteredWakeUps, unfilteredWakeUps - filteredWakeUps);
+  EXPECT_LE(filteredWakeUps, 20);
+  EXPECT_GT(unfilteredWakeUps, 100);
+}
+
+/**
+ * The result of sending one burst of indexed notes.
+ */
+struct BurstResult {
+  int refused{0};      ///< events the kernel refused to accept.
+  int received{0};     ///< events retrieved from the alsaClient.
+  bool ordered{true};  ///< the events were retrieved in the order they were sent.
+  int overruns{0};     ///< input overruns reported by the kernel.
+  int restarts{0};     ///< listener restarts.
+  bool alive{false};   ///< an event sent after the burst was received.
+};
+
+/**
+ * Send a burst of indexed notes while a simulated process thread retrieves the events
+ * once per millisecond, then send one more note to verify that the listener survived.
+ * @param burstSize - the number of events in the burst.
+ * @param inputPool - the size of the input pool of the receiving client.
+ * @param inputBuffer - the size of the input buffer of the receiving client.
+ */
+BurstResult receiveBurst(int burstSize, int inputPool, int inputBuffer) {
+  using namespace ::unitTestHelpers;
+  AlsaHelper::openAlsaSequencer("sender");
+  auto emitterPort = AlsaHelper::createOutputPort("port");
+  alsaClient::open("testClient", alsaClient::EventFilter{}, inputPool, inputBuffer);
+  alsaClient::newReceiverPort("testPort", "sender:port");
+  alsaClient::activate(AlsaHelper::clock());
+
+  BurstResult result;
+  int expectedIndex = 0;
+  auto processMidi = [&](const midi::Event &event, a2jmidi::TimePoint timeStamp) -> int {
+    int index = AlsaHelper::indexOf(event.data());
+    if (index == AlsaHelper::MAX_EVENT_INDEX) {
+      result.alive = true;
+      return 0;
+    }
+    result.ordered = result.ordered && (index >= expectedIndex);
+    expectedIndex = index + 1;
+    result.received++;
+    return 0;
+  };
+  std::atomic<bool> sending{true};
+  auto sender = std::async(std::launch::async, [&]() {
+    int refused = AlsaHelper::sendBurst(emitterPort, burstSize);
+    sending = false;
+    return refused;
+  });
+  while (sending) {
+    alsaClient::retrieve(AlsaHelper::clock()->now(), processMidi);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  result.refused = sender.get();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  AlsaHelper::sendIndexedEvent(emitterPort, AlsaHelper::MAX_EVENT_INDEX);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  alsaClient::retrieve(AlsaHelper::clock()->now() + 1000, processMidi);
+  result.overruns = alsaClient::receiverQueue::getOverrunCount();
+  result.restarts = alsaClient::receiverQueue::getListenerRestartCount();
+
+  alsaClient::close();
+  AlsaHelper::closeAlsaSequencer();
+  return result;
+}
+
+/**
+ * Stress test: at the recommended sizes, a burst of 8k events arrives completely and in order.
+ */
+TEST_F(AlsaClientTest, burstAtRecommendedSize) {
+  constexpr int burstSize = 8 * 1024;
+  auto result =
+      receiveBurst(burstSize, alsaClient::DEFAULT_INPUT_POOL, alsaClient::DEFAULT_INPUT_BUFFER);
+  SPDLOG_INFO("burstAtRecommendedSize - {} sent, {} refused, {} received, {} overruns.",
+              burstSize, result.refused, result.received, result.overruns);
+  EXPECT_EQ(result.refused, 0);
+  EXPECT_EQ(result.overruns, 0);
+  EXPECT_EQ(result.received, burstSize);
+  EXPECT_TRUE(result.ordered);
+  EXPECT_TRUE(result.alive);
+  EXPECT_EQ(result.restarts, 0);
+}
+
+/**
+ * With a tiny input pool, the same burst overflows. The loss is accounted for and the
+ * listener carries on.
+ */
+TEST_F(AlsaClientTest, burstOverrun) {
+  constexpr int burstSize = 8 * 1024;
+  auto result = receiveBurst(burstSize, 8, 8);
+  SPDLOG_INFO("burstOverrun - {} sent, {} refused, {} received, {} overruns.", burstSize,
+              result.refused, result.received, result.overruns);
+  EXPECT_LE(result.received + result.refused, burstSize);
+  EXPECT_GT(result.refused + result.overruns, 0);
+  EXPECT_TRUE(result.ordered);
+  EXPECT_TRUE(result.alive); // the listener survived the overruns.
+  EXPECT_EQ(result.restarts, 0);
+}
+
+/**
+ * Send single notes, two milliseconds apart, and measure for each note the time from
+ * sending to its arrival in the queue (the listener stamps an event when it picks it up).
+ * @param busyPoll - the listener mode.
+ * @param noteCount - the number of notes to send.
+ * @return the delays in microseconds, sorted.
+ */
+std::vector<long> measureArrivalToEnqueue(const alsaClient::BusyPoll &busyPoll, int noteCount) {
+  using namespace ::unitTestHelpers;
+  auto clock = AlsaHelper::clock();
+  AlsaHelper::openAlsaSequencer("sender");
+  auto emitterPort = AlsaHelper::createOutputPort("port");
+  alsaClient::open("testClient");
+  alsaClient::newReceiverPort("testPort", "sender:port");
+  alsaClient::activate(AlsaHelper::clock(), busyPoll);
+
+  std::vector<a2jmidi::TimePoint> sendTimes(noteCount);
+  for (int i = 0; i < noteCount; i++) {
+    sendTimes[i] = clock->now();
+    AlsaHelper::sendIndexedEvent(emitterPort, i);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+
+  std::vector<long> delays;
+  auto processMidi = [&](const midi::Event &event, a2jmidi::TimePoint timeStamp) -> int {
+    delays.push_back(timeStamp - sendTimes[AlsaHelper::indexOf(event.data())]);
+    return 0;
+  };
+  alsaClient::retrieve(clock->now() + 1000, processMidi);
+
+  alsaClient::close();
+  AlsaHelper::closeAlsaSequencer();
+  std::sort(delays.begin(), delays.end());
+  return delays;
+}
+
+/**
+ * Benchmark: the arrival-to-enqueue delay of the poll based listener and of the busy polling
+ * listener. For meaningful results, the last CPU should be isolated (`isolcpus`).
+ */
+TEST_F(AlsaClientTest, listenerLatencyBenchmark) {
+  constexpr int noteCount = 500;
+  alsaClient::BusyPoll busyPoll;
+  busyPoll.enabled = true;
+  busyPoll.cpu = static_cast<int>(std::max(1U, std::thread::hardware_concurrency())) - 1;
+
+  auto pollDelays = measureArrivalToEnqueue(alsaClient::BusyPoll{}, noteCount);
+  auto busyDelays = measureArrivalToEnqueue(busyPoll, noteCount);
+  ASSERT_EQ(pollDelays.size(), noteCount);
+  ASSERT_EQ(busyDelays.size(), noteCount);
+
+  auto percentile = [](const std::vector<long> &delays, double p) {
+    return delays[static_cast<size_t>(p * static_cast<double>(delays.size() - 1))];
+  };
+  SPDLOG_INFO("listenerLatencyBenchmark - poll:      median {} us, 99th {} us, max {} us",
+              percentile(pollDelays, 0.5), percentile(pollDelays, 0.99), pollDelays.back());
+  SPDLOG_INFO("listenerLatencyBenchmark - busy poll: median {} us, 99th {} us, max {} us",
+              percentile(busyDelays, 0.5), percentile(busyDelays, 0.99), busyDelays.back());
+}
 } // namespace unitTests
@@ -0,0 +1,189 @@
+/*
+ * File: alsa_event_decoder_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alsa_event_decoder.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace unitTests {
+using namespace alsaClient;
+
+class AlsaEventDecoderTest : public ::testing::Test {
+protected:
+  snd_midi_event_t *parser{nullptr};
+
+  AlsaEventDecoderTest() { spdlog::set_level(spdlog::level::trace); }
+
+  void SetUp() override {
+    ASSERT_EQ(snd_midi_event_new(64, &parser), 0);
+    snd_midi_event_init(parser);
+    snd_midi_event_no_status(parser, 1); // as the receiver queue used to do.
+  }
+
+  void TearDown() override { snd_midi_event_free(parser); }
+};
+
+/**
+ * A sequencer event of the given type with random payload.
+ */
+snd_seq_event_t randomEvent(unsigned char type, std::mt19937 &random) {
+  std::uniform_int_distribution<int> anyByte{0, 255};
+  snd_seq_event_t event;
+  snd_seq_ev_clear(&event);
+  for (unsigned char &byte : event.data.raw8.d) {
+    byte = static_cast<unsigned char>(anyByte(random));
+  }
+  event.type = type;
+  return event;
+}
+
+/**
+ * The decoder produces exactly what alsa-lib produces, for every event type, random
+ * payloads and all buffer sizes up to the largest message.
+ */
+TEST_F(AlsaEventDecoderTest, differential) {
+  std::mt19937 random{4711};
+  std::uniform_int_distribution<int> smallValue{-9000, 9000};
+  unsigned char sysex[] = {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+  int compared = 0;
+  for (int type = 0; type < 256; type++) {
+    for (int round = 0; round < 200; round++) {
+      snd_seq_event_t event = randomEvent(static_cast<unsigned char>(type), random);
+      if (round % 2 == 0) {
+        // realistic values for pitch bend and song position.
+        event.data.control.value = smallValue(random);
+      }
+      if (type == SND_SEQ_EVENT_SYSEX && round % 4 != 3) {
+        snd_seq_ev_set_sysex(&event, sizeof(sysex), sysex);
+      }
+      if (type == SND_SEQ_EVENT_SYSEX && round % 4 == 2) {
+        event.flags = (event.flags & ~SND_SEQ_EVENT_LENGTH_MASK) | SND_SEQ_EVENT_LENGTH_VARUSR;
+      }
+      // alsa-lib checks the capacity first; the decoder rejects invalid data first.
+      const bool invalidSysex =
+          type == SND_SEQ_EVENT_SYSEX &&
+          (event.flags & SND_SEQ_EVENT_LENGTH_MASK) != SND_SEQ_EVENT_LENGTH_VARIABLE;
+      for (long capacity : {64L, 12L, 6L, 5L, 3L, 2L, 1L}) {
+        unsigned char expected[64]{};
+        unsigned char actual[64]{};
+        long expectedSize = snd_midi_event_decode(parser, expected, capacity, &event);
+        long actualSize = decodeEvent(event, actual, capacity);
+        if (invalidSysex) {
+          ASSERT_LT(expectedSize, 0);
+          ASSERT_EQ(actualSize, -EINVAL);
+          continue;
+        }
+        ASSERT_EQ(actualSize, expectedSize) << "type " << type << ", capacity " << capacity;
+        for (long i = 0; i < expectedSize; i++) {
+          ASSERT_EQ(actual[i], expected[i]) << "type " << type << ", byte " << i;
+        }
+        compared++;
+      }
+    }
+  }
+  SPDLOG_INFO("differential - {} decodings compared.", compared);
+}
+
+/**
+ * Some well known messages.
+ */
+TEST_F(AlsaEventDecoderTest, knownMessages) {
+  snd_seq_event_t event;
+  unsigned char bytes[MAX_DECODED_SIZE];
+
+  snd_seq_ev_clear(&event);
+  snd_seq_ev_set_noteon(&event, 3, 60, 100);
+  ASSERT_EQ(decodeEvent(event, bytes, sizeof(bytes)), 3);
+  EXPECT_EQ(std::vector<int>(bytes, bytes + 3), (std::vector<int>{0x93, 60, 100}));
+
+  snd_seq_ev_set_pitchbend(&event, 0, -8192);
+  ASSERT_EQ(decodeEvent(event, bytes, sizeof(bytes)), 3);
+  EXPECT_EQ(std::vector<int>(bytes, bytes + 3), (std::vector<int>{0xE0, 0, 0}));
+
+  snd_seq_ev_clear(&event);
+  event.type = SND_SEQ_EVENT_CLOCK;
+  ASSERT_EQ(decodeEvent(event, bytes, sizeof(bytes)), 1);
+  EXPECT_EQ(bytes[0], 0xF8);
+
+  event.type = SND_SEQ_EVENT_PORT_SUBSCRIBED;
+  EXPECT_EQ(decodeEvent(event, bytes, sizeof(bytes)), -ENOENT);
+
+  // SysEx data must be of variable length, whatever the size of the buffer.
+  unsigned char sysex[] = {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+  snd_seq_ev_clear(&event);
+  snd_seq_ev_set_sysex(&event, sizeof(sysex), sysex);
+  ASSERT_EQ(decodeEvent(event, bytes, sizeof(bytes)), 6);
+  event.flags = (event.flags & ~SND_SEQ_EVENT_LENGTH_MASK) | SND_SEQ_EVENT_LENGTH_VARUSR;
+  EXPECT_EQ(decodeEvent(event, bytes, sizeof(bytes)), -EINVAL);
+  EXPECT_EQ(decodeEvent(event, bytes, 2), -EINVAL);
+
+  snd_seq_ev_clear(&event);
+  event.type = SND_SEQ_EVENT_REGPARAM;
+  event.data.control.channel = 1;
+  event.data.control.param = 0;      // pitch bend sensitivity
+  event.data.control.value = 2 << 7; // two semitones
+  ASSERT_EQ(decodeEvent(event, bytes, sizeof(bytes)), 12);
+  EXPECT_EQ(std::vector<int>(bytes, bytes + 12),
+            (std::vector<int>{0xB1, 0x65, 0, 0xB1, 0x64, 0, 0xB1, 0x06, 2, 0xB1, 0x26, 0}));
+}
+
+/**
+ * Benchmark: nanoseconds per event, for a mix of notes, controllers and pitch bend.
+ */
+TEST_F(AlsaEventDecoderTest, decodeBenchmark) {
+  constexpr int rounds = 200000;
+  std::vector<snd_seq_event_t> events(4);
+  for (auto &event : events) {
+    snd_seq_ev_clear(&event);
+  }
+  snd_seq_ev_set_noteon(&events[0], 0, 60, 100);
+  snd_seq_ev_set_noteoff(&events[1], 0, 60, 0);
+  snd_seq_ev_set_controller(&events[2], 1, 74, 64);
+  snd_seq_ev_set_pitchbend(&events[3], 2, 1000);
+  unsigned char bytes[MAX_DECODED_SIZE];
+  long checksum = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    for (const auto &event : events) {
+      checksum += snd_midi_event_decode(parser, bytes, sizeof(bytes), &event) + bytes[1];
+    }
+  }
+  auto alsaTime = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    for (const auto &event : events) {
+      checksum -= decodeEvent(event, bytes, sizeof(bytes)) + bytes[1];
+    }
+  }
+  auto tableTime = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(checksum, 0);
+
+  using std::chrono::nanoseconds;
+  const double count = 4.0 * rounds;
+  SPDLOG_INFO("decodeBenchmark - snd_midi_event_decode {} ns, decodeEvent {} ns per event.",
+              std::chrono::duration_cast<nanoseconds>(alsaTime).count() / count,
+              std::chrono::duration_cast<nanoseconds>(tableTime).count() / count);
+}
+
+} // namespace unitTests
@@ -18,6 +18,7 @@
  */
 #include "alsa_helper.h"
 #include "spdlog/spdlog.h"
+#include <algorithm>
 #include <chrono>
 #include <stdexcept>
 #include <sys_clock.h>
@@ -236,6 +237,73 @@ void AlsaHelper::sendEvents(int hEmitterPort, int eventCount, long intervalMs) {
   }
 }
 
+/**
+ * Sends one note-on event whose key and velocity encode the given index.
+ * @param hEmitterPort the port-number of the emitter port.
+ * @param index a number between 0 and MAX_EVENT_INDEX.
+ */
+void AlsaHelper::sendIndexedEvent(int hEmitterPort, int index) {
+  snd_seq_event_t event;
+  snd_seq_ev_clear(&event);
+  snd_seq_ev_set_subs(&event);
+  snd_seq_ev_set_direct(&event);
+  snd_seq_ev_set_source(&event, hEmitterPort);
+  snd_seq_ev_set_noteon(&event, 0, (index >> 7) & 0x7F, index & 0x7F);
+
+  auto err = snd_seq_event_output_direct(g_hSequencer, &event);
+  checkAlsa("snd_seq_event_output_direct", err);
+}
+
+void AlsaHelper::sendSysex(int hEmitterPort, const unsigned char *data, int size,
+                           int chunkSize) {
+  for (int offset = 0; offset < size; offset += chunkSize) {
+    snd_seq_event_t event;
+    snd_seq_ev_clear(&event);
+    snd_seq_ev_set_subs(&event);
+    snd_seq_ev_set_direct(&event);
+    snd_seq_ev_set_source(&event, hEmitterPort);
+    snd_seq_ev_set_sysex(&event, std::min(chunkSize, size - offset),
+                         const_cast<unsigned char *>(data + offset));
+
+    auto err = snd_seq_event_output_direct(g_hSequencer, &event);
+    checkAlsa("snd_seq_event_output_direct", err);
+  }
+}
+
+void AlsaHelper::sendSimpleEvent(int hEmitterPort, snd_seq_event_type_t type) {
+  snd_seq_event_t event;
+  snd_seq_ev_clear(&event);
+  snd_seq_ev_set_subs(&event);
+  snd_seq_ev_set_direct(&event);
+  snd_seq_ev_set_source(&event, hEmitterPort);
+  event.type = type;
+
+  auto err = snd_seq_event_output_direct(g_hSequencer, &event);
+  checkAlsa("snd_seq_event_output_direct", err);
+}
+
+int AlsaHelper::sendBurst(int hEmitterPort, int eventCount) {
+  int refusedCount = 0;
+  for (int index = 0; index < eventCount; index++) {
+    snd_seq_event_t event;
+    snd_seq_ev_clear(&event);
+    snd_seq_ev_set_subs(&event);
+    snd_seq_ev_set_direct(&event);
+    snd_seq_ev_set_source(&event, hEmitterPort);
+    snd_seq_ev_set_noteon(&event, 0, (index >> 7) & 0x7F, index & 0x7F);
+    if (snd_seq_event_output_direct(g_hSequencer, &event) < 0) {
+      refusedCount++;
+    }
+  }
+  return refusedCount;
+}
+
+int AlsaHelper::indexOf(const snd_seq_event_t &event) {
+  return (event.data.note.note << 7) | event.data.note.velocity;
+}
+
+int AlsaHelper::indexOf(const unsigned char *midiData) { return (midiData[1] << 7) | midiData[2]; }
+
 int AlsaHelper::retrieveEvents() {
   SPDLOG_TRACE("AlsaHelper::retrieveEvents");
   snd_seq_event_t *ev;
@@ -323,6 +391,11 @@ public:
     auto sysNow = sysClock::now().time_since_epoch();
     return std::chrono::duration_cast<std::chrono::microseconds>(sysNow).count();
   }
+  /**
+   * The resolution of the clock.
+   * @return one million ticks per second.
+   */
+  long ticksPerSecond() override { return 1000000; }
 };
 
 /**
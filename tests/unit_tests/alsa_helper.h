@@ -122,6 +122,55 @@ public:
    * @param interval the time (in milliseconds) to wait between the sending of two events.
    */
   static void sendEvents(int hEmitterPort, int eventCount, long intervalMs);
+  /**
+   * Sends one note-on event whose key and velocity encode the given index.
+   * This call does not wait.
+   * @param hEmitterPort the port-number of the emitter port.
+   * @param index a number between 0 and MAX_EVENT_INDEX.
+   */
+  static void sendIndexedEvent(int hEmitterPort, int index);
+  /**
+   * The largest index that can be encoded by `sendIndexedEvent`.
+   */
+  static constexpr int MAX_EVENT_INDEX = 128 * 128 - 1;
+  /**
+   * Sends a SysEx message split into several sequencer events, as a MIDI device driver
+   * would deliver a long dump.
+   * This call does not wait.
+   * @param hEmitterPort the port-number of the emitter port.
+   * @param data the complete message, from 0xF0 to 0xF7.
+   * @param size the number of bytes.
+   * @param chunkSize the number of bytes per sequencer event.
+   */
+  static void sendSysex(int hEmitterPort, const unsigned char *data, int size, int chunkSize);
+  /**
+   * Sends one event without data, such as a MIDI clock tick or active sensing.
+   * This call does not wait.
+   * @param hEmitterPort the port-number of the emitter port.
+   * @param type the type of the sequencer event (for example `SND_SEQ_EVENT_CLOCK`).
+   */
+  static void sendSimpleEvent(int hEmitterPort, snd_seq_event_type_t type);
+  /**
+   * Sends a burst of events encoded by `sendIndexedEvent`, as fast as possible.
+   * Events that the kernel refuses (because the receiver's input pool is full) are
+   * counted and not sent again.
+   * @param hEmitterPort the port-number of the emitter port.
+   * @param eventCount the number of events, at most MAX_EVENT_INDEX + 1.
+   * @return the number of events refused by the kernel.
+   */
+  static int sendBurst(int hEmitterPort, int eventCount);
+  /**
+   * Recover the index of an event sent by `sendIndexedEvent`.
+   * @param event a note-on event.
+   * @return the index encoded in the event.
+   */
+  static int indexOf(const snd_seq_event_t &event);
+  /**
+   * Recover the index of an event sent by `sendIndexedEvent`.
+   * @param midiData the raw MIDI bytes of the note-on event.
+   * @return the index encoded in the event.
+   */
+  static int indexOf(const unsigned char *midiData);
   /**
    * Create a new Clock that works independently from the JACK server.
    * @return a smart pointer holding the clock.
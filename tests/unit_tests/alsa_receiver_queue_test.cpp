@@ -23,13 +23,180 @@
 #include "alsa_helper.h"
 #include "spdlog/spdlog.h"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <climits>
+#include <forward_list>
+#include <future>
+#include <poll.h>
 #include <thread>
+#include <vector>
 
 namespace unitTests {
 using namespace unitTestHelpers;
 
 using namespace alsaClient;
 
+/**
+ * The status nibble of a MIDI note-on message.
+ */
+constexpr unsigned char NOTE_ON = 0x90;
+
+/**
+ * Wait until the listener thread has received the given number of events and published
+ * them (at most one second).
+ * @param eventCount - the number of events since the queue was started.
+ * @return true if the events have arrived in time.
+ */
+bool waitForEvents(long eventCount) {
+  using namespace std::chrono_literals;
+  for (int i = 0; i < 1000; i++) {
+    if (receiverQueue::getReceivedEventCount() >= eventCount &&
+        receiverQueue::getCurrentEventBatchCount() > 0) {
+      // the last batch is published right after its last event has been counted.
+      std::this_thread::sleep_for(5ms);
+      return true;
+    }
+    std::this_thread::sleep_for(1ms);
+  }
+  return false;
+}
+
+/**
+ * For comparison in the benchmarks: a condensed copy of the former receiverQueue
+ * that launched one `std::async` thread per batch of incoming events.
+ */
+namespace futureChain {
+struct Batch;
+using BatchPtr = std::unique_ptr<Batch>;
+using FutureBatch = std::future<BatchPtr>;
+struct Batch {
+  FutureBatch next;
+  std::forward_list<snd_seq_event_t> events;
+};
+static std::atomic<bool> g_carryOnFlag{false};
+static FutureBatch g_queueHead;
+
+FutureBatch startNextFuture(snd_seq_t *hSequencer);
+
+BatchPtr listenForEvents(snd_seq_t *hSequencer) {
+  int fdsCount = snd_seq_poll_descriptors_count(hSequencer, POLLIN);
+  struct pollfd fds[fdsCount];
+  while (g_carryOnFlag) {
+    snd_seq_poll_descriptors(hSequencer, fds, fdsCount, POLLIN);
+    if (poll(fds, fdsCount, 10) > 0 && g_carryOnFlag) {
+      auto batch = std::make_unique<Batch>();
+      snd_seq_event_t *eventPtr;
+      while (snd_seq_event_input(hSequencer, &eventPtr) >= 0) {
+        batch->events.push_front(*eventPtr);
+      }
+      if (!batch->events.empty()) {
+        batch->next = startNextFuture(hSequencer);
+        return batch;
+      }
+    }
+  }
+  throw std::runtime_error("interrupted");
+}
+
+FutureBatch startNextFuture(snd_seq_t *hSequencer) {
+  return std::async(std::launch::async, [hSequencer]() { return listenForEvents(hSequencer); });
+}
+
+void start(snd_seq_t *hSequencer) {
+  g_carryOnFlag = true;
+  g_queueHead = startNextFuture(hSequencer);
+}
+
+template <typename Closure> void process(const Closure &closure) {
+  while (g_queueHead.valid() &&
+         g_queueHead.wait_for(std::chrono::microseconds(0)) == std::future_status::ready) {
+    try {
+      BatchPtr batch = g_queueHead.get();
+      for (const auto &event : batch->events) {
+        closure(event);
+      }
+      g_queueHead = std::move(batch->next);
+    } catch (const std::runtime_error &) {
+      break;
+    }
+  }
+}
+
+void stop() {
+  g_carryOnFlag = false;
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  g_queueHead = FutureBatch{};
+}
+} // namespace futureChain
+
+/**
+ * The results of a hand-off benchmark.
+ */
+struct HandOffStatistics {
+  int received{0};           ///< number of events that made it through the queue.
+  double eventsPerSecond{0}; ///< throughput.
+  double p99LatencyUs{0};    ///< 99th percentile of the time from sending to consuming.
+};
+
+/**
+ * Send indexed events in small bursts through `emitterPort` and measure when each of them
+ * comes out of the queue under test.
+ * @param emitterPort - the port to send from.
+ * @param eventCount - the number of events to send.
+ * @param drain - consumes all available events, calling the given function with the index
+ * of each event.
+ * @return the measured statistics.
+ */
+template <typename Drain>
+HandOffStatistics measureHandOff(int emitterPort, int eventCount, const Drain &drain) {
+  using namespace std::chrono_literals;
+  constexpr int burstSize = 8;
+  std::vector<sysClock::TimePoint> sendTimes(eventCount);
+  std::vector<sysClock::TimePoint> receiveTimes(eventCount);
+  std::vector<bool> seen(eventCount, false);
+
+  std::thread sender([&]() {
+    for (int i = 0; i < eventCount; ++i) {
+      sendTimes[i] = sysClock::now();
+      AlsaHelper::sendIndexedEvent(emitterPort, i);
+      if (i % burstSize == burstSize - 1) {
+        std::this_thread::sleep_for(250us);
+      }
+    }
+  });
+
+  HandOffStatistics result;
+  auto timeout = sysClock::now() + 5s;
+  while (result.received < eventCount && sysClock::now() < timeout) {
+    drain([&](int index) {
+      if (index < eventCount && !seen[index]) {
+        seen[index] = true;
+        receiveTimes[index] = sysClock::now();
+        result.received++;
+      }
+    });
+    std::this_thread::sleep_for(100us);
+  }
+  sender.join();
+
+  std::vector<double> latencies;
+  auto lastReceived = sendTimes[0];
+  for (int i = 0; i < eventCount; ++i) {
+    if (seen[i]) {
+      latencies.push_back(sysClock::toMicrosecondFloat(receiveTimes[i] - sendTimes[i]));
+      lastReceived = std::max(lastReceived, receiveTimes[i]);
+    }
+  }
+  if (latencies.empty()) {
+    return result;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  result.p99LatencyUs = latencies[(latencies.size() * 99) / 100];
+  result.eventsPerSecond =
+      result.received / (sysClock::toMicrosecondFloat(lastReceived - sendTimes[0]) / 1.0e6);
+  return result;
+}
+
 // The fixture for testing module AlsaListener.
 class AlsaReceiverQueueTest : public ::testing::Test {
 
@@ -134,9 +301,9 @@ TEST_F(AlsaReceiverQueueTest, processEvents_1) {
 
   int noteOnCount = 0;
   queue::process(stopTime, //
-                 ([&](const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+                 ([&](const unsigned char *midiData, int size, a2jmidi::TimePoint timeStamp) {
                    // --- the Callback
-                   if (event.type == SND_SEQ_EVENT_NOTEON) {
+                   if ((midiData[0] & 0xF0) == NOTE_ON) {
                      noteOnCount++;
                    }
                    EXPECT_GE(timeStamp, startTime);
@@ -174,9 +341,9 @@ TEST_F(AlsaReceiverQueueTest, processEvents_2) {
   // process events of first tranche
   int noteOnCount = 0;
   queue::process(firstStop, //
-                 ([&](const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+                 ([&](const unsigned char *midiData, int size, a2jmidi::TimePoint timeStamp) {
                    // --- the Callback
-                   if (event.type == SND_SEQ_EVENT_NOTEON) {
+                   if ((midiData[0] & 0xF0) == NOTE_ON) {
                      noteOnCount++;
                    }
                    EXPECT_GE(timeStamp, startTime);
@@ -189,9 +356,9 @@ TEST_F(AlsaReceiverQueueTest, processEvents_2) {
   // process events of second tranche
   noteOnCount = 0;
   queue::process(lastStop, //
-                 ([&](auto &event, auto timeStamp) {
+                 ([&](auto midiData, auto size, auto timeStamp) {
                    // --- the Callback
-                   if (event.type == SND_SEQ_EVENT_NOTEON) {
+                   if ((midiData[0] & 0xF0) == NOTE_ON) {
                      noteOnCount++;
                    }
                    EXPECT_GE(timeStamp, firstStop);
@@ -227,9 +394,9 @@ TEST_F(AlsaReceiverQueueTest, processEvents_3) {
   // process all events of the first tranche
   int noteOnCount = 0;
   queue::process(firstStop, //
-                 ([&](const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+                 ([&](const unsigned char *midiData, int size, a2jmidi::TimePoint timeStamp) {
                    // --- the Callback
-                   if (event.type == SND_SEQ_EVENT_NOTEON) {
+                   if ((midiData[0] & 0xF0) == NOTE_ON) {
                      noteOnCount++;
                    }
                    EXPECT_GE(timeStamp, startTime);
@@ -246,9 +413,9 @@ TEST_F(AlsaReceiverQueueTest, processEvents_3) {
   // process all events of second tranche
   noteOnCount = 0;
   queue::process(lastStop, //
-                 ([&](auto &event, auto timeStamp) {
+                 ([&](auto midiData, auto size, auto timeStamp) {
                    // --- the Callback
-                   if (event.type == SND_SEQ_EVENT_NOTEON) {
+                   if ((midiData[0] & 0xF0) == NOTE_ON) {
                      noteOnCount++;
                    }
                    EXPECT_GE(timeStamp, secondStart);
@@ -262,6 +429,111 @@ TEST_F(AlsaReceiverQueueTest, processEvents_3) {
   EXPECT_EQ(queue::getState(), queue::State::stopped);
 }
 
+/**
+ * Events come out of the queue in the order in which they were sent, also when a burst
+ * is larger than one pool slot. The pool statistics reflect what was stored.
+ */
+TEST_F(AlsaReceiverQueueTest, processEventsInOrder) {
+  using namespace std::chrono_literals;
+  namespace queue = receiverQueue; // a shorthand.
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  EXPECT_EQ(queue::getPoolCapacity(), queue::DEFAULT_CAPACITY);
+  EXPECT_EQ(queue::getPoolHighWatermark(), 0);
+
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  constexpr int eventCount = 5 * queue::BATCH_CAPACITY;
+  for (int i = 0; i < eventCount; i++) {
+    AlsaHelper::sendIndexedEvent(emitterPort, i);
+  }
+  std::this_thread::sleep_for(50ms);
+  EXPECT_GT(queue::getCurrentEventBatchCount(), 0);
+
+  int expectedIndex = 0;
+  queue::process(AlsaHelper::clock()->now(), //
+                 ([&](const unsigned char *midiData, int size, a2jmidi::TimePoint timeStamp) {
+                   EXPECT_EQ(AlsaHelper::indexOf(midiData), expectedIndex);
+                   expectedIndex++;
+                 }));
+
+  EXPECT_EQ(expectedIndex, eventCount);
+  EXPECT_EQ(queue::getCurrentEventBatchCount(), 0);
+  EXPECT_GE(queue::getPoolHighWatermark(), 1);
+  EXPECT_EQ(queue::getLostEventCount(), 0);
+  queue::stop();
+}
+
+/**
+ * When the pool is exhausted, every discarded event is counted.
+ */
+TEST_F(AlsaReceiverQueueTest, countLostEvents) {
+  using namespace std::chrono_literals;
+  namespace queue = receiverQueue; // a shorthand.
+
+  constexpr int capacity = 2;
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock(), capacity);
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  constexpr int eventCount = 8 * queue::BATCH_CAPACITY;
+  for (int i = 0; i < eventCount; i++) {
+    AlsaHelper::sendIndexedEvent(emitterPort, i);
+  }
+  std::this_thread::sleep_for(50ms);
+
+  int deliveredCount = 0;
+  queue::process(AlsaHelper::clock()->now(), //
+                 ([&](const unsigned char *midiData, int size, a2jmidi::TimePoint timeStamp) {
+                   deliveredCount++;
+                 }));
+
+  EXPECT_LE(deliveredCount, capacity * queue::BATCH_CAPACITY);
+  EXPECT_EQ(deliveredCount + queue::getLostEventCount(), eventCount);
+  queue::stop();
+}
+
+/**
+ * Benchmark: the persistent listener thread compared to the former chain of futures.
+ *
+ * Dense traffic is sent in small bursts; we record the throughput and the
+ * 99th percentile of the time an event needs from the sender to the consumer.
+ */
+TEST_F(AlsaReceiverQueueTest, handOffBenchmark) {
+  namespace queue = receiverQueue; // a shorthand.
+  constexpr int eventCount = 4000;
+
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  futureChain::start(AlsaHelper::getSequencerHandle());
+  auto chainResult = measureHandOff(emitterPort, eventCount, [](const auto &closure) {
+    futureChain::process(
+        [&closure](const snd_seq_event_t &event) { closure(AlsaHelper::indexOf(event)); });
+  });
+  futureChain::stop();
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto ringResult = measureHandOff(emitterPort, eventCount, [](const auto &closure) {
+    queue::process(LONG_MAX, [&closure](const unsigned char *midiData, int, a2jmidi::TimePoint) {
+      closure(AlsaHelper::indexOf(midiData));
+    });
+  });
+  queue::stop();
+
+  SPDLOG_INFO("handOffBenchmark - future chain: {} events/s, p99 hand-off {} us",
+              chainResult.eventsPerSecond, chainResult.p99LatencyUs);
+  SPDLOG_INFO("handOffBenchmark - listener thread: {} events/s, p99 hand-off {} us",
+              ringResult.eventsPerSecond, ringResult.p99LatencyUs);
+
+  EXPECT_EQ(ringResult.received, eventCount);
+  EXPECT_EQ(queue::getLostEventCount(), 0);
+}
+
 /**
  *  when calling "process" on a stopped queue, nothing (bad) happens.
  */
@@ -273,7 +545,8 @@ TEST_F(AlsaReceiverQueueTest, processStoppedQueue) {
 
   int callbackCount = 0;
   receiverQueue::process(firstStop, //
-                         ([&](const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+                         ([&](const unsigned char *midiData, int size,
+                              a2jmidi::TimePoint timeStamp) {
                            // --- the Callback
                            callbackCount++;
                          }));
@@ -281,4 +554,87 @@ TEST_F(AlsaReceiverQueueTest, processStoppedQueue) {
   EXPECT_EQ(callbackCount, 0);
 }
 
+/**
+ * After a clock discontinuity, all queued events can be dropped at once;
+ * events received afterwards are processed as usual.
+ */
+TEST_F(AlsaReceiverQueueTest, discardEvents) {
+  using namespace std::chrono_literals;
+  namespace queue = receiverQueue; // a shorthand.
+
+  EXPECT_EQ(queue::discard(), 0); // the queue is not running.
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+  constexpr int doubleNoteOns = 4;
+
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 50);
+  ASSERT_TRUE(waitForEvents(doubleNoteOns * 4));
+  EXPECT_EQ(queue::discard(), doubleNoteOns * 4); // two note-ons and two note-offs each.
+  EXPECT_FALSE(queue::hasResult());
+
+  AlsaHelper::sendEvents(emitterPort, 1, 50);
+  ASSERT_TRUE(waitForEvents(doubleNoteOns * 4 + 4));
+  auto stopTime = AlsaHelper::clock()->now() + 100;
+  int callbackCount = 0;
+  queue::process(stopTime, //
+                 ([&](const unsigned char *midiData, int size, a2jmidi::TimePoint timeStamp) {
+                   callbackCount++;
+                 }));
+  EXPECT_EQ(callbackCount, 4);
+
+  queue::stop();
+  EXPECT_EQ(queue::getState(), queue::State::stopped);
+}
+
+/**
+ * A SysEx message far longer than `MAX_MIDI_EVENT_SIZE`, delivered in chunks, is handed over
+ * once and complete; notes sent around it keep their order.
+ */
+TEST_F(AlsaReceiverQueueTest, receiveLongSysex) {
+  using namespace std::chrono_literals;
+  namespace queue = receiverQueue; // a shorthand.
+  constexpr int sysexSize = 8 * 1024;
+  std::vector<unsigned char> sysex(sysexSize);
+  sysex[0] = 0xF0;
+  for (int i = 1; i < sysexSize - 1; i++) {
+    sysex[i] = static_cast<unsigned char>(i & 0x7F);
+  }
+  sysex[sysexSize - 1] = 0xF7;
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  AlsaHelper::sendIndexedEvent(emitterPort, 1);
+  AlsaHelper::sendSysex(emitterPort, sysex.data(), sysexSize, 256);
+  AlsaHelper::sendIndexedEvent(emitterPort, 2);
+  // an incomplete message is discarded when the next one begins.
+  AlsaHelper::sendSysex(emitterPort, sysex.data(), 300, 256);
+  AlsaHelper::sendSysex(emitterPort, sysex.data(), sysexSize, 1000);
+  std::this_thread::sleep_for(20ms);
+
+  std::vector<int> sizes;
+  std::vector<int> indices;
+  bool intact = true;
+  queue::process(AlsaHelper::clock()->now() + 100,
+                 [&](const unsigned char *midiData, int size, a2jmidi::TimePoint timeStamp) {
+                   sizes.push_back(size);
+                   if (size == sysexSize) {
+                     intact = intact && std::equal(sysex.begin(), sysex.end(), midiData);
+                   } else {
+                     indices.push_back(AlsaHelper::indexOf(midiData));
+                   }
+                 });
+  EXPECT_EQ(sizes, (std::vector<int>{3, sysexSize, 3, sysexSize}));
+  EXPECT_EQ(indices, (std::vector<int>{1, 2}));
+  EXPECT_TRUE(intact);
+  EXPECT_EQ(queue::getLostSysexCount(), 1);
+
+  queue::stop();
+}
+
 } // namespace unitTests
@@ -0,0 +1,86 @@
+/*
+ * File: busy_poll_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "busy_poll.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+
+namespace unitTests {
+using namespace alsaClient;
+
+class BusyPollTest : public ::testing::Test {
+protected:
+  BusyPollTest() { spdlog::set_level(spdlog::level::trace); }
+};
+
+/**
+ * By default, the listener sleeps in `poll()`.
+ */
+TEST_F(BusyPollTest, defaults) {
+  BusyPoll busyPoll;
+  EXPECT_FALSE(busyPoll.enabled);
+  EXPECT_EQ(busyPoll.cpu, -1);
+  EXPECT_EQ(busyPoll.backoff, Backoff::pause);
+}
+
+/**
+ * The pauses double with each idle poll, up to the maximum, and fall back on reset.
+ */
+TEST_F(BusyPollTest, pauseBackoff) {
+  IdleBackoff backoff{Backoff::pause};
+  EXPECT_EQ(backoff.pauses(), 1);
+  backoff.idle();
+  EXPECT_EQ(backoff.pauses(), 2);
+  backoff.idle();
+  EXPECT_EQ(backoff.pauses(), 4);
+  for (int i = 0; i < 20; i++) {
+    backoff.idle();
+  }
+  EXPECT_EQ(backoff.pauses(), IdleBackoff::MAX_PAUSES);
+  backoff.reset();
+  EXPECT_EQ(backoff.pauses(), 1);
+}
+
+/**
+ * The yield strategy pauses like the pause strategy, then stays at the maximum and yields.
+ */
+TEST_F(BusyPollTest, yieldBackoff) {
+  IdleBackoff backoff{Backoff::yield};
+  for (int i = 0; i < 20; i++) {
+    backoff.idle();
+  }
+  EXPECT_EQ(backoff.pauses(), IdleBackoff::MAX_PAUSES);
+  backoff.idle();
+  EXPECT_EQ(backoff.pauses(), IdleBackoff::MAX_PAUSES);
+  backoff.reset();
+  EXPECT_EQ(backoff.pauses(), 1);
+}
+
+/**
+ * The spin strategy never waits.
+ */
+TEST_F(BusyPollTest, spinBackoff) {
+  IdleBackoff backoff{Backoff::spin};
+  for (int i = 0; i < 20; i++) {
+    backoff.idle();
+  }
+  EXPECT_EQ(backoff.pauses(), 1);
+}
+
+} // namespace unitTests
@@ -0,0 +1,321 @@
+/*
+ * File: controller_coalescer_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "controller_coalescer.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace unitTests {
+using namespace a2jmidi;
+
+class ControllerCoalescerTest : public ::testing::Test {
+protected:
+  static constexpr int nFrames = 64;
+  StagingBuffer staging{nFrames};
+  ControllerCoalescer coalescer;
+
+  ControllerCoalescerTest() { spdlog::set_level(spdlog::level::trace); }
+
+  void add(TimePoint timeStamp, int frame, std::vector<unsigned char> message) {
+    ASSERT_TRUE(coalescer.add(staging, timeStamp, frame, message.data(),
+                              static_cast<int>(message.size())));
+  }
+
+  /**
+   * @return the written events as (frame, bytes...) and start the next cycle.
+   */
+  std::vector<std::vector<int>> written() {
+    std::vector<std::vector<int>> result;
+    staging.sort();
+    staging.forEach([&](int frame, const unsigned char *data, int size) {
+      std::vector<int> event{frame};
+      event.insert(event.end(), data, data + size);
+      result.push_back(event);
+      return 0;
+    });
+    staging.clear();
+    coalescer.beginCycle();
+    return result;
+  }
+};
+
+/**
+ * Switched off, the coalescer is transparent.
+ */
+TEST_F(ControllerCoalescerTest, transparent) {
+  coalescer.beginCycle();
+  add(100, 0, {0xB0, 1, 10});
+  add(101, 1, {0xB0, 1, 11});
+  add(102, 2, {0x90, 60, 100});
+  EXPECT_EQ(written().size(), 3);
+  EXPECT_EQ(coalescer.coalescedCount(), 0);
+}
+
+/**
+ * Only the last value per key and cycle is written, at the position of the last value;
+ * other keys and the notes on other channels are not affected.
+ */
+TEST_F(ControllerCoalescerTest, coalesce) {
+  coalescer.setCoalescing(true);
+  coalescer.beginCycle();
+  add(100, 0, {0xB0, 1, 10});
+  add(101, 1, {0xB1, 1, 20});
+  add(102, 2, {0x92, 60, 100});
+  add(103, 3, {0xB0, 1, 11});
+  add(104, 4, {0xD0, 30});
+  add(105, 5, {0xB0, 1, 12});
+  add(106, 6, {0xD0, 31});
+  auto events = written();
+  const std::vector<std::vector<int>> expected{
+      {1, 0xB1, 1, 20}, {2, 0x92, 60, 100}, {5, 0xB0, 1, 12}, {6, 0xD0, 31}};
+  EXPECT_EQ(events, expected);
+  EXPECT_EQ(coalescer.coalescedCount(), 3);
+
+  // the next cycle starts afresh.
+  add(164, 0, {0xB0, 1, 13});
+  EXPECT_EQ(written().size(), 1);
+}
+
+/**
+ * A value is not moved past a note on its channel: the values before and after the note
+ * are both written.
+ */
+TEST_F(ControllerCoalescerTest, noteEndsCoalescing) {
+  coalescer.setCoalescing(true);
+  coalescer.beginCycle();
+  add(100, 0, {0xB0, 1, 10});
+  add(101, 1, {0x90, 60, 100});
+  add(102, 2, {0xB0, 1, 11});
+  add(103, 3, {0xB0, 1, 12});
+  auto events = written();
+  const std::vector<std::vector<int>> expected{
+      {0, 0xB0, 1, 10}, {1, 0x90, 60, 100}, {3, 0xB0, 1, 12}};
+  EXPECT_EQ(events, expected);
+  EXPECT_EQ(coalescer.coalescedCount(), 1);
+}
+
+/**
+ * (N)RPN data entry is never coalesced: each value belongs to the parameter selected just
+ * before it.
+ */
+TEST_F(ControllerCoalescerTest, parameterNumbers) {
+  coalescer.setCoalescing(true);
+  coalescer.beginCycle();
+  const std::vector<std::vector<int>> expected{
+      {0, 0xB0, 101, 0}, {1, 0xB0, 100, 0}, {2, 0xB0, 6, 2},  {3, 0xB0, 38, 0},
+      {4, 0xB0, 99, 1},  {5, 0xB0, 98, 8},  {6, 0xB0, 6, 64}, {7, 0xB0, 38, 0},
+      {8, 0xB0, 96, 0},  {9, 0xB0, 97, 0}};
+  for (const auto &event : expected) {
+    add(100 + event[0], event[0],
+        {static_cast<unsigned char>(event[1]), static_cast<unsigned char>(event[2]),
+         static_cast<unsigned char>(event[3])});
+  }
+  EXPECT_EQ(written(), expected);
+  EXPECT_EQ(coalescer.coalescedCount(), 0);
+}
+
+/**
+ * With a minimum interval, early values are held back; the latest one is written when the
+ * interval has elapsed, possibly in a later cycle.
+ */
+TEST_F(ControllerCoalescerTest, rateLimit) {
+  constexpr TimePoint interval = 100;
+  coalescer.setMinInterval(interval);
+  CycleWindow window = previousCycleWindow(1000, nFrames); // frames 936...999
+  coalescer.beginCycle();
+  add(940, 4, {0xE0, 0, 1});
+  add(950, 14, {0xE0, 0, 2});
+  add(960, 24, {0xE0, 0, 3});
+  add(970, 34, {0x90, 60, 100});
+  EXPECT_EQ(coalescer.flush(staging, window), 0);
+  auto events = written();
+  EXPECT_EQ(events.size(), 2);
+  EXPECT_EQ(events[0], (std::vector<int>{4, 0xE0, 0, 1}));
+
+  // the held value (3) is due at 1040.
+  window = previousCycleWindow(1064, nFrames); // 1000...1063
+  add(1010, 10, {0xB0, 7, 50});
+  EXPECT_EQ(coalescer.flush(staging, window), 0);
+  events = written();
+  const std::vector<std::vector<int>> expected{{10, 0xB0, 7, 50}, {40, 0xE0, 0, 3}};
+  EXPECT_EQ(events, expected);
+  EXPECT_EQ(coalescer.heldCount(), 2);
+
+  // nothing is held back any more.
+  window = previousCycleWindow(1128, nFrames);
+  EXPECT_EQ(coalescer.flush(staging, window), 0);
+  EXPECT_TRUE(written().empty());
+}
+
+/**
+ * A value that is due supersedes the held one; after a resynchronisation nothing is held.
+ */
+TEST_F(ControllerCoalescerTest, supersedeAndResynchronize) {
+  coalescer.setMinInterval(100);
+  CycleWindow window = previousCycleWindow(1000, nFrames);
+  coalescer.beginCycle();
+  add(900, 0, {0xB0, 1, 1});
+  add(950, 1, {0xB0, 1, 2});  // held
+  add(1000, 2, {0xB0, 1, 3}); // due, supersedes the held value
+  add(1010, 3, {0xB0, 1, 4}); // held
+  coalescer.resynchronize();
+  EXPECT_EQ(coalescer.flush(staging, window), 0);
+  auto events = written();
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_EQ(events[1][3], 3);
+
+  // after the resynchronisation, the first value passes at once.
+  add(20, 0, {0xB0, 1, 5});
+  EXPECT_EQ(written().size(), 1);
+
+  coalescer.reset();
+  EXPECT_EQ(coalescer.heldCount(), 0);
+}
+
+/**
+ * A recorded MPE performance: one event of the stream.
+ */
+struct RecordedEvent {
+  TimePoint timeStamp;
+  std::vector<unsigned char> data;
+};
+
+/**
+ * Stand-in for a recording of an MPE controller (48 kHz): four fingers held on member
+ * channels 2...5, each sending pitch bend, timbre (CC 74) and channel pressure every
+ * 12 frames (4 kHz), with a note-on and note-off every half second per finger.
+ */
+std::vector<RecordedEvent> recordMpeStream(TimePoint duration) {
+  constexpr int fingers = 4;
+  constexpr TimePoint period = 12;
+  constexpr TimePoint noteLength = 24000;
+  std::mt19937 random{4711};
+  std::uniform_int_distribution<int> jitter{0, 3};
+  std::vector<RecordedEvent> stream;
+  for (TimePoint t = 0; t < duration; t += period) {
+    for (int finger = 0; finger < fingers; finger++) {
+      const auto channel = static_cast<unsigned char>(1 + finger);
+      const TimePoint at = t + finger * 3 + jitter(random);
+      const auto phase = static_cast<double>(t) / 4800.0 + finger;
+      const auto bend = static_cast<int>(8192 + 2000 * std::sin(phase));
+      const auto level = static_cast<unsigned char>(64 + 60 * std::sin(phase * 0.7));
+      if (t % noteLength == 0) {
+        if (t > 0) {
+          stream.push_back({at, {static_cast<unsigned char>(0x80 | channel), 60, 0}});
+        }
+        stream.push_back({at, {static_cast<unsigned char>(0x90 | channel), 60, 100}});
+      }
+      stream.push_back({at,
+                        {static_cast<unsigned char>(0xE0 | channel),
+                         static_cast<unsigned char>(bend & 0x7F),
+                         static_cast<unsigned char>(bend >> 7)}});
+      stream.push_back({at, {static_cast<unsigned char>(0xB0 | channel), 74, level}});
+      stream.push_back({at, {static_cast<unsigned char>(0xD0 | channel), level}});
+    }
+  }
+  std::stable_sort(stream.begin(), stream.end(),
+                   [](const auto &a, const auto &b) { return a.timeStamp < b.timeStamp; });
+  return stream;
+}
+
+struct ReplayResult {
+  long written{0};
+  long notes{0};
+  double nsPerCycle{0.0};
+};
+
+/**
+ * Replay the stream through the staging path of the process callback (64 frames).
+ */
+ReplayResult replay(const std::vector<RecordedEvent> &stream, TimePoint duration,
+                    bool coalesce, TimePoint minInterval) {
+  constexpr int nFrames = 64;
+  StagingBuffer staging{nFrames};
+  ControllerCoalescer coalescer;
+  coalescer.setCoalescing(coalesce);
+  coalescer.setMinInterval(minInterval);
+  std::vector<unsigned char> jackBuffer(64 * 1024);
+  ReplayResult result;
+  size_t next = 0;
+  const int cycles = static_cast<int>(duration / nFrames);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int cycle = 1; cycle <= cycles; cycle++) {
+    const CycleWindow window = previousCycleWindow(cycle * nFrames, nFrames);
+    coalescer.beginCycle();
+    for (; next < stream.size() && stream[next].timeStamp < window.deadline; next++) {
+      const RecordedEvent &event = stream[next];
+      coalescer.add(staging, event.timeStamp, placeEvent(window, event.timeStamp),
+                    event.data.data(), static_cast<int>(event.data.size()));
+    }
+    coalescer.flush(staging, window);
+    staging.sort();
+    size_t used = 0;
+    staging.forEach([&](int frame, const unsigned char *data, int size) {
+      // what jack_midi_event_write does: copy the event into the port buffer.
+      std::memcpy(&jackBuffer[used], data, size);
+      used += size;
+      result.written++;
+      result.notes += ((data[0] & 0xE0U) == 0x80) ? 1 : 0;
+      return 0;
+    });
+    staging.clear();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  result.nsPerCycle =
+      static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+      cycles;
+  return result;
+}
+
+/**
+ * Benchmark: the events written, and the time spent per cycle, on one minute of MPE input.
+ */
+TEST_F(ControllerCoalescerTest, mpeBenchmark) {
+  constexpr TimePoint duration = 60 * 48000;
+  const auto stream = recordMpeStream(duration);
+
+  auto plain = replay(stream, duration, false, 0);
+  auto coalesced = replay(stream, duration, true, 0);
+  auto limited = replay(stream, duration, true, 96); // 2 ms
+
+  SPDLOG_INFO("mpeBenchmark - {} events recorded.", stream.size());
+  SPDLOG_INFO("mpeBenchmark - unchanged:      {} events written, {} ns per cycle.",
+              plain.written, plain.nsPerCycle);
+  SPDLOG_INFO("mpeBenchmark - coalesced:      {} events written, {} ns per cycle.",
+              coalesced.written, coalesced.nsPerCycle);
+  SPDLOG_INFO("mpeBenchmark - limited (2 ms): {} events written, {} ns per cycle.",
+              limited.written, limited.nsPerCycle);
+
+  EXPECT_EQ(plain.written, static_cast<long>(stream.size()));
+  // no note is ever lost.
+  EXPECT_EQ(coalesced.notes, plain.notes);
+  EXPECT_EQ(limited.notes, plain.notes);
+  // more than 5 values per key and cycle are sent, only one remains.
+  EXPECT_LT(coalesced.written, plain.written / 4);
+  EXPECT_LT(limited.written, coalesced.written);
+}
+
+} // namespace unitTests
@@ -0,0 +1,208 @@
+/*
+ * File: delay_locked_loop_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "delay_locked_loop.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+namespace unitTests {
+
+/**
+ * Simulates an audio interface whose sample clock drifts against the system clock.
+ */
+class DriftingInterface {
+private:
+  const double m_nominalRate;
+  const std::uint32_t m_periodFrames;
+  std::mt19937 m_random{4711};
+  std::uniform_real_distribution<double> m_jitter;
+
+public:
+  double time;               ///< the exact system time (usecs) at the start of the current cycle.
+  std::int64_t frame;        ///< the exact frame count at the start of the current cycle.
+  double deviationPpm{0.0};  ///< the deviation of the actual sample rate from the nominal rate.
+
+  DriftingInterface(double nominalRate, std::uint32_t periodFrames, double startTime,
+                    std::int64_t startFrame, double jitterUsecs)
+      : m_nominalRate{nominalRate}, m_periodFrames{periodFrames},
+        m_jitter{-jitterUsecs, jitterUsecs}, time{startTime}, frame{startFrame} {}
+
+  double actualRate() const { return m_nominalRate * (1.0 + deviationPpm * 1e-6); }
+
+  /**
+   * Advance to the next cycle.
+   */
+  void nextCycle() {
+    time += 1e6 * m_periodFrames / actualRate();
+    frame += m_periodFrames;
+  }
+
+  /**
+   * @return the cycle start time as JACK would report it (rounded and with jitter).
+   */
+  std::uint64_t reportedTime() { return std::llround(time + m_jitter(m_random)); }
+
+  /**
+   * @return the exact frame position at a given time within the current cycle.
+   */
+  double framePosition(std::uint64_t usecs) const {
+    return static_cast<double>(frame) + (static_cast<double>(usecs) - time) * actualRate() / 1e6;
+  }
+};
+
+class DelayLockedLoopTest : public ::testing::Test {
+protected:
+  static constexpr double SAMPLE_RATE = 48000.0;
+  static constexpr std::uint32_t PERIOD = 256;
+  static constexpr double THREE_DAYS_USECS = 3.0 * 24 * 3600 * 1e6;
+
+  DelayLockedLoopTest() { spdlog::set_level(spdlog::level::trace); }
+};
+
+/**
+ * The frame count continues beyond the 32 bit range.
+ */
+TEST_F(DelayLockedLoopTest, wrapAround) {
+  a2jmidi::DelayLockedLoop dll;
+  EXPECT_FALSE(dll.isValid());
+
+  std::int64_t frame = 0xFFFFFF00; // close to the 32 bit limit.
+  std::uint64_t usecs = 1000000;
+  for (int i = 0; i < 10; i++) {
+    dll.update(static_cast<std::uint32_t>(frame), usecs, PERIOD, SAMPLE_RATE);
+    EXPECT_EQ(dll.cycleStartFrame(), frame);
+    frame += PERIOD;
+    usecs += std::llround(1e6 * PERIOD / SAMPLE_RATE);
+  }
+  EXPECT_TRUE(dll.isValid());
+  EXPECT_GT(dll.cycleStartFrame(), 0xFFFFFFFFLL);
+}
+
+/**
+ * After settling, the loop follows an interface that drifts by up to 100 ppm
+ * with an error of less than one frame, in spite of jitter on the reported times.
+ */
+TEST_F(DelayLockedLoopTest, driftingClock) {
+  a2jmidi::DelayLockedLoop dll;
+  DriftingInterface interface{SAMPLE_RATE, PERIOD, THREE_DAYS_USECS, 0xFFF00000, 20.0};
+  interface.deviationPpm = 100.0;
+
+  constexpr int settlingCycles = 20 * 48000 / 256;   // 20 seconds
+  constexpr int measuringCycles = 600 * 48000 / 256; // 10 minutes
+  double maxError = 0.0;
+  for (int i = 0; i < settlingCycles + measuringCycles; i++) {
+    if (i > settlingCycles) {
+      // the drift changes slowly from +100 ppm to -100 ppm.
+      interface.deviationPpm = 100.0 - 200.0 * (i - settlingCycles) / measuringCycles;
+    }
+    dll.update(static_cast<std::uint32_t>(interface.frame), interface.reportedTime(), PERIOD,
+               SAMPLE_RATE);
+    ASSERT_EQ(dll.cycleStartFrame(), interface.frame);
+
+    if (i > settlingCycles) {
+      // probe the middle of the cycle.
+      auto probe = static_cast<std::uint64_t>(interface.time + 0.5e6 * PERIOD / SAMPLE_RATE);
+      double error = std::abs(dll.framePosition(probe) - interface.framePosition(probe));
+      maxError = std::max(maxError, error);
+    }
+    interface.nextCycle();
+  }
+  SPDLOG_INFO("driftingClock - maximum error {} frames", maxError);
+  EXPECT_LT(maxError, 1.0);
+}
+
+/**
+ * When cycles are lost (xrun), the loop restarts and quickly becomes accurate again.
+ */
+TEST_F(DelayLockedLoopTest, restartAfterXrun) {
+  a2jmidi::DelayLockedLoop dll;
+  DriftingInterface interface{SAMPLE_RATE, PERIOD, THREE_DAYS_USECS, 0, 0.0};
+  interface.deviationPpm = -50.0;
+
+  for (int i = 0; i < 1000; i++) {
+    dll.update(static_cast<std::uint32_t>(interface.frame), interface.reportedTime(), PERIOD,
+               SAMPLE_RATE);
+    interface.nextCycle();
+  }
+  // three cycles are lost.
+  interface.nextCycle();
+  interface.nextCycle();
+  interface.nextCycle();
+  // an xrun is not a discontinuity.
+  EXPECT_FALSE(dll.update(static_cast<std::uint32_t>(interface.frame), interface.reportedTime(),
+                          PERIOD, SAMPLE_RATE));
+  EXPECT_EQ(dll.discontinuityCount(), 0);
+  EXPECT_EQ(dll.cycleStartFrame(), interface.frame);
+
+  auto probe = static_cast<std::uint64_t>(interface.time + 0.5e6 * PERIOD / SAMPLE_RATE);
+  EXPECT_NEAR(dll.framePosition(probe), interface.framePosition(probe), 1.0);
+}
+
+/**
+ * When the system has been suspended, the next cycle comes much later than expected.
+ * The discontinuity is reported once and the loop restarts from the new cycle.
+ */
+TEST_F(DelayLockedLoopTest, suspendResume) {
+  a2jmidi::DelayLockedLoop dll;
+  DriftingInterface interface{SAMPLE_RATE, PERIOD, THREE_DAYS_USECS, 0, 0.0};
+
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_FALSE(dll.update(static_cast<std::uint32_t>(interface.frame),
+                            interface.reportedTime(), PERIOD, SAMPLE_RATE));
+    interface.nextCycle();
+  }
+  // thirty seconds of suspension, the interface has stopped counting.
+  interface.time += 30e6;
+  EXPECT_TRUE(dll.update(static_cast<std::uint32_t>(interface.frame), interface.reportedTime(),
+                         PERIOD, SAMPLE_RATE));
+  EXPECT_EQ(dll.discontinuityCount(), 1);
+  EXPECT_EQ(dll.cycleStartFrame(), interface.frame);
+
+  auto probe = static_cast<std::uint64_t>(interface.time + 0.5e6 * PERIOD / SAMPLE_RATE);
+  EXPECT_NEAR(dll.framePosition(probe), interface.framePosition(probe), 1.0);
+
+  interface.nextCycle();
+  EXPECT_FALSE(dll.update(static_cast<std::uint32_t>(interface.frame), interface.reportedTime(),
+                          PERIOD, SAMPLE_RATE));
+  EXPECT_EQ(dll.discontinuityCount(), 1);
+}
+
+/**
+ * When the frame count goes backwards (e.g. the server has been restarted), the
+ * unwrapped frame count is re-based and keeps increasing.
+ */
+TEST_F(DelayLockedLoopTest, backwardJump) {
+  a2jmidi::DelayLockedLoop dll;
+  std::int64_t frame = 1000000;
+  std::uint64_t usecs = 1000000;
+  for (int i = 0; i < 10; i++) {
+    dll.update(static_cast<std::uint32_t>(frame), usecs, PERIOD, SAMPLE_RATE);
+    frame += PERIOD;
+    usecs += std::llround(1e6 * PERIOD / SAMPLE_RATE);
+  }
+  const std::int64_t before = dll.cycleStartFrame();
+  EXPECT_TRUE(dll.update(0, usecs, PERIOD, SAMPLE_RATE));
+  EXPECT_EQ(dll.cycleStartFrame(), before + PERIOD);
+  EXPECT_EQ(dll.discontinuityCount(), 1);
+}
+
+} // namespace unitTests
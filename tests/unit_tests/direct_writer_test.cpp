@@ -0,0 +1,199 @@
+/*
+ * File: direct_writer_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "direct_writer.h"
+#include "staging_buffer.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace unitTests {
+using namespace a2jmidi;
+
+/**
+ * Mimics a JACK MIDI buffer: the events must be written in order, each takes a header
+ * plus its bytes.
+ */
+struct FakeJackBuffer {
+  static constexpr int HEADER_SIZE = 8;
+  std::vector<unsigned char> bytes;
+  std::vector<int> frames;
+  int used{0};
+
+  explicit FakeJackBuffer(int capacity) : bytes(capacity) { frames.reserve(4096); }
+  void clear() {
+    frames.clear();
+    used = 0;
+  }
+  int freeSpace() const {
+    return std::max(0, static_cast<int>(bytes.size()) - used - HEADER_SIZE);
+  }
+  unsigned char *reserve(int frame, int size) {
+    if (size > freeSpace() || (!frames.empty() && frame < frames.back())) {
+      return nullptr;
+    }
+    frames.push_back(frame);
+    unsigned char *result = &bytes[used];
+    used += size + HEADER_SIZE;
+    return result;
+  }
+  /// what `jack_midi_event_write` does.
+  int write(int frame, const unsigned char *data, int size) {
+    unsigned char *reserved = reserve(frame, size);
+    if (!reserved) {
+      return -1;
+    }
+    std::memcpy(reserved, data, size);
+    return 0;
+  }
+};
+
+struct FakeSink {
+  FakeJackBuffer *buffer{nullptr};
+  unsigned char *reserve(int frame, int size) const { return buffer->reserve(frame, size); }
+  int freeSpace() const { return buffer->freeSpace(); }
+};
+
+class DirectWriterTest : public ::testing::Test {
+protected:
+  DirectWriterTest() { spdlog::set_level(spdlog::level::trace); }
+};
+
+/**
+ * Events in order are written directly; the first event out of order ends the direct path.
+ */
+TEST_F(DirectWriterTest, outOfOrder) {
+  FakeJackBuffer buffer{1024};
+  DirectWriter<FakeSink> writer;
+  const unsigned char noteOn[] = {0x90, 60, 100};
+
+  writer.beginCycle(FakeSink{&buffer}, true, 0);
+  EXPECT_TRUE(writer.write(0, noteOn, 3));
+  EXPECT_TRUE(writer.write(10, noteOn, 3));
+  EXPECT_TRUE(writer.write(10, noteOn, 3));
+  EXPECT_FALSE(writer.write(5, noteOn, 3));
+  EXPECT_FALSE(writer.active());
+  EXPECT_FALSE(writer.write(20, noteOn, 3)); // all following events are staged.
+  EXPECT_EQ(writer.lastFrame(), 10);
+  EXPECT_EQ(buffer.frames, (std::vector<int>{0, 10, 10}));
+  EXPECT_EQ(buffer.bytes[0], 0x90);
+
+  // the next cycle starts afresh, unless disabled.
+  buffer.clear();
+  writer.beginCycle(FakeSink{&buffer}, false, 0);
+  EXPECT_FALSE(writer.write(0, noteOn, 3));
+  writer.beginCycle(FakeSink{&buffer}, true, 0);
+  EXPECT_EQ(writer.lastFrame(), 0);
+  EXPECT_TRUE(writer.write(0, noteOn, 3));
+}
+
+/**
+ * The direct path ends when the free space falls below the threshold.
+ */
+TEST_F(DirectWriterTest, lowSpace) {
+  FakeJackBuffer buffer{128};
+  DirectWriter<FakeSink> writer;
+  const unsigned char noteOn[] = {0x90, 60, 100};
+  writer.beginCycle(FakeSink{&buffer}, true, 32);
+  int written = 0;
+  while (writer.write(written, noteOn, 3)) {
+    written++;
+  }
+  EXPECT_GE(buffer.freeSpace(), 32);
+  EXPECT_LT(buffer.freeSpace() - 3, 32);
+  EXPECT_EQ(written, static_cast<int>(buffer.frames.size()));
+}
+
+/**
+ * An event as the receiver queue holds it.
+ */
+struct Record {
+  int frame;
+  int size;
+  unsigned char data[16];
+};
+
+/**
+ * Benchmark: one cycle of the process callback (without retrieval), at 10, 100 and 1000
+ * events per period; the staged path (copy into the staging buffer, sort, copy into JACK)
+ * versus the direct path (copy into JACK).
+ */
+TEST_F(DirectWriterTest, cycleBenchmark) {
+  constexpr int nFrames = 256;
+  std::mt19937 random{4711};
+  for (int eventsPerCycle : {10, 100, 1000}) {
+    const int cycles = 2000000 / eventsPerCycle;
+    std::uniform_int_distribution<int> anyFrame{0, nFrames - 1};
+    std::vector<Record> records(eventsPerCycle);
+    std::vector<int> frames(eventsPerCycle);
+    for (int &frame : frames) {
+      frame = anyFrame(random);
+    }
+    std::sort(frames.begin(), frames.end()); // live input comes in order.
+    for (int i = 0; i < eventsPerCycle; i++) {
+      records[i] = Record{frames[i], 3, {0x90, static_cast<unsigned char>(i & 0x7F), 100}};
+    }
+    FakeJackBuffer buffer{32 * 1024};
+    StagingBuffer staging{nFrames};
+    DirectWriter<FakeSink> writer;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int cycle = 0; cycle < cycles; cycle++) {
+      buffer.clear();
+      for (const Record &record : records) {
+        staging.add(record.frame, record.data, record.size);
+      }
+      staging.sort();
+      staging.forEach([&buffer](int frame, const unsigned char *data, int size) {
+        return buffer.write(frame, data, size);
+      });
+      staging.clear();
+    }
+    const auto stagedTime = std::chrono::steady_clock::now() - start;
+    const auto stagedCount = buffer.frames.size();
+
+    start = std::chrono::steady_clock::now();
+    for (int cycle = 0; cycle < cycles; cycle++) {
+      buffer.clear();
+      writer.beginCycle(FakeSink{&buffer}, true, 0);
+      for (const Record &record : records) {
+        if (!writer.write(record.frame, record.data, record.size)) {
+          staging.add(record.frame, record.data, record.size);
+        }
+      }
+    }
+    const auto directTime = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(buffer.frames.size(), stagedCount);
+    EXPECT_TRUE(staging.empty());
+
+    using std::chrono::nanoseconds;
+    const double stagedNs =
+        static_cast<double>(std::chrono::duration_cast<nanoseconds>(stagedTime).count()) / cycles;
+    const double directNs =
+        static_cast<double>(std::chrono::duration_cast<nanoseconds>(directTime).count()) / cycles;
+    SPDLOG_INFO("cycleBenchmark - {} events per cycle: staged {} ns, direct {} ns per cycle.",
+                eventsPerCycle, stagedNs, directNs);
+  }
+}
+
+} // namespace unitTests
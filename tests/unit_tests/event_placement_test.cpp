@@ -0,0 +1,215 @@
+/*
+ * File: event_placement_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "event_placement.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <deque>
+#include <random>
+
+namespace unitTests {
+using namespace a2jmidi;
+
+class EventPlacementTest : public ::testing::Test {
+protected:
+  EventPlacementTest() { spdlog::set_level(spdlog::level::trace); }
+};
+
+/**
+ * In the classic placement, the events of the previous cycle keep their spacing.
+ */
+TEST_F(EventPlacementTest, previousCycle) {
+  constexpr int nFrames = 256;
+  auto window = previousCycleWindow(10000, nFrames);
+  EXPECT_EQ(window.deadline, 10000);
+  EXPECT_EQ(placeEvent(window, 10000 - nFrames), 0);
+  EXPECT_EQ(placeEvent(window, 10000 - 1), nFrames - 1);
+  EXPECT_EQ(placeEvent(window, 10000 - 100), nFrames - 100);
+  // too late: moved to the start.
+  EXPECT_EQ(placeEvent(window, 10000 - nFrames - 10), 0);
+  // more than a buffer too late: discarded.
+  EXPECT_EQ(placeEvent(window, 10000 - 3 * nFrames), DISCARD_EVENT);
+  // beyond the deadline: moved to the end.
+  EXPECT_EQ(placeEvent(window, 10000 + 10), nFrames - 1);
+}
+
+/**
+ * In low latency placement, events recorded after the cycle start keep their position;
+ * older events go to the start of the buffer.
+ */
+TEST_F(EventPlacementTest, currentCycle) {
+  constexpr int nFrames = 256;
+  auto window = currentCycleWindow(10000, 10020, nFrames);
+  EXPECT_EQ(window.deadline, 10020);
+  EXPECT_EQ(placeEvent(window, 10000), 0);
+  EXPECT_EQ(placeEvent(window, 10019), 19);
+  EXPECT_EQ(placeEvent(window, 9900), 0);
+  // not yet visible to the previous callback: still emitted.
+  EXPECT_EQ(placeEvent(window, 10000 - nFrames - 10), 0);
+  EXPECT_EQ(placeEvent(window, 10000 - 3 * nFrames), DISCARD_EVENT);
+}
+
+/**
+ * In constant latency placement, every event is delayed by exactly the fixed delay, so the
+ * spacing between events is preserved; events that miss their slot go to the start.
+ */
+TEST_F(EventPlacementTest, constantLatency) {
+  constexpr int nFrames = 256;
+  constexpr int delay = 300;
+  auto window = constantLatencyWindow(10000, delay, nFrames);
+  EXPECT_EQ(window.bufferStart, 10000 - delay);
+  EXPECT_EQ(window.deadline, 10000 - delay + nFrames);
+  // the positions differ exactly as the time stamps do.
+  EXPECT_EQ(placeEvent(window, 9700), 0);
+  EXPECT_EQ(placeEvent(window, 9713) - placeEvent(window, 9701), 12);
+  EXPECT_EQ(placeEvent(window, 9955), nFrames - 1);
+  // missed slot: moved to the start.
+  EXPECT_EQ(placeEvent(window, 9690), 0);
+  EXPECT_EQ(placeEvent(window, 9700 - 2 * nFrames), DISCARD_EVENT);
+}
+
+/**
+ * A fixed delay shorter than a period plus the wake-up delay is raised to that minimum.
+ */
+TEST_F(EventPlacementTest, usableFixedDelay) {
+  constexpr int nFrames = 256;
+  EXPECT_EQ(usableFixedDelay(0, nFrames, 0), nFrames);
+  EXPECT_EQ(usableFixedDelay(100, nFrames, 16), nFrames + 16);
+  EXPECT_EQ(usableFixedDelay(nFrames + 16, nFrames, 16), nFrames + 16);
+  EXPECT_EQ(usableFixedDelay(1000, nFrames, 16), 1000);
+}
+
+/**
+ * The latency reported to JACK matches the placement of an event that is on time.
+ */
+TEST_F(EventPlacementTest, placementLatency) {
+  constexpr int nFrames = 256;
+  constexpr int compensation = 16;
+  constexpr TimePoint cycleStart = 10000;
+  constexpr TimePoint timeStamp = 9800;
+
+  auto previous = placementLatency(Placement::previousCycle, nFrames, compensation, 0);
+  auto window = previousCycleWindow(cycleStart - compensation, nFrames);
+  EXPECT_EQ(previous.min, cycleStart + placeEvent(window, timeStamp) - timeStamp);
+  EXPECT_EQ(previous.max, previous.min);
+
+  auto current = placementLatency(Placement::currentCycle, nFrames, compensation, 0);
+  EXPECT_EQ(current.min, 0);
+  EXPECT_EQ(current.max, nFrames);
+
+  auto constant = placementLatency(Placement::constantLatency, nFrames, compensation, 300);
+  window = constantLatencyWindow(cycleStart, 300, nFrames);
+  EXPECT_EQ(constant.min, cycleStart + placeEvent(window, 9750) - 9750);
+  EXPECT_EQ(constant.max, 300);
+}
+
+/**
+ * The result of simulating the bridge with one placement mode.
+ */
+struct LatencyStatistics {
+  int delivered{0};
+  double meanLatencyMs{0.0};
+  double maxLatencyMs{0.0};
+  bool ordered{true}; ///< JACK requires non decreasing positions within a buffer.
+};
+
+/**
+ * Simulate live input through the bridge: events arrive at random times, become
+ * visible to the process callback after a random listener delay, and the process callback
+ * itself is woken up with a random delay after the cycle start.
+ * The latency is measured from the time stamp of an event to its frame in the JACK timeline.
+ */
+LatencyStatistics simulate(Placement placement, int nFrames, double sampleRate, int cycles) {
+  constexpr TimePoint compensation = 16;
+  // separate generators, so that both modes see exactly the same input.
+  std::mt19937 eventRandom{4711};
+  std::mt19937 wakeUpRandom{815};
+  std::exponential_distribution<double> interval{1.0 / (0.02 * sampleRate)}; // every 20 ms
+  std::uniform_int_distribution<TimePoint> listenerDelay{0, 24};
+  std::uniform_int_distribution<TimePoint> wakeUpDelay{0, 32};
+
+  struct Event {
+    TimePoint timeStamp;
+    TimePoint visibleAt;
+  };
+  std::deque<Event> pending;
+  TimePoint nextEvent = 0;
+  LatencyStatistics result;
+  double latencySum = 0.0;
+
+  for (int cycle = 1; cycle <= cycles; cycle++) {
+    const TimePoint cycleStart = static_cast<TimePoint>(cycle) * nFrames;
+    const TimePoint processStart = cycleStart + wakeUpDelay(wakeUpRandom);
+    while (nextEvent < processStart) {
+      pending.push_back(Event{nextEvent, nextEvent + listenerDelay(eventRandom)});
+      nextEvent += 1 + static_cast<TimePoint>(interval(eventRandom));
+    }
+    const CycleWindow window = (placement == Placement::currentCycle)
+                                   ? currentCycleWindow(cycleStart, processStart, nFrames)
+                                   : previousCycleWindow(cycleStart - compensation, nFrames);
+    int lastPosition = 0;
+    while (!pending.empty() && pending.front().visibleAt <= processStart &&
+           pending.front().timeStamp < window.deadline) {
+      const Event event = pending.front();
+      pending.pop_front();
+      int position = placeEvent(window, event.timeStamp);
+      if (position == DISCARD_EVENT) {
+        continue;
+      }
+      result.ordered = result.ordered && (position >= lastPosition);
+      lastPosition = position;
+      double latencyMs = 1000.0 * static_cast<double>(cycleStart + position - event.timeStamp) /
+                         sampleRate;
+      latencySum += latencyMs;
+      result.maxLatencyMs = std::max(result.maxLatencyMs, latencyMs);
+      result.delivered++;
+    }
+  }
+  result.meanLatencyMs = latencySum / result.delivered;
+  return result;
+}
+
+/**
+ * Compare the latency of both placement modes at 256 frames / 48 kHz.
+ */
+TEST_F(EventPlacementTest, latencyBenchmark) {
+  constexpr int nFrames = 256;
+  constexpr double sampleRate = 48000.0;
+  constexpr int cycles = 60 * 48000 / nFrames; // one minute
+
+  auto previous = simulate(Placement::previousCycle, nFrames, sampleRate, cycles);
+  auto current = simulate(Placement::currentCycle, nFrames, sampleRate, cycles);
+
+  SPDLOG_INFO("latencyBenchmark - previous cycle: {} events, mean {} ms, max {} ms",
+              previous.delivered, previous.meanLatencyMs, previous.maxLatencyMs);
+  SPDLOG_INFO("latencyBenchmark - current cycle:  {} events, mean {} ms, max {} ms",
+              current.delivered, current.meanLatencyMs, current.maxLatencyMs);
+  SPDLOG_INFO("latencyBenchmark - mean latency saved {} ms",
+              previous.meanLatencyMs - current.meanLatencyMs);
+
+  EXPECT_TRUE(previous.ordered);
+  EXPECT_TRUE(current.ordered);
+  EXPECT_NEAR(previous.delivered, current.delivered, 2);
+  // one period is 5.33 ms. On average, the low latency mode saves more than half of it.
+  EXPECT_GT(previous.meanLatencyMs - current.meanLatencyMs, 0.5 * 1000.0 * nFrames / sampleRate);
+  EXPECT_LE(current.maxLatencyMs, previous.maxLatencyMs);
+}
+
+} // namespace unitTests
@@ -21,6 +21,7 @@
 #include "jack_client.h"
 #include "spdlog/spdlog.h"
 #include "sys_clock.h"
+#include <atomic>
 #include <chrono>
 #include <climits>
 #include <cstdlib>
@@ -114,6 +115,77 @@ TEST_F(JackClientTest, callback) {
   EXPECT_EQ(jackClient::state(), jackClient::State::idle);
 }
 
+/**
+ * provided the client is open,
+ * the latency reported through the latency callback can be read back from the port,
+ * and it follows the latency function when the latencies are recomputed.
+ */
+TEST_F(JackClientTest, latencyCallback) {
+  using namespace std::chrono_literals;
+  std::atomic<int> addedLatency{100};
+  std::atomic<int> reportedBufferSize{0};
+  auto *port = jackClient::newSenderPort("port");
+
+  jackClient::registerLatencyCallback(port, [&](const int nFrames) {
+    reportedBufferSize = nFrames;
+    jack_latency_range_t range;
+    range.min = addedLatency;
+    range.max = addedLatency + nFrames;
+    return range;
+  });
+  jackClient::activate();
+  std::this_thread::sleep_for(200ms);
+
+  jack_latency_range_t range;
+  jack_port_get_latency_range(port, JackCaptureLatency, &range);
+  EXPECT_GT(reportedBufferSize, 0);
+  EXPECT_EQ(range.min, 100);
+  EXPECT_EQ(range.max, 100 + reportedBufferSize);
+
+  addedLatency = 300;
+  jackClient::recomputeLatencies();
+  std::this_thread::sleep_for(200ms);
+  jack_port_get_latency_range(port, JackCaptureLatency, &range);
+  EXPECT_EQ(range.min, 300);
+  EXPECT_EQ(range.max, 300 + reportedBufferSize);
+
+  jackClient::stop();
+}
+/**
+ * provided the client is running,
+ * a change of the buffer size is announced to the handler before the process callback
+ * receives the new number of frames.
+ */
+TEST_F(JackClientTest, bufferSizeChange) {
+  using namespace std::chrono_literals;
+  std::atomic<int> announcedSize{0};
+  std::atomic<int> processedSize{0};
+  std::atomic<bool> announcedFirst{true};
+
+  jackClient::onBufferSizeChange([&](const int nFrames) { announcedSize = nFrames; });
+  jackClient::registerProcessCallback([&](int nFrames, a2jmidi::TimePoint deadLine) -> int {
+    if (processedSize != 0 && nFrames != processedSize && nFrames != announcedSize) {
+      announcedFirst = false;
+    }
+    processedSize = nFrames;
+    return 0;
+  });
+  jackClient::activate();
+  std::this_thread::sleep_for(200ms);
+
+  const int originalSize = processedSize;
+  const int newSize = (originalSize == 256) ? 512 : 256;
+  EXPECT_EQ(jack_set_buffer_size(jackClient::impl::g_jackClientHandle, newSize), 0);
+  std::this_thread::sleep_for(500ms);
+  EXPECT_EQ(announcedSize, newSize);
+  EXPECT_EQ(processedSize, newSize);
+  EXPECT_TRUE(announcedFirst);
+
+  // leave the server as we found it.
+  jack_set_buffer_size(jackClient::impl::g_jackClientHandle, originalSize);
+  std::this_thread::sleep_for(200ms);
+  jackClient::stop();
+}
 
 /**
  * Implementation specific.
@@ -0,0 +1,132 @@
+/*
+ * File: jitter_estimator_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jitter_estimator.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <random>
+
+namespace unitTests {
+using namespace a2jmidi;
+
+class JitterEstimatorTest : public ::testing::Test {
+protected:
+  JitterEstimatorTest() {
+    spdlog::set_level(spdlog::level::trace);
+    jitter::reset();
+  }
+};
+
+/**
+ * The percentile is the upper edge of the bin in which it is reached.
+ */
+TEST_F(JitterEstimatorTest, histogramPercentile) {
+  jitter::Histogram histogram;
+  EXPECT_EQ(histogram.percentile(50.0), 0);
+
+  for (int i = 0; i < 100; i++) {
+    histogram.add(i * jitter::Histogram::BIN_WIDTH);
+  }
+  EXPECT_EQ(histogram.count(), 100);
+  EXPECT_EQ(histogram.percentile(50.0), 50 * jitter::Histogram::BIN_WIDTH);
+  EXPECT_EQ(histogram.percentile(99.0), 99 * jitter::Histogram::BIN_WIDTH);
+  EXPECT_EQ(histogram.percentile(100.0), 100 * jitter::Histogram::BIN_WIDTH);
+
+  // out of range values go into the first and the last bin.
+  histogram.add(-10);
+  histogram.add(1000000);
+  auto bins = histogram.bins();
+  EXPECT_EQ(bins.front(), 2);
+  EXPECT_EQ(bins.back(), 1);
+}
+
+/**
+ * Old values lose their weight.
+ */
+TEST_F(JitterEstimatorTest, histogramAging) {
+  jitter::Histogram histogram;
+  for (std::uint32_t i = 0; i <= jitter::Histogram::AGING_THRESHOLD; i++) {
+    histogram.add(100);
+  }
+  histogram.age();
+  EXPECT_LE(histogram.count(), jitter::Histogram::AGING_THRESHOLD / 2 + 1);
+
+  // new values now dominate the percentile.
+  for (std::uint32_t i = 0; i <= jitter::Histogram::AGING_THRESHOLD; i++) {
+    histogram.add(10);
+  }
+  EXPECT_EQ(histogram.percentile(50.0), 12);
+}
+
+/**
+ * The compensation stays at its default until enough delays were measured, then
+ * it follows the requested percentile of the delays.
+ */
+TEST_F(JitterEstimatorTest, compensationFollowsPercentile) {
+  EXPECT_EQ(jitter::compensation(), jitter::DEFAULT_COMPENSATION);
+
+  for (std::uint32_t i = 0; i < jitter::MIN_SAMPLE_COUNT - 1; i++) {
+    jitter::addWakeUpDelay(2);
+  }
+  jitter::update();
+  EXPECT_EQ(jitter::compensation(), jitter::DEFAULT_COMPENSATION);
+
+  // a quiet system: the delays are short.
+  std::mt19937 random{4711};
+  std::uniform_int_distribution<TimePoint> shortDelays{0, 7};
+  for (int i = 0; i < 1000; i++) {
+    jitter::addWakeUpDelay(shortDelays(random));
+    jitter::update();
+  }
+  EXPECT_EQ(jitter::compensation(), 8);
+
+  // a loaded system: from now on, one out of ten events is delayed by 100 ticks.
+  jitter::reset(95.0);
+  for (int i = 0; i < 1000; i++) {
+    jitter::addWakeUpDelay(i % 10 ? shortDelays(random) : 100);
+    jitter::update();
+  }
+  EXPECT_EQ(jitter::compensation(), 104);
+  EXPECT_DOUBLE_EQ(jitter::percentile(), 95.0);
+}
+
+/**
+ * Events placed before the start of their buffer raise the compensation.
+ */
+TEST_F(JitterEstimatorTest, lateEventsRaiseCompensation) {
+  constexpr int nFrames = 256;
+  for (std::uint32_t i = 0; i < jitter::MIN_SAMPLE_COUNT; i++) {
+    jitter::addWakeUpDelay(0);
+    jitter::addLead(nFrames / 2, nFrames); // in time
+  }
+  jitter::update();
+  EXPECT_EQ(jitter::compensation(), jitter::Histogram::BIN_WIDTH);
+  EXPECT_EQ(jitter::lateEventCount(), 0);
+
+  // from now on, every event arrives 20 frames too late.
+  for (int i = 0; i < 100; i++) {
+    jitter::addLead(nFrames + 20, nFrames);
+    jitter::update();
+  }
+  EXPECT_EQ(jitter::lateEventCount(), 100);
+  EXPECT_GE(jitter::compensation(), 20);
+  EXPECT_GT(jitter::leadHistogram().percentile(99.0), nFrames);
+}
+
+} // namespace unitTests
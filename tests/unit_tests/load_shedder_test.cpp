@@ -0,0 +1,302 @@
+/*
+ * File: load_shedder_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "load_shedder.h"
+#include "sysex_arena.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace unitTests {
+using namespace a2jmidi;
+
+class LoadShedderTest : public ::testing::Test {
+protected:
+  static constexpr int nFrames = 256;
+  StagingBuffer staging{nFrames};
+  LoadShedder shedder;
+
+  LoadShedderTest() { spdlog::set_level(spdlog::level::trace); }
+
+  void add(int frame, std::vector<unsigned char> message) {
+    ASSERT_TRUE(staging.add(frame, message.data(), static_cast<int>(message.size())));
+  }
+
+  /**
+   * Write the staging buffer into a "JACK buffer" of `capacity` bytes where every event
+   * takes `cost` bytes, as `jack_midi_max_event_size()` would report it.
+   * @return the status bytes of the written events.
+   */
+  std::vector<std::vector<unsigned char>> write(int capacity, int cost) {
+    std::vector<std::vector<unsigned char>> written;
+    int freeSpace = capacity;
+    int position = 0;
+    staging.sort();
+    shedder.beginCycle(capacity);
+    staging.forEach([&](int frame, const unsigned char *data, int size) {
+      if (shedder.admit(staging, position++, freeSpace)) {
+        written.emplace_back(data, data + size);
+        freeSpace -= cost;
+      }
+      return 0;
+    });
+    staging.clear();
+    return written;
+  }
+};
+
+/**
+ * Notes, program changes, real-time and the pedals are essential; controllers, pitch bend
+ * and aftertouch are continuous.
+ */
+TEST_F(LoadShedderTest, classify) {
+  using midi::Priority;
+  const unsigned char noteOn[] = {0x91, 60, 100};
+  const unsigned char noteOff[] = {0x81, 60, 0};
+  const unsigned char program[] = {0xC0, 5};
+  const unsigned char clock[] = {0xF8};
+  const unsigned char sustain[] = {0xB0, 64, 127};
+  const unsigned char allNotesOff[] = {0xB0, 123, 0};
+  const unsigned char bankSelect[] = {0xB0, 0, 1};
+  const unsigned char sysex[] = {0xF0, 0x7E, 0xF7};
+  const unsigned char modWheel[] = {0xB3, 1, 64};
+  const unsigned char pitchBend[] = {0xE2, 0, 64};
+  const unsigned char pressure[] = {0xD2, 64};
+  const unsigned char polyAftertouch[] = {0xA2, 60, 64};
+
+  EXPECT_EQ(midi::classify(noteOn, 3), Priority::essential);
+  EXPECT_EQ(midi::classify(noteOff, 3), Priority::essential);
+  EXPECT_EQ(midi::classify(program, 2), Priority::essential);
+  EXPECT_EQ(midi::classify(clock, 1), Priority::essential);
+  EXPECT_EQ(midi::classify(sustain, 3), Priority::essential);
+  EXPECT_EQ(midi::classify(allNotesOff, 3), Priority::essential);
+  EXPECT_EQ(midi::classify(bankSelect, 3), Priority::normal);
+  EXPECT_EQ(midi::classify(sysex, 3), Priority::normal);
+  EXPECT_EQ(midi::classify(modWheel, 3), Priority::continuous);
+  EXPECT_EQ(midi::classify(pitchBend, 3), Priority::continuous);
+  EXPECT_EQ(midi::classify(pressure, 2), Priority::continuous);
+  EXPECT_EQ(midi::classify(polyAftertouch, 3), Priority::continuous);
+
+  EXPECT_EQ(midi::continuousKey(noteOn, 3), -1);
+  EXPECT_EQ(midi::continuousKey(modWheel, 3), 3 * 128 + 1);
+  EXPECT_NE(midi::continuousKey(pitchBend, 3), midi::continuousKey(pressure, 2));
+  const unsigned char lastKey[] = {0xAF, 127, 0};
+  EXPECT_EQ(midi::continuousKey(lastKey, 3), midi::CONTINUOUS_KEY_COUNT - 1);
+
+  // truncated messages have no key, they are normal messages.
+  EXPECT_EQ(midi::classify(pitchBend, 1), Priority::normal);
+  EXPECT_EQ(midi::classify(pressure, 1), Priority::normal);
+  EXPECT_EQ(midi::classify(polyAftertouch, 1), Priority::normal);
+  EXPECT_EQ(midi::continuousKey(pitchBend, 1), -1);
+}
+
+/**
+ * Truncated messages under pressure are treated like other normal messages.
+ */
+TEST_F(LoadShedderTest, truncated) {
+  for (int i = 0; i < 20; i++) {
+    add(i, {0x90, 60, 100});
+    add(i, {0xE0});
+    add(i, {0xD1});
+  }
+  auto written = write(1000, 50);
+  EXPECT_LT(written.size(), 60);
+  EXPECT_GT(shedder.shedCount(), 0);
+  EXPECT_EQ(shedder.coalescedCount(), 0);
+}
+
+/**
+ * The (N)RPN selects and the data entry controllers are essential, never continuous.
+ */
+TEST_F(LoadShedderTest, parameterControllers) {
+  for (int controller : {6, 38, 96, 97, 98, 99, 100, 101}) {
+    const unsigned char message[] = {0xB2, static_cast<unsigned char>(controller), 5};
+    EXPECT_FALSE(midi::isContinuousController(controller)) << controller;
+    EXPECT_EQ(midi::classify(message, 3), midi::Priority::essential) << controller;
+    EXPECT_EQ(midi::continuousKey(message, 3), -1) << controller;
+  }
+  EXPECT_TRUE(midi::isContinuousController(7));
+  EXPECT_TRUE(midi::isContinuousController(102));
+}
+
+/**
+ * Without pressure, every event gets through.
+ */
+TEST_F(LoadShedderTest, noPressure) {
+  for (int i = 0; i < 10; i++) {
+    add(i, {0xB0, 1, static_cast<unsigned char>(i)});
+  }
+  EXPECT_EQ(write(1000, 10).size(), 10);
+  EXPECT_EQ(shedder.coalescedCount(), 0);
+  EXPECT_EQ(shedder.shedCount(), 0);
+}
+
+/**
+ * Under pressure, only the latest value of each controller gets through, but the notes
+ * between the controllers are all written.
+ */
+TEST_F(LoadShedderTest, coalesce) {
+  // 160 events fill the buffer below a quarter of its capacity.
+  for (int i = 0; i < 160; i++) {
+    add(i / 16, {0x90, 60, 100});
+  }
+  for (int i = 0; i < 10; i++) {
+    add(20 + 2 * i, {0xB0, 1, static_cast<unsigned char>(i)});
+    add(20 + 2 * i, {0xE0, 0, static_cast<unsigned char>(i)});
+    add(21 + 2 * i, {0x80, 60, 0});
+  }
+  auto written = write(1000, 5);
+  std::vector<int> controllers;
+  int notes = 0;
+  for (const auto &message : written) {
+    if ((message[0] & 0xF0U) == 0xB0 || (message[0] & 0xF0U) == 0xE0) {
+      controllers.push_back(message[2]);
+    } else {
+      notes++;
+    }
+  }
+  EXPECT_EQ(notes, 170);
+  // the last values of both keys.
+  EXPECT_EQ(controllers, (std::vector<int>{9, 9}));
+  EXPECT_EQ(shedder.coalescedCount(), 18);
+  EXPECT_EQ(shedder.shedCount(), 0);
+}
+
+/**
+ * Below the reserve, only essential events are written, and the last controller values.
+ */
+TEST_F(LoadShedderTest, reserve) {
+  for (int i = 0; i < 20; i++) {
+    add(i, {0x90, static_cast<unsigned char>(i), 100});
+    add(i, {0xB0, static_cast<unsigned char>(70 + i), 64});
+    add(i, {0xBF, 0, 1}); // bank select, a normal message
+    add(i, {0xF8});
+  }
+  auto written = write(1000, 50);
+  int essentials = 0;
+  int controllers = 0;
+  for (const auto &message : written) {
+    const auto priority = midi::classify(message.data(), static_cast<int>(message.size()));
+    essentials += priority == midi::Priority::essential ? 1 : 0;
+    controllers += priority == midi::Priority::continuous ? 1 : 0;
+  }
+  EXPECT_EQ(essentials, 40);
+  EXPECT_EQ(controllers, 20); // each controller has a single value, the latest.
+  // the buffer drops below the reserve after 18 writes; in the rest of the cycle the
+  // bank selects are shed.
+  EXPECT_LT(written.size(), 80);
+  EXPECT_GT(shedder.shedCount(), 0);
+  EXPECT_EQ(shedder.coalescedCount(), 0);
+
+  shedder.reset();
+  EXPECT_EQ(shedder.shedCount(), 0);
+}
+
+/**
+ * Under heavy load, a controller sweep is thinned out, but its final value gets through.
+ */
+TEST_F(LoadShedderTest, finalValueSurvives) {
+  for (int i = 0; i < 100; i++) {
+    add(i, {0x90, 60, 100});
+    add(i, {0xB0, 7, static_cast<unsigned char>(i)});
+    add(i, {0xBF, 0, 1});
+  }
+  auto written = write(1000, 20);
+  std::vector<int> volumes;
+  for (const auto &message : written) {
+    if (message[0] == 0xB0) {
+      volumes.push_back(message[2]);
+    }
+  }
+  ASSERT_FALSE(volumes.empty());
+  EXPECT_EQ(volumes.back(), 99);
+  EXPECT_GT(shedder.shedCount(), 0);
+  EXPECT_GT(shedder.coalescedCount(), 0);
+}
+
+/**
+ * Under heavy load, SysEx messages are not shed: with the defer policy, the one that does
+ * not fit stops the cycle and everything from there on is carried over, as in a2jmidi.
+ */
+TEST_F(LoadShedderTest, sysexDeferredUnderLoad) {
+  const std::vector<unsigned char> sysex(40, 0x11);
+  for (int i = 0; i < 40; i++) {
+    add(i, {0x90, 60, 100});
+    std::vector<unsigned char> message = sysex;
+    message.front() = 0xF0;
+    message.back() = 0xF7;
+    add(i, message);
+  }
+  constexpr int capacity = 1000;
+  int freeSpace = capacity;
+  int position = 0;
+  int writtenSysex = 0;
+  staging.sort();
+  shedder.beginCycle(capacity);
+  const int stop = staging.forEach([&]([[maybe_unused]] int frame, const unsigned char *data,
+                                      int size) {
+    if (!shedder.admit(staging, position++, freeSpace)) {
+      return 0;
+    }
+    if (data[0] == 0xF0) {
+      switch (sysexAction(size, freeSpace, capacity, SysexPolicy::defer)) {
+      case SysexAction::defer:
+        return -1;
+      case SysexAction::reject:
+        return 0;
+      case SysexAction::write:
+        writtenSysex++;
+        break;
+      }
+    }
+    freeSpace -= size + 8;
+    return 0;
+  });
+  int deferredSysex = 0;
+  for (int i = stop; i < staging.size(); i++) {
+    deferredSysex += staging.dataAt(i)[0] == 0xF0 ? 1 : 0;
+  }
+  staging.clear();
+  EXPECT_LT(stop, 80);
+  EXPECT_GT(deferredSysex, 0);
+  EXPECT_EQ(writtenSysex + deferredSysex, 40);
+  EXPECT_EQ(shedder.shedCount(), 0);
+}
+
+/**
+ * The superseded table is recomputed in every cycle.
+ */
+TEST_F(LoadShedderTest, nextCycle) {
+  for (int i = 0; i < 8; i++) {
+    add(i, {0x90, 60, 100});
+  }
+  add(10, {0xB0, 1, 1});
+  add(11, {0xB0, 1, 2});
+  EXPECT_EQ(write(1000, 100).size(), 9);
+
+  // a single value in the next cycle must not be mistaken as superseded.
+  for (int i = 0; i < 8; i++) {
+    add(i, {0x90, 60, 100});
+  }
+  add(10, {0xB0, 1, 3});
+  EXPECT_EQ(write(1000, 100).size(), 9);
+  EXPECT_EQ(shedder.coalescedCount(), 1);
+}
+
+} // namespace unitTests
@@ -0,0 +1,200 @@
+/*
+ * File: midi_event_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "midi.h"
+#include "alsa_client.h"
+#include "alsa_helper.h"
+#include "spdlog/spdlog.h"
+#include "sys_clock.h"
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <thread>
+#include <vector>
+
+/**
+ * Count the heap allocations made by the current thread while counting is switched on.
+ */
+static thread_local bool t_countAllocations{false};
+static thread_local long t_allocationCount{0};
+
+void *operator new(std::size_t size) {
+  if (t_countAllocations) {
+    t_allocationCount++;
+  }
+  void *pointer = std::malloc(size == 0 ? 1 : size);
+  if (!pointer) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::size_t) noexcept { std::free(pointer); }
+
+namespace unitTests {
+
+/**
+ * Counts the heap allocations made by the current thread during its lifetime.
+ */
+class AllocationCounter {
+public:
+  AllocationCounter() {
+    t_allocationCount = 0;
+    t_countAllocations = true;
+  }
+  ~AllocationCounter() { t_countAllocations = false; }
+  long count() const { return t_allocationCount; }
+};
+
+class MidiEventTest : public ::testing::Test {
+protected:
+  MidiEventTest() {
+    spdlog::set_level(spdlog::level::trace);
+    SPDLOG_INFO("MidiEventTest-started");
+  }
+
+  ~MidiEventTest() override { SPDLOG_INFO("MidiEventTest-ended"); }
+};
+
+/**
+ * Short messages are copied into the event.
+ */
+TEST_F(MidiEventTest, inlineEvent) {
+  unsigned char bytes[] = {0x90, 60, 100};
+  midi::Event event{bytes, 3};
+  bytes[1] = 0; // the event must not depend on the source.
+
+  EXPECT_FALSE(event.isExternal());
+  EXPECT_EQ(event.size(), 3);
+  EXPECT_EQ(event[0], 0x90);
+  EXPECT_EQ(event[1], 60);
+  EXPECT_EQ(event[2], 100);
+  EXPECT_EQ(std::vector<unsigned char>(event.begin(), event.end()),
+            (std::vector<unsigned char>{0x90, 60, 100}));
+}
+
+/**
+ * SysEx messages refer to the bytes of the producer.
+ */
+TEST_F(MidiEventTest, externalEvent) {
+  const unsigned char bytes[] = {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+  midi::Event event{bytes, sizeof(bytes)};
+
+  EXPECT_TRUE(event.isExternal());
+  EXPECT_EQ(event.size(), 6);
+  EXPECT_EQ(event.data(), bytes);
+  EXPECT_EQ(event[5], 0xF7);
+}
+
+/**
+ * Creating events and handing them to a `RetrieveCallback` does not allocate.
+ */
+TEST_F(MidiEventTest, noAllocationPerEvent) {
+  const unsigned char bytes[] = {0x90, 60, 100};
+  int sum = 0;
+  auto processMidi = [&sum](const midi::Event &event, a2jmidi::TimePoint) -> int {
+    sum += event[1];
+    return 0;
+  };
+  const alsaClient::RetrieveCallback callback{processMidi};
+
+  AllocationCounter counter;
+  for (int i = 0; i < 1000; i++) {
+    callback(midi::Event{bytes, 3}, i);
+  }
+  EXPECT_EQ(counter.count(), 0);
+  EXPECT_EQ(sum, 60 * 1000);
+}
+
+/**
+ * A complete JACK cycle (`alsaClient::retrieve` forwarding all queued events)
+ * does not allocate.
+ */
+TEST_F(MidiEventTest, noAllocationPerCycle) {
+  using namespace ::unitTestHelpers;
+  using namespace std::chrono_literals;
+
+  AlsaHelper::openAlsaSequencer("sender");
+  auto emitterPort = AlsaHelper::createOutputPort("port");
+
+  alsaClient::open("testClient");
+  alsaClient::newReceiverPort("testPort", "sender:port");
+  alsaClient::activate(AlsaHelper::clock());
+
+  constexpr int doubleNoteOns = 8;
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 10);
+  std::this_thread::sleep_for(20ms); // let the listener thread queue the events.
+  auto deadline = AlsaHelper::clock()->now();
+
+  int noteCount = 0;
+  auto processMidi = [&noteCount](const midi::Event &event, a2jmidi::TimePoint) -> int {
+    noteCount++;
+    return 0;
+  };
+
+  long allocations;
+  {
+    AllocationCounter counter;
+    alsaClient::retrieve(deadline, std::ref(processMidi));
+    allocations = counter.count();
+  }
+  EXPECT_EQ(allocations, 0);
+  EXPECT_EQ(noteCount, doubleNoteOns * 4);
+
+  alsaClient::close();
+  AlsaHelper::closeAlsaSequencer();
+}
+
+/**
+ * Compare the cost of creating and forwarding a three byte message
+ * as `std::vector` and as `midi::Event`.
+ */
+TEST_F(MidiEventTest, eventSpeed) {
+  constexpr int loopCount = 1000000;
+  const unsigned char bytes[] = {0x90, 60, 100};
+  long sum = 0;
+
+  auto vectorCallback = std::function<int(const std::vector<unsigned char> &)>{
+      [&sum](const std::vector<unsigned char> &event) {
+        sum += event[1];
+        return 0;
+      }};
+  auto start = sysClock::now();
+  for (int i = 0; i < loopCount; i++) {
+    vectorCallback(std::vector<unsigned char>(bytes, bytes + 3));
+  }
+  auto vectorDuration = sysClock::toMicrosecondFloat(sysClock::now() - start);
+
+  auto eventCallback = std::function<int(const midi::Event &)>{[&sum](const midi::Event &event) {
+    sum += event[1];
+    return 0;
+  }};
+  start = sysClock::now();
+  for (int i = 0; i < loopCount; i++) {
+    eventCallback(midi::Event(bytes, 3));
+  }
+  auto eventDuration = sysClock::toMicrosecondFloat(sysClock::now() - start);
+
+  EXPECT_EQ(sum, 2L * 60 * loopCount);
+  SPDLOG_INFO("eventSpeed - std::vector: {} ns/event, midi::Event: {} ns/event",
+              vectorDuration * 1000.0 / loopCount, eventDuration * 1000.0 / loopCount);
+}
+
+} // namespace unitTests
@@ -0,0 +1,179 @@
+/*
+ * File: realtime_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "realtime.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+namespace unitTests {
+using namespace a2jmidi;
+
+class RealtimeTest : public ::testing::Test {
+protected:
+  RealtimeTest() { spdlog::set_level(spdlog::level::trace); }
+
+  /**
+   * Run a function in a child process, so that process-wide settings (allocator, limits,
+   * locked memory) do not leak into the other tests.
+   * @return the value returned by the function, or -1 if the child did not exit normally.
+   */
+  static int inChildProcess(const std::function<int()> &function) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+      _exit(function());
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+      return -1;
+    }
+    return WEXITSTATUS(status);
+  }
+
+  /**
+   * @return the number of minor page faults of the calling process so far.
+   */
+  static long minorFaults() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+  }
+};
+
+/**
+ * The default settings leave a thread as it is.
+ */
+TEST_F(RealtimeTest, defaultSettings) {
+  RealtimeSettings settings;
+  EXPECT_EQ(settings.listener.policy, SCHED_OTHER);
+  EXPECT_EQ(settings.listener.cpu, -1);
+  EXPECT_EQ(settings.monitor.policy, SCHED_RR);
+  EXPECT_EQ(settings.monitor.priority, 1);
+  EXPECT_FALSE(settings.lockMemory);
+
+  auto result = std::async(std::launch::async, []() {
+    return applyThreadSettings(pthread_self(), ThreadSettings{}, "test");
+  });
+  EXPECT_TRUE(result.get());
+}
+
+/**
+ * A thread can be pinned to a CPU.
+ */
+TEST_F(RealtimeTest, pinToCpu) {
+  // the last CPU that this process may use.
+  cpu_set_t allowed;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(cpu_set_t), &allowed), 0);
+  ThreadSettings settings;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      settings.cpu = cpu;
+    }
+  }
+  auto cpu = std::async(std::launch::async, [&settings]() {
+    EXPECT_TRUE(applyThreadSettings(pthread_self(), settings, "test"));
+    return sched_getcpu();
+  });
+  EXPECT_EQ(cpu.get(), settings.cpu);
+}
+
+/**
+ * A real-time policy is either applied, or the failure is reported.
+ */
+TEST_F(RealtimeTest, realtimePolicy) {
+  ThreadSettings settings;
+  settings.policy = SCHED_FIFO;
+  settings.priority = 10;
+  auto result = std::async(std::launch::async, [&settings]() {
+    bool applied = applyThreadSettings(pthread_self(), settings, "test");
+    int policy;
+    sched_param schParams{};
+    pthread_getschedparam(pthread_self(), &policy, &schParams);
+    if (applied) {
+      EXPECT_EQ(policy, SCHED_FIFO);
+      EXPECT_EQ(schParams.sched_priority, 10);
+    } else {
+      EXPECT_EQ(policy, SCHED_OTHER); // unchanged.
+    }
+    return applied;
+  });
+  SPDLOG_INFO("realtimePolicy - SCHED_FIFO {}.", result.get() ? "granted" : "not permitted");
+}
+
+/**
+ * After prefaulting, allocating and touching heap memory takes (almost) no page faults.
+ */
+TEST_F(RealtimeTest, prefault) {
+  constexpr std::size_t blockSize = HEAP_PREFAULT_SIZE / 2;
+  constexpr long pages = blockSize / 4096;
+  const int faults = inChildProcess([]() {
+    prefaultStack();
+    if (!prefaultHeap(HEAP_PREFAULT_SIZE)) {
+      return 255;
+    }
+    const long before = minorFaults();
+    auto *block = static_cast<volatile unsigned char *>(std::malloc(blockSize));
+    for (std::size_t i = 0; i < blockSize; i += 4096) {
+      block[i] = 1;
+    }
+    const long after = minorFaults();
+    std::free(const_cast<unsigned char *>(block));
+    return static_cast<int>(std::min(after - before, 254L));
+  });
+  ASSERT_GE(faults, 0);
+  ASSERT_NE(faults, 255) << "the heap could not be prefaulted";
+  // without prefaulting, every page of the block would fault once.
+  EXPECT_LT(faults, pages / 16);
+}
+
+/**
+ * Below the memlock limit needed by the future thread stacks, the memory is not locked and
+ * threads can still be started.
+ */
+TEST_F(RealtimeTest, memlockLimit) {
+  const int result = inChildProcess([]() {
+    rlimit limit{64 * 1024, 64 * 1024};
+    if (setrlimit(RLIMIT_MEMLOCK, &limit) != 0) {
+      return 1;
+    }
+    const bool locked = lockMemory(2);
+    if (locked && geteuid() != 0) {
+      return 2; // only root may exceed the limit.
+    }
+    try {
+      std::thread thread([]() { prefaultStack(); });
+      thread.join();
+    } catch (const std::system_error &) {
+      return 3;
+    }
+    return 0;
+  });
+  EXPECT_EQ(result, 0);
+  EXPECT_GT(lockedFootprint(2), HEAP_PREFAULT_SIZE);
+}
+
+} // namespace unitTests
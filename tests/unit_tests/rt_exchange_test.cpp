@@ -0,0 +1,158 @@
+/*
+ * File: rt_exchange_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rt_exchange.h"
+
+#include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
+
+namespace unitTests {
+class RtExchangeTest : public ::testing::Test {};
+
+/**
+ * A buffer that keeps track of the number of living instances.
+ */
+struct CountedBuffer {
+  static std::atomic<int> s_instances;
+  int size;
+  explicit CountedBuffer(int size) : size{size} { s_instances++; }
+  ~CountedBuffer() { s_instances--; }
+};
+std::atomic<int> CountedBuffer::s_instances{0};
+
+/**
+ * A published object replaces the current one on the next `acquire()`; the replaced
+ * object survives until it is reclaimed.
+ */
+TEST_F(RtExchangeTest, publishAcquireReclaim) {
+  {
+    a2jmidi::RtExchange<CountedBuffer> exchange;
+    EXPECT_EQ(exchange.acquire(), nullptr);
+    exchange.reset(std::make_unique<CountedBuffer>(64));
+    EXPECT_EQ(exchange.acquire()->size, 64);
+
+    exchange.publish(std::make_unique<CountedBuffer>(128));
+    EXPECT_TRUE(exchange.hasPending());
+    EXPECT_EQ(CountedBuffer::s_instances, 2);
+    EXPECT_EQ(exchange.acquire()->size, 128);
+    EXPECT_FALSE(exchange.hasPending());
+    EXPECT_EQ(CountedBuffer::s_instances, 2); // the old one was not deleted by acquire().
+
+    EXPECT_TRUE(exchange.reclaim());
+    EXPECT_FALSE(exchange.reclaim());
+    EXPECT_EQ(CountedBuffer::s_instances, 1);
+  }
+  EXPECT_EQ(CountedBuffer::s_instances, 0);
+}
+
+/**
+ * Publishing twice before the real-time side acquires discards the first object.
+ */
+TEST_F(RtExchangeTest, superseded) {
+  {
+    a2jmidi::RtExchange<CountedBuffer> exchange;
+    exchange.reset(std::make_unique<CountedBuffer>(64));
+    exchange.publish(std::make_unique<CountedBuffer>(128));
+    exchange.publish(std::make_unique<CountedBuffer>(256));
+    EXPECT_EQ(CountedBuffer::s_instances, 2);
+    EXPECT_EQ(exchange.acquire()->size, 256);
+
+    exchange.publish(std::make_unique<CountedBuffer>(512)); // reclaims the 64
+    EXPECT_EQ(exchange.acquire()->size, 512);
+    EXPECT_EQ(CountedBuffer::s_instances, 2); // 512 current, 256 retired
+  }
+  EXPECT_EQ(CountedBuffer::s_instances, 0);
+}
+
+/**
+ * A real-time thread acquiring in a loop and a control thread publishing concurrently:
+ * the real-time thread always sees a complete object and nothing leaks.
+ */
+TEST_F(RtExchangeTest, concurrentExchange) {
+  constexpr int publications = 20000;
+  {
+    a2jmidi::RtExchange<CountedBuffer> exchange;
+    exchange.reset(std::make_unique<CountedBuffer>(0));
+    std::atomic<bool> done{false};
+    int lastSeen = 0;
+    bool monotonic = true;
+
+    std::thread realTime([&]() {
+      while (!done) {
+        CountedBuffer *buffer = exchange.acquire();
+        monotonic = monotonic && (buffer->size >= lastSeen);
+        lastSeen = buffer->size;
+      }
+    });
+    for (int i = 1; i <= publications; i++) {
+      exchange.publish(std::make_unique<CountedBuffer>(i));
+    }
+    while (exchange.hasPending()) {
+      exchange.reclaim(); // the last exchange might wait for the previous one to be reclaimed.
+      std::this_thread::yield();
+    }
+    done = true;
+    realTime.join();
+    exchange.reclaim();
+    EXPECT_TRUE(monotonic);
+    EXPECT_EQ(exchange.acquire()->size, publications);
+    EXPECT_EQ(CountedBuffer::s_instances, 1);
+  }
+  EXPECT_EQ(CountedBuffer::s_instances, 0);
+}
+
+/**
+ * Like `concurrentExchange`, but a third thread keeps reclaiming while the control thread
+ * publishes (the buffer-size callback and the main loop): nothing is deleted twice and
+ * nothing leaks.
+ */
+TEST_F(RtExchangeTest, concurrentReclaim) {
+  constexpr int publications = 20000;
+  {
+    a2jmidi::RtExchange<CountedBuffer> exchange;
+    exchange.reset(std::make_unique<CountedBuffer>(0));
+    std::atomic<bool> done{false};
+
+    std::thread realTime([&]() {
+      while (!done) {
+        exchange.acquire();
+      }
+    });
+    std::thread reclaimer([&]() {
+      while (!done) {
+        exchange.reclaim();
+      }
+    });
+    for (int i = 1; i <= publications; i++) {
+      exchange.publish(std::make_unique<CountedBuffer>(i));
+    }
+    while (exchange.hasPending()) {
+      std::this_thread::yield();
+    }
+    done = true;
+    realTime.join();
+    reclaimer.join();
+    exchange.reclaim();
+    EXPECT_EQ(exchange.acquire()->size, publications);
+    EXPECT_EQ(CountedBuffer::s_instances, 1);
+  }
+  EXPECT_EQ(CountedBuffer::s_instances, 0);
+}
+} // namespace unitTests
@@ -0,0 +1,132 @@
+/*
+ * File: spill_buffer_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spill_buffer.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace unitTests {
+using namespace a2jmidi;
+
+class SpillBufferTest : public ::testing::Test {
+protected:
+  static constexpr int nFrames = 256;
+  StagingBuffer staging{nFrames};
+
+  SpillBufferTest() { spdlog::set_level(spdlog::level::trace); }
+
+  /**
+   * Stage `count` note-ons on consecutive frames; the velocity is the index.
+   */
+  void stage(int count, int firstIndex = 0) {
+    for (int i = 0; i < count; i++) {
+      const unsigned char noteOn[] = {0x90, 60, static_cast<unsigned char>(firstIndex + i)};
+      ASSERT_TRUE(staging.add(10 + i, noteOn, 3));
+    }
+  }
+
+  /**
+   * Write the staging buffer into a "JACK buffer" that takes at most `room` events,
+   * keep what did not fit and start the next cycle.
+   * @return the velocities of the written events.
+   */
+  std::vector<int> cycle(SpillBuffer &spill, int room) {
+    std::vector<int> written;
+    staging.sort();
+    int first = staging.forEach([&](int frame, const unsigned char *data, int size) {
+      if (static_cast<int>(written.size()) >= room) {
+        return -1; // -ENOBUFS
+      }
+      written.push_back(data[2]);
+      return 0;
+    });
+    spill.keep(staging, first);
+    staging.clear();
+    spill.release(staging);
+    return written;
+  }
+};
+
+/**
+ * Spilled events are written first in the next cycle, before the new ones, and nothing
+ * is lost.
+ */
+TEST_F(SpillBufferTest, spill) {
+  SpillBuffer spill;
+  stage(10);
+  EXPECT_EQ(cycle(spill, 6), (std::vector<int>{0, 1, 2, 3, 4, 5}));
+  EXPECT_EQ(spill.deferredCount(), 4);
+  stage(2, 10);
+  EXPECT_EQ(cycle(spill, 100), (std::vector<int>{6, 7, 8, 9, 10, 11}));
+  EXPECT_EQ(spill.lostCount(), 0);
+  EXPECT_EQ(spill.size(), 0);
+}
+
+/**
+ * When the spill buffer is full, the newest events are lost.
+ */
+TEST_F(SpillBufferTest, spillFull) {
+  SpillBuffer spill{3};
+  stage(10);
+  EXPECT_EQ(cycle(spill, 5).size(), 5);
+  EXPECT_EQ(spill.deferredCount(), 3);
+  EXPECT_EQ(spill.lostCount(), 2);
+  EXPECT_EQ(cycle(spill, 100), (std::vector<int>{5, 6, 7}));
+}
+
+/**
+ * With `dropNewest` nothing is carried over.
+ */
+TEST_F(SpillBufferTest, dropNewest) {
+  SpillBuffer spill;
+  spill.setPolicy(OverflowPolicy::dropNewest);
+  stage(10);
+  EXPECT_EQ(cycle(spill, 6).size(), 6);
+  EXPECT_EQ(spill.lostCount(), 4);
+  EXPECT_EQ(spill.deferredCount(), 0);
+  EXPECT_TRUE(cycle(spill, 100).empty());
+}
+
+/**
+ * With `dropOldest` the most recent events are carried over when the spill buffer is full.
+ */
+TEST_F(SpillBufferTest, dropOldest) {
+  SpillBuffer spill{3};
+  spill.setPolicy(OverflowPolicy::dropOldest);
+  stage(10);
+  EXPECT_EQ(cycle(spill, 5).size(), 5);
+  EXPECT_EQ(spill.lostCount(), 2);
+  EXPECT_EQ(spill.deferredCount(), 3);
+  EXPECT_EQ(cycle(spill, 100), (std::vector<int>{7, 8, 9}));
+}
+
+/**
+ * The byte capacity limits the spill buffer as well.
+ */
+TEST_F(SpillBufferTest, byteCapacity) {
+  SpillBuffer spill{100, 7};
+  spill.setPolicy(OverflowPolicy::dropOldest);
+  stage(10);
+  EXPECT_EQ(cycle(spill, 0).size(), 0);
+  EXPECT_EQ(spill.deferredCount(), 2);
+  EXPECT_EQ(spill.lostCount(), 8);
+  EXPECT_EQ(cycle(spill, 100), (std::vector<int>{8, 9}));
+}
+} // namespace unitTests
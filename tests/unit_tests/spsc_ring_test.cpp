@@ -0,0 +1,99 @@
+/*
+ * File: spsc_ring_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spsc_ring.h"
+
+#include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
+
+namespace unitTests {
+class SpscRingTest : public ::testing::Test {};
+
+/**
+ * The capacity is rounded up to the next power of two.
+ */
+TEST_F(SpscRingTest, capacity) {
+  a2jmidi::SpscRing<int> ring;
+  EXPECT_EQ(ring.capacity(), 0);
+  ring.reset(5);
+  EXPECT_EQ(ring.capacity(), 8);
+  EXPECT_TRUE(ring.empty());
+}
+
+/**
+ * Elements come out in the order they were pushed; a full ring rejects new elements.
+ */
+TEST_F(SpscRingTest, fifoOrderAndFull) {
+  a2jmidi::SpscRing<int> ring;
+  ring.reset(4);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(ring.push(int{i}));
+  }
+  EXPECT_FALSE(ring.push(4));
+  EXPECT_EQ(ring.size(), 4);
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_NE(ring.front(), nullptr);
+    EXPECT_EQ(*ring.front(), i);
+    ring.pop();
+  }
+  EXPECT_EQ(ring.front(), nullptr);
+}
+
+/**
+ * One producer thread and one consumer thread can use the ring concurrently
+ * without losing or reordering elements.
+ */
+TEST_F(SpscRingTest, concurrentProducerConsumer) {
+  constexpr int count = 1000000;
+  a2jmidi::SpscRing<int> ring;
+  ring.reset(64);
+  std::atomic<bool> failed{false}; ///< lets the producer give up when the consumer stops early.
+
+  std::thread producer([&ring, &failed]() {
+    for (int i = 0; i < count; i++) {
+      while (!ring.push(int{i})) {
+        if (failed) {
+          return;
+        }
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  int expected = 0;
+  while (expected < count) {
+    if (int *value = ring.front()) {
+      EXPECT_EQ(*value, expected);
+      if (*value != expected) {
+        failed = true;
+        break;
+      }
+      ring.pop();
+      expected++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  EXPECT_FALSE(failed);
+  EXPECT_TRUE(ring.empty());
+}
+} // namespace unitTests
@@ -0,0 +1,234 @@
+/*
+ * File: staging_buffer_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "staging_buffer.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace unitTests {
+using namespace a2jmidi;
+
+class StagingBufferTest : public ::testing::Test {
+protected:
+  static constexpr int nFrames = 256;
+  StagingBufferTest() { spdlog::set_level(spdlog::level::trace); }
+};
+
+/**
+ * What `forEach` hands over: the frame and the first data byte (which identifies the event).
+ */
+using Written = std::vector<std::pair<int, int>>;
+
+/**
+ * Stage events with the given frames (the data byte is the index), sort and collect them.
+ */
+Written stageAndSort(StagingBuffer &buffer, const std::vector<int> &frames) {
+  for (int i = 0; i < static_cast<int>(frames.size()); i++) {
+    auto data = static_cast<unsigned char>(i);
+    EXPECT_TRUE(buffer.add(frames[i], &data, 1));
+  }
+  buffer.sort();
+  Written result;
+  buffer.forEach([&](int frame, const unsigned char *data, int size) {
+    result.emplace_back(frame, data[0]);
+    return 0;
+  });
+  buffer.clear();
+  return result;
+}
+
+/**
+ * The expected result, computed with `std::stable_sort`.
+ */
+Written reference(const std::vector<int> &frames) {
+  Written result;
+  for (int i = 0; i < static_cast<int>(frames.size()); i++) {
+    result.emplace_back(frames[i], static_cast<unsigned char>(i));
+  }
+  std::stable_sort(result.begin(), result.end(),
+                   [](const auto &a, const auto &b) { return a.first < b.first; });
+  return result;
+}
+
+/**
+ * Adversarial orderings, for both the small (insertion sort) and the large (counting
+ * sort) case: reversed, all on one frame, clamped events at both ends interleaved with
+ * regular ones, and random frames with many duplicates.
+ */
+TEST_F(StagingBufferTest, adversarialOrderings) {
+  StagingBuffer buffer{nFrames};
+  std::mt19937 random{4711};
+  for (int count : {2, 5, StagingBuffer::INSERTION_SORT_LIMIT, 200}) {
+    std::vector<int> reversed(count);
+    for (int i = 0; i < count; i++) {
+      reversed[i] = (count - 1 - i) % nFrames;
+    }
+    std::vector<int> sameFrame(count, 17);
+    std::vector<int> clamped(count);
+    for (int i = 0; i < count; i++) {
+      // an overrun clamped to the end, an underrun clamped to the start, a regular one.
+      clamped[i] = (i % 3 == 0) ? nFrames - 1 : (i % 3 == 1) ? 0 : (i * 7) % nFrames;
+    }
+    std::vector<int> duplicates(count);
+    std::uniform_int_distribution<int> fewFrames{0, 3};
+    for (int &frame : duplicates) {
+      frame = fewFrames(random) * 60;
+    }
+    for (const auto &frames : {reversed, sameFrame, clamped, duplicates}) {
+      EXPECT_EQ(stageAndSort(buffer, frames), reference(frames)) << "count " << count;
+    }
+  }
+}
+
+/**
+ * Events that came in order stay untouched; multi-byte events keep their bytes.
+ */
+TEST_F(StagingBufferTest, sortedAndMultiByte) {
+  StagingBuffer buffer{nFrames};
+  const unsigned char noteOn[] = {0x90, 60, 100};
+  const unsigned char sysEx[] = {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+  EXPECT_TRUE(buffer.add(10, sysEx, sizeof(sysEx)));
+  EXPECT_TRUE(buffer.add(5, noteOn, sizeof(noteOn)));
+  buffer.sort();
+  std::vector<std::vector<unsigned char>> written;
+  int count = buffer.forEach([&](int frame, const unsigned char *data, int size) {
+    written.emplace_back(data, data + size);
+    return 0;
+  });
+  EXPECT_EQ(count, 2);
+  EXPECT_EQ(written[0], std::vector<unsigned char>(noteOn, noteOn + sizeof(noteOn)));
+  EXPECT_EQ(written[1], std::vector<unsigned char>(sysEx, sysEx + sizeof(sysEx)));
+}
+
+/**
+ * A full buffer refuses further events; `forEach` stops when asked to.
+ */
+TEST_F(StagingBufferTest, capacity) {
+  StagingBuffer buffer{nFrames, 4, 8};
+  const unsigned char noteOn[] = {0x90, 60, 100};
+  EXPECT_TRUE(buffer.add(0, noteOn, 3));
+  EXPECT_TRUE(buffer.add(1, noteOn, 3));
+  EXPECT_FALSE(buffer.add(2, noteOn, 3)); // too many bytes
+  EXPECT_TRUE(buffer.add(2, noteOn, 2));
+  EXPECT_FALSE(buffer.add(3, noteOn, 1)); // too many bytes
+  EXPECT_EQ(buffer.size(), 3);
+
+  int count = buffer.forEach([](int frame, const unsigned char *data, int size) {
+    return frame == 1 ? -1 : 0;
+  });
+  EXPECT_EQ(count, 1);
+  buffer.clear();
+  EXPECT_TRUE(buffer.empty());
+}
+
+/**
+ * Frames outside the buffer (which the placement never produces) are clamped into the
+ * buffer and sorted like any other.
+ */
+TEST_F(StagingBufferTest, framesOutOfRange) {
+  StagingBuffer buffer{nFrames};
+  std::vector<int> frames(100);
+  std::vector<int> clamped(100);
+  for (int i = 0; i < 100; i++) {
+    frames[i] = 2 * nFrames - 7 * i;
+    clamped[i] = std::clamp(frames[i], 0, nFrames - 1);
+  }
+  EXPECT_EQ(stageAndSort(buffer, frames), reference(clamped));
+}
+
+/**
+ * A replaced event takes the new bytes and the new frame, and is sorted accordingly.
+ */
+TEST_F(StagingBufferTest, replace) {
+  StagingBuffer buffer{nFrames};
+  for (int i = 0; i < 4; i++) {
+    auto data = static_cast<unsigned char>(i);
+    ASSERT_TRUE(buffer.add(10 * i, &data, 1));
+  }
+  const unsigned char newer = 9;
+  buffer.replace(1, 35, &newer);
+  buffer.sort();
+  Written result;
+  buffer.forEach([&](int frame, const unsigned char *data, int size) {
+    result.emplace_back(frame, data[0]);
+    return 0;
+  });
+  EXPECT_EQ(result, (Written{{0, 0}, {20, 2}, {30, 3}, {35, 9}}));
+}
+
+/**
+ * Benchmark: 1000 events per cycle, in random order, compared with `std::stable_sort`
+ * (which allocates and cannot be used on the real-time thread).
+ */
+TEST_F(StagingBufferTest, sortBenchmark) {
+  constexpr int eventsPerCycle = 1000;
+  constexpr int cycles = 2000;
+  StagingBuffer buffer{nFrames};
+  std::mt19937 random{815};
+  std::uniform_int_distribution<int> anyFrame{0, nFrames - 1};
+  std::vector<int> frames(eventsPerCycle);
+  for (int &frame : frames) {
+    frame = anyFrame(random);
+  }
+  const unsigned char noteOn[] = {0x90, 60, 100};
+
+  long checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int cycle = 0; cycle < cycles; cycle++) {
+    for (int frame : frames) {
+      buffer.add(frame, noteOn, 3);
+    }
+    buffer.sort();
+    buffer.forEach([&](int frame, const unsigned char *data, int size) {
+      checksum += frame;
+      return 0;
+    });
+    buffer.clear();
+  }
+  auto stagingTime = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (int cycle = 0; cycle < cycles; cycle++) {
+    Written events;
+    for (int i = 0; i < eventsPerCycle; i++) {
+      events.emplace_back(frames[i], noteOn[0]);
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+    for (const auto &event : events) {
+      checksum -= event.first;
+    }
+  }
+  auto referenceTime = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(checksum, 0);
+
+  using namespace std::chrono;
+  auto stagingNs = duration_cast<nanoseconds>(stagingTime).count() / cycles;
+  auto referenceNs = duration_cast<nanoseconds>(referenceTime).count() / cycles;
+  SPDLOG_INFO("sortBenchmark - {} events per cycle: staging buffer {} ns, std::stable_sort {} ns "
+              "per cycle.",
+              eventsPerCycle, stagingNs, referenceNs);
+  // a cycle of 256 frames at 48 kHz lasts 5.3 ms.
+  EXPECT_LT(stagingNs, 1000000);
+}
+} // namespace unitTests
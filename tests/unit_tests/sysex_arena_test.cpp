@@ -0,0 +1,196 @@
+/*
+ * File: sysex_arena_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sysex_arena.h"
+#include "spsc_ring.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace unitTests {
+using namespace a2jmidi;
+
+class SysexArenaTest : public ::testing::Test {
+protected:
+  SysexArenaTest() { spdlog::set_level(spdlog::level::trace); }
+};
+
+/**
+ * A SysEx message of the given size: 0xF0, an index byte, a ramp of data bytes, 0xF7.
+ */
+std::vector<unsigned char> makeSysex(int size, int index) {
+  std::vector<unsigned char> message(size);
+  message[0] = 0xF0;
+  for (int i = 1; i < size - 1; i++) {
+    message[i] = static_cast<unsigned char>((index + i) & 0x7F);
+  }
+  message[1] = static_cast<unsigned char>(index & 0x7F);
+  message[size - 1] = 0xF7;
+  return message;
+}
+
+/**
+ * Feed a message in chunks of the given size, as the ALSA sequencer does.
+ */
+bool appendInChunks(SysexArena &arena, const std::vector<unsigned char> &message, int chunk) {
+  arena.begin();
+  for (size_t i = 0; i < message.size(); i += chunk) {
+    const size_t size = std::min(static_cast<size_t>(chunk), message.size() - i);
+    if (!arena.append(&message[i], size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Chunks are reassembled into one contiguous message.
+ */
+TEST_F(SysexArenaTest, reassemble) {
+  SysexArena arena;
+  arena.reset(4096, 1024);
+  EXPECT_EQ(arena.finish().data, nullptr);
+
+  const auto message = makeSysex(1000, 7);
+  ASSERT_TRUE(appendInChunks(arena, message, 256));
+  EXPECT_TRUE(arena.isOpen());
+  auto result = arena.finish();
+  EXPECT_FALSE(arena.isOpen());
+  ASSERT_EQ(result.size, 1000);
+  EXPECT_EQ(std::vector<unsigned char>(result.data, result.data + result.size), message);
+  arena.release(result.end);
+}
+
+/**
+ * A message that would straddle the end of the ring is moved to its beginning, even if
+ * some of its chunks have already been stored.
+ */
+TEST_F(SysexArenaTest, wrapAround) {
+  SysexArena arena;
+  arena.reset(4096, 2048);
+  for (int round = 0; round < 20; round++) {
+    const auto message = makeSysex(700 + 37 * round, round);
+    ASSERT_TRUE(appendInChunks(arena, message, 100)) << "round " << round;
+    auto result = arena.finish();
+    ASSERT_EQ(result.size, static_cast<int>(message.size()));
+    EXPECT_EQ(std::vector<unsigned char>(result.data, result.data + result.size), message);
+    arena.release(result.end);
+  }
+}
+
+/**
+ * Messages that are too long, or that do not fit while the consumer lags behind, are
+ * abandoned; the following chunks are refused until a new message begins.
+ */
+TEST_F(SysexArenaTest, overflow) {
+  SysexArena arena;
+  arena.reset(4096, 2048);
+  EXPECT_FALSE(appendInChunks(arena, makeSysex(3000, 1), 256));
+  EXPECT_FALSE(arena.isOpen());
+  const unsigned char tail[] = {0x01, 0xF7};
+  EXPECT_FALSE(arena.append(tail, 2));
+
+  // two messages are in use, a third one does not fit.
+  std::vector<SysexArena::Message> pending;
+  for (int i = 0; i < 2; i++) {
+    ASSERT_TRUE(appendInChunks(arena, makeSysex(2000, i), 256));
+    pending.push_back(arena.finish());
+  }
+  EXPECT_FALSE(appendInChunks(arena, makeSysex(1000, 2), 256));
+  // ... until the consumer releases the first one.
+  arena.release(pending[0].end);
+  EXPECT_TRUE(appendInChunks(arena, makeSysex(1000, 2), 256));
+  EXPECT_EQ(arena.finish().size, 1000);
+
+  EXPECT_THROW(arena.reset(1000, 600), std::invalid_argument);
+}
+
+/**
+ * Messages that fit are written; others are deferred or rejected according to the policy,
+ * and those larger than the empty JACK buffer are always rejected.
+ */
+TEST_F(SysexArenaTest, policy) {
+  EXPECT_EQ(sysexAction(100, 200, 1000, SysexPolicy::defer), SysexAction::write);
+  EXPECT_EQ(sysexAction(300, 200, 1000, SysexPolicy::defer), SysexAction::defer);
+  EXPECT_EQ(sysexAction(300, 200, 1000, SysexPolicy::reject), SysexAction::reject);
+  EXPECT_EQ(sysexAction(2000, 200, 1000, SysexPolicy::defer), SysexAction::reject);
+}
+
+/**
+ * Benchmark: 64 KiB dumps, delivered in 256 byte chunks, reassembled by a producer thread and
+ * copied out (as into a JACK buffer) by a consumer thread.
+ */
+TEST_F(SysexArenaTest, throughputBenchmark) {
+  constexpr int dumpSize = 64 * 1024;
+  constexpr int dumpCount = 2000;
+  constexpr int chunk = 256;
+  SysexArena arena;
+  arena.reset(4 * 128 * 1024, 128 * 1024);
+  SpscRing<SysexArena::Message> queue;
+  queue.reset(64);
+  std::vector<std::vector<unsigned char>> dumps;
+  for (int i = 0; i < 4; i++) {
+    dumps.push_back(makeSysex(dumpSize, i));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread producer([&]() {
+    for (int i = 0; i < dumpCount; i++) {
+      // wait while the consumer lags behind (the listener would drop the dump instead).
+      while (!appendInChunks(arena, dumps[i % 4], chunk) || !queue.back()) {
+        std::this_thread::yield();
+      }
+      queue.push(arena.finish());
+    }
+  });
+  std::vector<unsigned char> jackBuffer(dumpSize);
+  int received = 0;
+  int corrupted = 0;
+  while (received < dumpCount) {
+    SysexArena::Message *message = queue.front();
+    if (!message) {
+      std::this_thread::yield();
+      continue;
+    }
+    std::memcpy(jackBuffer.data(), message->data, message->size);
+    if (message->size != dumpSize || jackBuffer[1] != (received % 4) ||
+        jackBuffer[dumpSize - 1] != 0xF7) {
+      corrupted++;
+    }
+    arena.release(message->end);
+    queue.pop();
+    received++;
+  }
+  producer.join();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+
+  SPDLOG_INFO("throughputBenchmark - {} dumps of {} KiB in {} ms: {} MiB/s.", dumpCount,
+              dumpSize / 1024, seconds * 1000.0,
+              static_cast<double>(dumpCount) * dumpSize / (1024.0 * 1024.0) / seconds);
+  EXPECT_EQ(corrupted, 0);
+  // a MIDI cable carries about 3 KiB/s; even USB devices stay far below 1 MiB/s.
+  EXPECT_GT(static_cast<double>(dumpCount) * dumpSize / seconds, 10.0 * 1024 * 1024);
+}
+
+} // namespace unitTests
@@ -0,0 +1,178 @@
+/*
+ * File: xrun_recovery_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xrun_recovery.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <deque>
+
+namespace unitTests {
+using namespace a2jmidi;
+
+class XrunRecoveryTest : public ::testing::Test {
+protected:
+  static constexpr int nFrames = 256;
+  XrunRecovery recovery;
+
+  XrunRecoveryTest() { spdlog::set_level(spdlog::level::trace); }
+
+  /**
+   * Start the given cycle in the classic placement (the deadline lies at the cycle start).
+   */
+  TimePoint beginCycle(int cycle, bool xrun = false) {
+    return recovery.beginCycle(previousCycleWindow(cycle * nFrames, nFrames), xrun);
+  }
+};
+
+/**
+ * Without xrun, events are placed as usual.
+ */
+TEST_F(XrunRecoveryTest, noXrun) {
+  for (int cycle = 1; cycle < 4; cycle++) {
+    EXPECT_EQ(beginCycle(cycle), cycle * nFrames);
+    EXPECT_FALSE(recovery.recovering());
+    auto window = previousCycleWindow(cycle * nFrames, nFrames);
+    EXPECT_EQ(recovery.place(cycle * nFrames - 100), placeEvent(window, cycle * nFrames - 100));
+  }
+  // an xrun report that did not skip a cycle leaves no backlog.
+  beginCycle(4, true);
+  EXPECT_FALSE(recovery.recovering());
+  EXPECT_EQ(recovery.xrunCount(), 0);
+}
+
+/**
+ * In flush policy, the backlog is discarded and counted, the regular events are kept.
+ */
+TEST_F(XrunRecoveryTest, flush) {
+  recovery.setPolicy(XrunPolicy::flush);
+  for (int cycle = 1; cycle <= 3; cycle++) {
+    beginCycle(cycle);
+  }
+  // cycles 4..6 are skipped.
+  EXPECT_EQ(beginCycle(7, true), 7 * nFrames);
+  EXPECT_TRUE(recovery.recovering());
+  EXPECT_EQ(recovery.place(3 * nFrames + 10), DISCARD_EVENT);
+  EXPECT_EQ(recovery.place(5 * nFrames + 10), DISCARD_EVENT);
+  EXPECT_EQ(recovery.place(6 * nFrames + 10), 10);
+  EXPECT_EQ(recovery.xrunCount(), 1);
+  EXPECT_EQ(recovery.flushedCount(), 2);
+
+  beginCycle(8);
+  EXPECT_FALSE(recovery.recovering());
+}
+
+/**
+ * In compress policy, the backlog keeps its order within the first frames of the buffer;
+ * the regular events follow.
+ */
+TEST_F(XrunRecoveryTest, compress) {
+  recovery.setPolicy(XrunPolicy::compress);
+  for (int cycle = 1; cycle <= 3; cycle++) {
+    beginCycle(cycle);
+  }
+  beginCycle(7, true);
+  int previous = 0;
+  for (TimePoint timeStamp = 3 * nFrames; timeStamp < 6 * nFrames; timeStamp += 7) {
+    int position = recovery.place(timeStamp);
+    EXPECT_GE(position, previous);
+    EXPECT_LT(position, XrunRecovery::COMPRESS_FRAMES);
+    previous = position;
+  }
+  // a regular event lying within the compressed frames must not go back in time.
+  EXPECT_EQ(recovery.place(6 * nFrames + 1), previous);
+  EXPECT_EQ(recovery.place(6 * nFrames + 100), 100);
+  EXPECT_EQ(recovery.compressedCount(), (3 * nFrames + 6) / 7);
+}
+
+/**
+ * In spread policy, no event is lost, no buffer receives more than `SPREAD_SPEED` periods
+ * worth of events, and the recovery ends once the backlog has been played.
+ */
+TEST_F(XrunRecoveryTest, spread) {
+  recovery.setPolicy(XrunPolicy::spread);
+  std::deque<TimePoint> queue;
+  TimePoint nextEvent = 0;
+  int delivered = 0;
+  int produced = 0;
+  int recoveryCycles = 0;
+
+  for (int cycle = 1; cycle <= 20; cycle++) {
+    while (nextEvent < cycle * nFrames) {
+      queue.push_back(nextEvent);
+      nextEvent += 8;
+      produced++;
+    }
+    if (cycle >= 4 && cycle <= 6) {
+      continue; // skipped by the xrun.
+    }
+    TimePoint deadline = beginCycle(cycle, cycle == 7);
+    recoveryCycles += recovery.recovering() ? 1 : 0;
+    int previous = 0;
+    int perCycle = 0;
+    while (!queue.empty() && queue.front() < deadline) {
+      int position = recovery.place(queue.front());
+      queue.pop_front();
+      ASSERT_NE(position, DISCARD_EVENT);
+      EXPECT_GE(position, previous);
+      previous = position;
+      perCycle++;
+      delivered++;
+    }
+    EXPECT_LE(perCycle, XrunRecovery::SPREAD_SPEED * nFrames / 8);
+  }
+  EXPECT_EQ(delivered + static_cast<int>(queue.size()), produced);
+  EXPECT_TRUE(queue.empty() || queue.front() >= 20 * nFrames);
+  EXPECT_EQ(recoveryCycles, 3); // a lag of three periods shrinks by one period per cycle.
+  EXPECT_EQ(recovery.xrunCount(), 1);
+  EXPECT_GT(recovery.spreadCount(), 0);
+  EXPECT_FALSE(recovery.recovering());
+}
+
+/**
+ * A policy change takes effect with the next xrun.
+ */
+TEST_F(XrunRecoveryTest, policyChange) {
+  recovery.setPolicy(XrunPolicy::flush);
+  beginCycle(1);
+  beginCycle(3, true);
+  recovery.setPolicy(XrunPolicy::compress);
+  EXPECT_EQ(recovery.place(nFrames + 10), DISCARD_EVENT);
+  beginCycle(4);
+  beginCycle(6, true);
+  EXPECT_EQ(recovery.policy(), XrunPolicy::compress);
+  EXPECT_NE(recovery.place(4 * nFrames + 10), DISCARD_EVENT);
+  EXPECT_EQ(recovery.xrunCount(), 2);
+  EXPECT_EQ(recovery.flushedCount(), 1);
+  EXPECT_EQ(recovery.compressedCount(), 1);
+}
+
+/**
+ * Switching at runtime goes through all policies and comes back to the start.
+ */
+TEST_F(XrunRecoveryTest, policyCycle) {
+  XrunPolicy policy = XrunPolicy::spread;
+  policy = nextPolicy(policy);
+  EXPECT_STREQ(policyName(policy), "flush");
+  policy = nextPolicy(policy);
+  EXPECT_STREQ(policyName(policy), "compress");
+  policy = nextPolicy(policy);
+  EXPECT_STREQ(policyName(policy), "spread");
+  EXPECT_EQ(policy, XrunPolicy::spread);
+}
+} // namespace unitTests